@@ -0,0 +1,359 @@
+﻿#include "seal/seal.h"
+#include "../Common/batch_layout.h"
+#include "../Common/blob_loader.h"
+#include "../Common/param_planner.h"
+#include "../Server_AI/diagnostics.h"
+#include "../Server_AI/fixed_circuit.h"
+#include "../Server_AI/inference.h"
+#include "../Server_AI/model_cache.h"
+#include "../Server_AI/worker_pool.h"
+#include <benchmark/benchmark.h>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+using namespace seal;
+
+// --- 단계별 HE 마이크로 벤치마크 ---
+// server_main.cpp / client_main.cpp와 같은 planner 파라미터로 파이프라인의 각 단계를 따로 측정한다.
+// 이름은 "<단계>/<회로>" 형식 (예: MultiplyPlain/sigmoid3). 결과 저장:
+//   he_benchmarks --benchmark_out=bench.json --benchmark_out_format=json
+//   he_benchmarks --benchmark_out=bench.csv --benchmark_out_format=csv
+// 특정 단계만: --benchmark_filter=Serialize
+
+// 회로별로 한 번만 만드는 컨텍스트, 키, 입력 (키 생성은 벤치마크마다 반복하지 않음)
+struct HEState {
+    explicit HEState(const string& circuit_name)
+        : circuit(parse_circuit(circuit_name)),
+          plan(plan_parameters(circuit)),
+          context(make_encryption_parameters(plan)),
+          keygen(context),
+          secret_key(keygen.secret_key()),
+          encoder(context),
+          evaluator(context),
+          decryptor(context, secret_key),
+          layout(make_circuit_layout(circuit, circuit.hidden_units > 0 ? circuit.input_features : 4, encoder.slot_count())),
+          diagnostics("Shared_Channel", 0),
+          worker(context, 0),
+          fixed_circuits(context, circuit, plan) {
+        keygen.create_public_key(public_key);
+        keygen.create_relin_keys(relin_keys);
+        keygen.create_galois_keys(circuit_rotation_steps(circuit, layout), galois_keys);
+        encryptor = make_unique<Encryptor>(context, public_key, secret_key);
+
+        // 정규화된 특성(4개, MLP는 회로의 입력 수)을 가진 환자로 암호문 하나를 가득 채움
+        mt19937 rng(42);
+        uniform_real_distribution<double> uniform(0.0, 1.0);
+        patients.assign(layout.patients_per_ciphertext, vector<double>(layout.feature_count));
+        for (auto& row : patients) {
+            for (double& v : row) v = uniform(rng);
+        }
+        slots = bit_encode(pack_patients(layout, patients)[0]);
+
+        encoder.encode(slots, input_scale(plan), plain);
+        encryptor->encrypt(plain, cipher);
+        evaluator.multiply_plain(cipher, plain, product);
+
+        // 전체 파이프라인용 snapshot (합성 모델)
+        snapshot.keys.encryptor = make_shared<const Encryptor>(context, public_key);
+        snapshot.keys.decryptor = make_shared<Decryptor>(context, secret_key);
+        snapshot.keys.relin_keys = make_shared<const RelinKeys>(relin_keys);
+        snapshot.keys.galois_keys = make_shared<const GaloisKeys>(galois_keys);
+        ModelSet models;
+        models.models.push_back(LogisticModel{ "synthetic", { 0.8, 0.6, 0.3, -1.2 }, -0.4 });
+        if (circuit.hidden_units > 0) {
+            // 합성 MLP: 작은 난수 가중치 + softplus 2차 근사 활성화
+            normal_distribution<double> normal(0.0, 0.3);
+            HiddenLayer hidden;
+            hidden.weights.assign(circuit.hidden_units, vector<double>(circuit.input_features));
+            for (auto& row : hidden.weights) {
+                for (double& w : row) w = normal(rng);
+            }
+            hidden.bias.assign(circuit.hidden_units, 0.1);
+            hidden.activation = { 0.693147, 0.5, 0.125 };
+            models.models.back().weights.assign(circuit.hidden_units, 0.2);
+            models.models.back().hidden = move(hidden);
+        }
+        snapshot.models = make_shared<const ModelSet>(move(models));
+        snapshot.constants = make_shared<PlaintextCache>();
+    }
+
+    CircuitSpec circuit;
+    ParameterPlan plan;
+    SEALContext context;
+    KeyGenerator keygen;
+    SecretKey secret_key;
+    PublicKey public_key;
+    RelinKeys relin_keys;
+    GaloisKeys galois_keys;
+    CKKSEncoder encoder;
+    Evaluator evaluator;
+    Decryptor decryptor;
+    unique_ptr<Encryptor> encryptor;
+    BatchLayout layout;
+
+    vector<vector<double>> patients;
+    vector<double> slots;
+    Plaintext plain;
+    Ciphertext cipher;
+    Ciphertext product; // rescale 측정용 (scale^2)
+
+    DiagnosticsSink diagnostics;
+    WorkerContext worker;
+    CacheSnapshot snapshot;
+    FixedCircuits fixed_circuits; // 합성 모델(특성 4개)은 서버에 등록된 모양과 같음
+};
+
+static HEState& state_for(const string& circuit_name) {
+    static map<string, unique_ptr<HEState>> states;
+    auto& state = states[circuit_name];
+    if (!state) state = make_unique<HEState>(circuit_name);
+    return *state;
+}
+
+// 직렬화 크기를 결과(CSV/JSON)에 함께 남김
+static void set_bytes(benchmark::State& st, streamoff bytes) {
+    st.counters["bytes"] = static_cast<double>(bytes);
+    st.SetBytesProcessed(static_cast<int64_t>(st.iterations()) * bytes);
+}
+
+// --- 1. 키 생성 ---
+static void KeyGenSecretPublic(benchmark::State& st, HEState& he) {
+    for (auto _ : st) {
+        KeyGenerator keygen(he.context);
+        PublicKey public_key;
+        keygen.create_public_key(public_key);
+        benchmark::DoNotOptimize(&public_key);
+    }
+}
+
+static void KeyGenRelin(benchmark::State& st, HEState& he) {
+    for (auto _ : st) {
+        RelinKeys relin_keys;
+        he.keygen.create_relin_keys(relin_keys);
+        benchmark::DoNotOptimize(&relin_keys);
+    }
+}
+
+static void KeyGenGalois(benchmark::State& st, HEState& he) {
+    vector<int> steps = circuit_rotation_steps(he.circuit, he.layout);
+    for (auto _ : st) {
+        GaloisKeys galois_keys;
+        he.keygen.create_galois_keys(steps, galois_keys);
+        benchmark::DoNotOptimize(&galois_keys);
+    }
+}
+
+// --- 2. 인코딩 / 암호화 ---
+static void Encode(benchmark::State& st, HEState& he) {
+    Plaintext plain;
+    for (auto _ : st) {
+        he.encoder.encode(he.slots, input_scale(he.plan), plain);
+        benchmark::DoNotOptimize(plain.data());
+    }
+}
+
+static void Encrypt(benchmark::State& st, HEState& he) {
+    Ciphertext cipher;
+    for (auto _ : st) {
+        he.encryptor->encrypt(he.plain, cipher);
+        benchmark::DoNotOptimize(cipher.data());
+    }
+}
+
+static void EncryptSymmetricSeeded(benchmark::State& st, HEState& he) {
+    for (auto _ : st) {
+        auto seeded = he.encryptor->encrypt_symmetric(he.plain);
+        benchmark::DoNotOptimize(&seeded);
+    }
+}
+
+// --- 3. 평가 ---
+static void MultiplyPlain(benchmark::State& st, HEState& he) {
+    Ciphertext result;
+    for (auto _ : st) {
+        he.evaluator.multiply_plain(he.cipher, he.plain, result);
+        benchmark::DoNotOptimize(result.data());
+    }
+}
+
+static void SquareRelinearize(benchmark::State& st, HEState& he) {
+    Ciphertext result;
+    for (auto _ : st) {
+        he.evaluator.square(he.cipher, result);
+        he.evaluator.relinearize_inplace(result, he.relin_keys);
+        benchmark::DoNotOptimize(result.data());
+    }
+}
+
+static void RescaleToNext(benchmark::State& st, HEState& he) {
+    Ciphertext result;
+    for (auto _ : st) {
+        he.evaluator.rescale_to_next(he.product, result);
+        benchmark::DoNotOptimize(result.data());
+    }
+}
+
+static void ModSwitchToNext(benchmark::State& st, HEState& he) {
+    Ciphertext result;
+    for (auto _ : st) {
+        he.evaluator.mod_switch_to_next(he.cipher, result);
+        benchmark::DoNotOptimize(result.data());
+    }
+}
+
+static void RotateVector(benchmark::State& st, HEState& he) {
+    Ciphertext result;
+    for (auto _ : st) {
+        he.evaluator.rotate_vector(he.cipher, 1, he.galois_keys, result);
+        benchmark::DoNotOptimize(result.data());
+    }
+}
+
+static void DecryptDecode(benchmark::State& st, HEState& he) {
+    Plaintext plain;
+    vector<double> values;
+    for (auto _ : st) {
+        he.decryptor.decrypt(he.cipher, plain);
+        he.encoder.decode(plain, values);
+        benchmark::DoNotOptimize(values.data());
+    }
+}
+
+// --- 4. 직렬화 ---
+template <class T>
+static void Serialize(benchmark::State& st, const T& object, compr_mode_type mode) {
+    streamoff bytes = 0;
+    for (auto _ : st) {
+        stringstream stream;
+        bytes = object.save(stream, mode);
+        benchmark::DoNotOptimize(bytes);
+    }
+    set_bytes(st, bytes);
+}
+
+template <class T>
+static void Deserialize(benchmark::State& st, const SEALContext& context, const T& object) {
+    stringstream stream;
+    streamoff bytes = object.save(stream);
+    string buffer = stream.str();
+    for (auto _ : st) {
+        T loaded;
+        loaded.load(context, reinterpret_cast<const seal_byte*>(buffer.data()), buffer.size());
+        benchmark::DoNotOptimize(&loaded);
+    }
+    set_bytes(st, bytes);
+}
+
+// 서버의 키 파일 로딩: ifstream 스트림 load와 mmap + 바이트 버퍼 load 비교
+// (파일은 페이지 캐시에 올라간 상태이므로 차이는 iostream 버퍼 복사 비용)
+template <class T>
+static void LoadKeyFile(benchmark::State& st, const SEALContext& context, const T& object, const string& name,
+    bool mapped) {
+    filesystem::path path = filesystem::temp_directory_path() / ("he_bench_" + name + ".dat");
+    {
+        ofstream out(path, ios::binary);
+        object.save(out);
+    }
+    size_t bytes = static_cast<size_t>(filesystem::file_size(path));
+    for (auto _ : st) {
+        T loaded;
+        if (mapped) {
+            load_mapped(context, path, loaded);
+        }
+        else {
+            ifstream in(path, ios::binary);
+            loaded.load(context, in);
+        }
+        benchmark::DoNotOptimize(&loaded);
+    }
+    set_bytes(st, static_cast<streamoff>(bytes));
+    filesystem::remove(path);
+}
+
+static void SeededUpload(benchmark::State& st, HEState& he) {
+    // 클라이언트 요청 경로: 비밀키 암호화 + seed 압축 직렬화
+    streamoff bytes = 0;
+    for (auto _ : st) {
+        stringstream stream;
+        bytes = he.encryptor->encrypt_symmetric(he.plain).save(stream);
+        benchmark::DoNotOptimize(bytes);
+    }
+    set_bytes(st, bytes);
+}
+
+// --- 5. 전체 파이프라인 (암호문 하나를 가득 채운 배치) ---
+static void ScoreBatch(benchmark::State& st, HEState& he) {
+    InferenceSetup setup{ he.context, he.circuit, he.plan, he.diagnostics };
+    for (auto _ : st) {
+        vector<double> scores = score_patients(setup, he.worker, he.snapshot, he.patients);
+        benchmark::DoNotOptimize(scores.data());
+    }
+    st.SetItemsProcessed(static_cast<int64_t>(st.iterations() * he.patients.size()));
+}
+
+// 같은 배치를 컴파일 시점에 특화한 회로로 (MLP 회로는 등록된 모양이 없어 ScoreBatch와 같음)
+static void ScoreBatchFixed(benchmark::State& st, HEState& he) {
+    InferenceSetup setup{ he.context, he.circuit, he.plan, he.diagnostics };
+    setup.fixed_circuits = &he.fixed_circuits;
+    for (auto _ : st) {
+        vector<double> scores = score_patients(setup, he.worker, he.snapshot, he.patients);
+        benchmark::DoNotOptimize(scores.data());
+    }
+    st.SetItemsProcessed(static_cast<int64_t>(st.iterations() * he.patients.size()));
+}
+
+int main(int argc, char** argv) {
+    using Stage = function<void(benchmark::State&, HEState&)>;
+    vector<pair<string, Stage>> stages = {
+        { "KeyGen/SecretPublic", KeyGenSecretPublic },
+        { "KeyGen/Relin", KeyGenRelin },
+        { "KeyGen/Galois", KeyGenGalois },
+        { "Encode", Encode },
+        { "Encrypt", Encrypt },
+        { "EncryptSymmetricSeeded", EncryptSymmetricSeeded },
+        { "MultiplyPlain", MultiplyPlain },
+        { "SquareRelinearize", SquareRelinearize },
+        { "RescaleToNext", RescaleToNext },
+        { "ModSwitchToNext", ModSwitchToNext },
+        { "RotateVector", RotateVector },
+        { "DecryptDecode", DecryptDecode },
+        { "Serialize/Ciphertext", [](benchmark::State& st, HEState& he) { Serialize(st, he.cipher, Serialization::compr_mode_default); } },
+        { "Serialize/CiphertextUncompressed", [](benchmark::State& st, HEState& he) { Serialize(st, he.cipher, compr_mode_type::none); } },
+        { "Serialize/SeededUpload", SeededUpload },
+        { "Serialize/RelinKeys", [](benchmark::State& st, HEState& he) { Serialize(st, he.relin_keys, Serialization::compr_mode_default); } },
+        { "Serialize/GaloisKeys", [](benchmark::State& st, HEState& he) { Serialize(st, he.galois_keys, Serialization::compr_mode_default); } },
+        { "Deserialize/Ciphertext", [](benchmark::State& st, HEState& he) { Deserialize(st, he.context, he.cipher); } },
+        { "Deserialize/RelinKeys", [](benchmark::State& st, HEState& he) { Deserialize(st, he.context, he.relin_keys); } },
+        { "Deserialize/GaloisKeys", [](benchmark::State& st, HEState& he) { Deserialize(st, he.context, he.galois_keys); } },
+        { "LoadKeyFile/RelinKeysStream", [](benchmark::State& st, HEState& he) { LoadKeyFile(st, he.context, he.relin_keys, "relin", false); } },
+        { "LoadKeyFile/RelinKeysMapped", [](benchmark::State& st, HEState& he) { LoadKeyFile(st, he.context, he.relin_keys, "relin", true); } },
+        { "LoadKeyFile/GaloisKeysStream", [](benchmark::State& st, HEState& he) { LoadKeyFile(st, he.context, he.galois_keys, "galois", false); } },
+        { "LoadKeyFile/GaloisKeysMapped", [](benchmark::State& st, HEState& he) { LoadKeyFile(st, he.context, he.galois_keys, "galois", true); } },
+        { "Pipeline/ScoreBatch", ScoreBatch },
+        { "Pipeline/ScoreBatchFixed", ScoreBatchFixed },
+    };
+
+    // 서버 기본 회로(sigmoid3), 선형 회로(N=4096), 13특성 2층 MLP를 나란히 측정
+    for (const string circuit : { "sigmoid3", "linear", "mlp13x16" }) {
+        for (const auto& [name, stage] : stages) {
+            benchmark::RegisterBenchmark((name + "/" + circuit).c_str(), [stage, circuit](benchmark::State& st) {
+                stage(st, state_for(circuit));
+            })->Unit(benchmark::kMicrosecond);
+        }
+    }
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
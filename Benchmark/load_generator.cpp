@@ -0,0 +1,431 @@
+﻿#include "seal/seal.h"
+#include "../Client_Hospital/hospital_client.h"
+#include "../Common/socket_transport.h"
+#include "../Server_AI/bounded_queue.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace seal;
+namespace fs = std::filesystem;
+using Clock = chrono::steady_clock;
+
+// --- 부하 생성기 (he_loadgen) ---
+// Client_Hospital 세션 여러 개를 흉내 내 Server_AI --listen 소켓에 동시에 요청을 보내고,
+// 처리량과 종단 지연 시간(p50/p95/p99)을 단계별로 나누어 보고한다. 하드웨어 산정과 처리량 회귀 확인용.
+//
+//   he_loadgen --connect unix:/tmp/he_server.sock --sessions 8 --rate 20 --batch 4 --requests 500
+//
+// 요청은 --rate의 Poisson 도착(0이면 closed loop: 세션마다 응답을 받자마자 다음 요청)으로 공용 큐에 들어가고,
+// 비어 있는 세션이 꺼내 암호화해 보낸다. 세션은 연결마다 server_timing 프레임으로 서버 처리 시간을 받는다.
+//
+//   total      도착 시각부터 점수를 얻을 때까지
+//   queue      도착부터 세션이 요청을 잡을 때까지 (client) + 요청을 다 받은 서버가 worker를 잡을 때까지 (server)
+//   encrypt    클라이언트 암호화 + 요청 직렬화
+//   transport  요청 전송부터 응답 수신까지에서 서버 queue/compute를 뺀 나머지 (프레임 전송, 소켓 버퍼)
+//   compute    서버 역직렬화 + HE 연산 + 응답 직렬화
+//   decrypt    클라이언트 복호화 (plain 응답은 디코딩만)
+//   keys       키 업로드 (연결 직후, --requests-per-key마다)
+//
+// 키 생성은 수 초가 걸리므로 시작할 때 --key-sets벌만 만들어 두고 세션에 돌려 가며 쓴다.
+// --key-id-prefix를 주면 키 세트마다 Shared_Channel/keys/<prefix>-<k>/에 게시하고 요청 헤더의 key_id로 보낸다
+// (서버의 KeySessionStore 재사용과 LRU를 측정, 서버와 Shared_Channel을 함께 볼 수 있어야 함).
+
+struct LoadOptions {
+    string connect_address;
+    string circuit = "sigmoid3";
+    size_t sessions = 4;
+    double rate = 0.0;                 // 초당 요청 수 (0 = closed loop)
+    size_t batch = 1;                  // 요청 하나의 환자 수
+    size_t requests = 200;
+    size_t warmup = 0;                 // 통계에서 뺄 앞쪽 요청 수 (기본값: 세션 수)
+    size_t key_sets = 1;
+    size_t requests_per_key = 0;       // 0이면 연결 하나에 키를 한 번만 올림
+    string key_id_prefix;
+    fs::path channel_dir = "Shared_Channel";
+    ResponseMode response_mode = ResponseMode::encrypted;
+    fs::path output_path;
+    unsigned seed = 42;
+    double min_throughput = 0.0;       // 측정 처리량(req/s)이 이보다 낮으면 종료 코드 2
+    double max_p99_ms = 0.0;           // total p99가 이보다 크면 종료 코드 2
+};
+
+// 한 요청의 측정값 (ms)
+struct RequestResult {
+    size_t session = 0;
+    size_t key_set = 0;
+    bool done = false;
+    string error;
+    double total_ms = 0.0;
+    double client_queue_ms = 0.0;
+    double server_queue_ms = 0.0;
+    double encrypt_ms = 0.0;
+    double transport_ms = 0.0;
+    double compute_ms = 0.0;
+    double decrypt_ms = 0.0;
+    double key_ms = 0.0;
+    Clock::time_point arrived;
+    Clock::time_point finished;
+};
+
+struct Arrival {
+    size_t index = 0;
+    Clock::time_point scheduled{};     // closed loop이면 비어 있음 (세션이 꺼낸 시각이 도착)
+};
+
+struct KeySetEntry {
+    shared_ptr<const ClientKeys> keys;
+    string payload;                    // keys / public_keys 프레임 (미리 직렬화)
+    string key_id;
+};
+
+static double elapsed_ms(Clock::time_point from, Clock::time_point to) {
+    return chrono::duration<double, milli>(to - from).count();
+}
+
+static string parse_option(int argc, char* argv[], const string& name, const string& default_value) {
+    for (int i = 1; i + 1 < argc; i++) {
+        if (string(argv[i]) == name) return argv[i + 1];
+    }
+    return default_value;
+}
+
+static size_t parse_size_option(int argc, char* argv[], const string& name, size_t default_value) {
+    return static_cast<size_t>(stoul(parse_option(argc, argv, name, to_string(default_value))));
+}
+
+static double parse_double_option(int argc, char* argv[], const string& name, double default_value) {
+    string text = parse_option(argc, argv, name, "");
+    return text.empty() ? default_value : stod(text);
+}
+
+// 세션 하나: 연결을 유지하며 큐에서 요청을 꺼내 보낸다
+class LoadSession {
+public:
+    LoadSession(const HospitalClient& client, const LoadOptions& options, const vector<KeySetEntry>& key_sets,
+        const vector<vector<vector<double>>>& batches, vector<RequestResult>& results, size_t id)
+        : client_(client), options_(options), key_sets_(key_sets), batches_(batches), results_(results), id_(id),
+          key_set_(id % key_sets.size()) {}
+
+    void run(BoundedQueue<Arrival>& queue) {
+        Arrival arrival;
+        while (queue.pop(arrival)) {
+            Clock::time_point picked = Clock::now();
+            RequestResult& result = results_[arrival.index];
+            Clock::time_point arrived = arrival.scheduled == Clock::time_point{} ? picked : arrival.scheduled;
+            result.session = id_;
+            result.arrived = arrived;
+            result.client_queue_ms = elapsed_ms(arrived, picked);
+            try {
+                send_one(arrival.index, result);
+                result.done = true;
+            }
+            catch (const ServerError& e) {
+                // 서버가 거절한 요청: 연결과 키는 그대로 쓸 수 있다
+                result.error = e.what();
+            }
+            catch (const exception& e) {
+                // 프레임 중간에 실패한 연결은 다시 쓸 수 없다. 다음 요청에서 다시 연결하고 키를 올린다
+                connection_.reset();
+                result.error = e.what();
+            }
+            result.finished = Clock::now();
+            result.total_ms = elapsed_ms(arrived, result.finished);
+        }
+    }
+
+private:
+    void send_one(size_t index, RequestResult& result) {
+        bool rotate = options_.requests_per_key > 0 && requests_on_key_ >= options_.requests_per_key;
+        if (!connection_ || rotate) {
+            Clock::time_point key_start = Clock::now();
+            if (rotate) {
+                key_set_ = (key_set_ + 1) % key_sets_.size();
+                connection_.reset();
+            }
+            connection_ = make_unique<SocketConnection>(SocketConnection::connect(parse_endpoint(options_.connect_address)));
+            connection_->send(MessageType::server_timing, {});
+            const KeySetEntry& entry = key_sets_[key_set_];
+            // key_id 세션은 서버가 디스크의 키를 쓰므로 key_challenge에 답해 세션만 등록한다
+            if (entry.key_id.empty()) {
+                bool with_secret_key = options_.response_mode == ResponseMode::plain;
+                connection_->send(with_secret_key ? MessageType::keys : MessageType::public_keys, entry.payload);
+            }
+            else {
+                try {
+                    client_.register_key_session(*connection_, entry.key_id, *entry.keys);
+                }
+                catch (...) {
+                    // 등록하지 못한 연결은 요청마다 거절되므로 다음 요청에서 다시 연결한다
+                    connection_.reset();
+                    throw;
+                }
+            }
+            requests_on_key_ = 0;
+            result.key_ms = elapsed_ms(key_start, Clock::now());
+        }
+        const KeySetEntry& entry = key_sets_[key_set_];
+        result.key_set = key_set_;
+        requests_on_key_++;
+
+        const vector<vector<double>>& patients = batches_[index];
+        Clock::time_point encrypt_start = Clock::now();
+        ostringstream request;
+        client_.write_request(request, *entry.keys, patients, options_.response_mode, entry.key_id);
+        Clock::time_point sent = Clock::now();
+        result.encrypt_ms = elapsed_ms(encrypt_start, sent);
+
+        connection_->send(MessageType::request, request.view());
+        Frame timing_frame;
+        Frame reply;
+        if (!connection_->receive(timing_frame) || !connection_->receive(reply)) {
+            throw runtime_error("Server closed the connection");
+        }
+        Clock::time_point received = Clock::now();
+        if (timing_frame.type != MessageType::server_timing) throw runtime_error("Server does not report timing");
+        ServerTiming timing = decode_server_timing(timing_frame.payload);
+        result.server_queue_ms = timing.queue_ms;
+        result.compute_ms = timing.compute_ms;
+        result.transport_ms = max(0.0, elapsed_ms(sent, received) - timing.queue_ms - timing.compute_ms);
+
+        if (reply.type == MessageType::error) throw ServerError(reply.payload);
+        if (reply.type == MessageType::encrypted_response) {
+            client_.decrypt_response(reply.payload, *entry.keys, patients.size());
+        }
+        else if (reply.type == MessageType::response) {
+            decode_scores(reply.payload);
+        }
+        else {
+            throw runtime_error("Unexpected reply frame");
+        }
+        result.decrypt_ms = elapsed_ms(received, Clock::now());
+    }
+
+    const HospitalClient& client_;
+    const LoadOptions& options_;
+    const vector<KeySetEntry>& key_sets_;
+    const vector<vector<vector<double>>>& batches_;
+    vector<RequestResult>& results_;
+    size_t id_;
+    size_t key_set_;
+    size_t requests_on_key_ = 0;
+    unique_ptr<SocketConnection> connection_;
+};
+
+// nearest-rank 백분위수 (values는 정렬된 상태)
+static double percentile(const vector<double>& values, double p) {
+    if (values.empty()) return 0.0;
+    size_t rank = static_cast<size_t>(p / 100.0 * values.size() + 0.999999);
+    return values[min(values.size(), max<size_t>(rank, 1)) - 1];
+}
+
+struct Component {
+    const char* name;
+    double RequestResult::* field;
+};
+
+static const Component components[] = {
+    { "total", &RequestResult::total_ms },
+    { "queue.client", &RequestResult::client_queue_ms },
+    { "queue.server", &RequestResult::server_queue_ms },
+    { "encrypt", &RequestResult::encrypt_ms },
+    { "transport", &RequestResult::transport_ms },
+    { "compute", &RequestResult::compute_ms },
+    { "decrypt", &RequestResult::decrypt_ms },
+    { "keys", &RequestResult::key_ms },
+};
+
+static void write_csv(const fs::path& path, const LoadOptions& options, const vector<RequestResult>& results) {
+    ofstream out(path);
+    if (!out) throw runtime_error("Cannot write " + path.string());
+    out << "request,session,key_set,batch,warmup,status";
+    for (const Component& component : components) out << "," << component.name << "_ms";
+    out << "\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const RequestResult& r = results[i];
+        out << i << "," << r.session << "," << r.key_set << "," << options.batch << "," << (i < options.warmup ? 1 : 0)
+            << ",\"" << (r.done ? "ok" : r.error) << "\"";
+        for (const Component& component : components) out << "," << r.*component.field;
+        out << "\n";
+    }
+}
+
+int main(int argc, char* argv[]) {
+    // 명령행: --connect unix:PATH | tcp:[HOST:]PORT (필수, 서버의 --listen 주소)
+    //         --circuit linear|sigmoid3|mlp13x16 (기본값 sigmoid3, 서버와 같아야 함)
+    //         --sessions N (동시 연결 수, 기본값 4) --rate R (초당 요청, 기본값 0 = closed loop)
+    //         --batch B (요청 하나의 환자 수, 기본값 1) --requests N (기본값 200) --warmup W (기본값 세션 수)
+    //         --key-sets K (미리 만들 키 세트 수, 기본값 1) --requests-per-key N (연결을 새로 열고 키를 다시 올리는 주기, 0 = 안 함)
+    //         --key-id-prefix P (서버 키 세션 사용, Shared_Channel/keys/P-<k>/에 게시) --channel DIR
+    //         --response encrypted|plain --out PATH (요청별 CSV) --seed S
+    //         --min-throughput R / --max-p99-ms T: 기준을 벗어나면 종료 코드 2 (회귀 확인용)
+    LoadOptions options;
+    options.connect_address = parse_option(argc, argv, "--connect", "");
+    options.circuit = parse_option(argc, argv, "--circuit", options.circuit);
+    options.sessions = max<size_t>(1, parse_size_option(argc, argv, "--sessions", options.sessions));
+    options.rate = parse_double_option(argc, argv, "--rate", options.rate);
+    options.batch = max<size_t>(1, parse_size_option(argc, argv, "--batch", options.batch));
+    options.requests = parse_size_option(argc, argv, "--requests", options.requests);
+    options.warmup = parse_size_option(argc, argv, "--warmup", options.sessions);
+    options.key_sets = max<size_t>(1, parse_size_option(argc, argv, "--key-sets", options.key_sets));
+    options.requests_per_key = parse_size_option(argc, argv, "--requests-per-key", options.requests_per_key);
+    options.key_id_prefix = parse_option(argc, argv, "--key-id-prefix", "");
+    options.channel_dir = parse_option(argc, argv, "--channel", options.channel_dir.string());
+    options.output_path = parse_option(argc, argv, "--out", "");
+    options.seed = static_cast<unsigned>(parse_size_option(argc, argv, "--seed", options.seed));
+    options.min_throughput = parse_double_option(argc, argv, "--min-throughput", 0.0);
+    options.max_p99_ms = parse_double_option(argc, argv, "--max-p99-ms", 0.0);
+    string response_arg = parse_option(argc, argv, "--response", "encrypted");
+
+    if (options.connect_address.empty()) {
+        cerr << "[LoadGen] --connect is required (the server's --listen address)\n";
+        return 1;
+    }
+    if (response_arg != "encrypted" && response_arg != "plain") {
+        cerr << "[LoadGen] --response must be encrypted or plain\n";
+        return 1;
+    }
+    options.response_mode = response_arg == "plain" ? ResponseMode::plain : ResponseMode::encrypted;
+    if (options.warmup >= options.requests) options.warmup = 0;
+
+    try {
+        HospitalClient client(parse_circuit(options.circuit));
+        cout << "[LoadGen] Circuit " << circuit_name(client.circuit()) << ": " << describe_plan(client.plan()) << "\n";
+
+        // --- 키 세트 (요청마다 만들면 키 생성이 부하를 좌우하므로 미리) ---
+        vector<KeySetEntry> key_sets(options.key_sets);
+        Clock::time_point keygen_start = Clock::now();
+        for (size_t k = 0; k < key_sets.size(); k++) {
+            KeySetEntry& entry = key_sets[k];
+            entry.keys = client.generate_keys();
+            bool with_secret_key = options.response_mode == ResponseMode::plain;
+            if (options.key_id_prefix.empty()) {
+                entry.payload = HospitalClient::serialize_keys(*entry.keys, with_secret_key);
+            }
+            else {
+                entry.key_id = options.key_id_prefix + "-" + to_string(k);
+                if (!valid_key_id(entry.key_id)) throw runtime_error("Invalid key ID: " + entry.key_id);
+                HospitalClient::upload_session_keys(options.channel_dir, entry.key_id, *entry.keys, with_secret_key);
+            }
+        }
+        cout << "[LoadGen] " << key_sets.size() << " key set(s) ready in " << elapsed_ms(keygen_start, Clock::now())
+             << " ms" << (options.key_id_prefix.empty() ? "" : " (published as server key sessions)") << "\n";
+
+        // --- 요청마다 환자 배치 (정규화된 값, 재현 가능하도록 seed 고정) ---
+        mt19937 rng(options.seed);
+        uniform_real_distribution<double> uniform(0.0, 1.0);
+        vector<vector<vector<double>>> batches(options.requests,
+            vector<vector<double>>(options.batch, vector<double>(client.feature_count())));
+        for (auto& batch : batches) {
+            for (auto& patient : batch) {
+                for (double& v : patient) v = uniform(rng);
+            }
+        }
+
+        vector<RequestResult> results(options.requests);
+        BoundedQueue<Arrival> queue(max<size_t>(options.requests, 2));
+        vector<unique_ptr<LoadSession>> sessions;
+        for (size_t s = 0; s < options.sessions; s++) {
+            sessions.push_back(make_unique<LoadSession>(client, options, key_sets, batches, results, s));
+        }
+
+        cout << "[LoadGen] " << options.requests << " request(s) x " << options.batch << " patient(s) over "
+             << options.sessions << " session(s), "
+             << (options.rate > 0 ? "Poisson " + to_string(options.rate) + " req/s" : string("closed loop")) << "\n";
+        cout.flush();
+
+        Clock::time_point run_start = Clock::now();
+        vector<thread> threads;
+        for (auto& session : sessions) threads.emplace_back([&session, &queue] { session->run(queue); });
+
+        // 도착: 예정 시각이 되면 큐에 넣는다 (세션이 모두 바쁘면 큐에서 기다린 시간이 client queue)
+        if (options.rate > 0) {
+            exponential_distribution<double> gap(options.rate);
+            Clock::time_point next = run_start;
+            for (size_t i = 0; i < options.requests; i++) {
+                next += chrono::duration_cast<Clock::duration>(chrono::duration<double>(gap(rng)));
+                this_thread::sleep_until(next);
+                queue.push({ i, next });
+            }
+        }
+        else {
+            for (size_t i = 0; i < options.requests; i++) queue.push({ i, Clock::time_point{} });
+        }
+        queue.close();
+        for (auto& t : threads) t.join();
+
+        // --- 요약 (warmup 제외) ---
+        vector<RequestResult> measured(results.begin() + options.warmup, results.end());
+        size_t errors = 0;
+        Clock::time_point window_start = Clock::time_point::max();
+        Clock::time_point window_end = run_start;
+        for (size_t i = 0; i < measured.size(); i++) {
+            const RequestResult& r = measured[i];
+            if (!r.done) {
+                if (errors++ == 0) cout << "[LoadGen] First error: " << r.error << "\n";
+                continue;
+            }
+            window_start = min(window_start, r.arrived);
+            window_end = max(window_end, r.finished);
+        }
+        size_t completed = measured.size() - errors;
+        double window_seconds = completed > 0 ? elapsed_ms(window_start, window_end) / 1000.0 : 0.0;
+        double throughput = window_seconds > 0 ? completed / window_seconds : 0.0;
+
+        cout << fixed << setprecision(2);
+        cout << "[LoadGen] " << completed << " request(s) measured (" << options.warmup << " warmup excluded), " << errors
+             << " error(s), " << throughput << " req/s, " << throughput * options.batch << " patients/s";
+        if (options.rate > 0) cout << " (offered " << options.rate << " req/s)";
+        cout << "\n";
+
+        cout << left << setw(14) << "ms" << right << setw(10) << "mean" << setw(10) << "p50" << setw(10) << "p95"
+             << setw(10) << "p99" << "\n";
+        double total_p99 = 0.0;
+        for (const Component& component : components) {
+            vector<double> values;
+            for (const RequestResult& r : measured) {
+                if (r.done) values.push_back(r.*component.field);
+            }
+            sort(values.begin(), values.end());
+            double mean = 0.0;
+            for (double v : values) mean += v;
+            if (!values.empty()) mean /= values.size();
+            if (component.field == &RequestResult::total_ms) total_p99 = percentile(values, 99);
+            cout << left << setw(14) << component.name << right << setw(10) << mean << setw(10) << percentile(values, 50)
+                 << setw(10) << percentile(values, 95) << setw(10) << percentile(values, 99) << "\n";
+        }
+
+        if (!options.output_path.empty()) {
+            write_csv(options.output_path, options, results);
+            cout << "[LoadGen] Per-request results written to " << options.output_path.string() << "\n";
+        }
+
+        bool regressed = false;
+        if (options.min_throughput > 0 && throughput < options.min_throughput) {
+            cout << "[LoadGen] Throughput " << throughput << " req/s is below --min-throughput " << options.min_throughput << "\n";
+            regressed = true;
+        }
+        if (options.max_p99_ms > 0 && total_p99 > options.max_p99_ms) {
+            cout << "[LoadGen] p99 latency " << total_p99 << " ms exceeds --max-p99-ms " << options.max_p99_ms << "\n";
+            regressed = true;
+        }
+        if (regressed || completed == 0) return 2;
+    }
+    catch (const exception& e) {
+        cerr << "[LoadGen] " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
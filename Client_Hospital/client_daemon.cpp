@@ -0,0 +1,167 @@
+﻿#include "client_daemon.h"
+#include <exception>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+
+static double hours_since(chrono::system_clock::time_point created) {
+	return chrono::duration<double, ratio<3600>>(chrono::system_clock::now() - created).count();
+}
+
+ClientDaemon::ClientDaemon(const CircuitSpec& circuit, const DaemonOptions& options)
+	: client_(circuit), options_(options), keystore_(options.keystore_dir), link_(client_, options.connect_address) {
+	link_.set_key_id(options_.key_id);
+	cout << "[Client] Circuit " << circuit_name(client_.circuit()) << ": " << describe_plan(client_.plan()) << "\n";
+
+	bool rotate = options_.key_rotation.count() > 0;
+	if (keystore_.load(client_, keys_) && (!rotate || chrono::system_clock::now() - keys_.created < options_.key_rotation)) {
+		cout << "[Client] Keys loaded from " << keystore_.dir().string() << " (created " << hours_since(keys_.created)
+			<< " h ago).\n";
+	}
+	else {
+		auto start = chrono::steady_clock::now();
+		keys_ = { client_.generate_keys(), chrono::system_clock::now() };
+		keystore_.save(client_, keys_);
+		chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+		cout << "[Client] New keys generated and stored in " << keystore_.dir().string() << " (" << elapsed.count()
+			<< " ms).\n";
+	}
+	key_generation_ = 1;
+
+	{
+		lock_guard<mutex> lock(mutex_);
+		upload_locked();
+	}
+	if (rotate) rotation_thread_ = thread(&ClientDaemon::rotation_loop, this);
+}
+
+ClientDaemon::~ClientDaemon() {
+	{
+		lock_guard<mutex> lock(rotation_mutex_);
+		stopping_ = true;
+	}
+	rotation_cv_.notify_all();
+	if (rotation_thread_.joinable()) rotation_thread_.join();
+}
+
+void ClientDaemon::upload_locked() {
+	// 소켓은 연결이 끊기면 서버가 키를 잊으므로 같은 세대라도 다시 올린다 (키 세션은 서버에 남아 있으므로 연결만)
+	if (uploaded_generation_ == key_generation_) {
+		if (!link_.key_id().empty()) link_.connect();
+		if (!link_.uses_socket() || link_.connected()) return;
+	}
+	link_.upload_keys(*keys_.keys, options_.response_mode == ResponseMode::plain);
+	uploaded_generation_ = key_generation_;
+}
+
+ScoreReply ClientDaemon::score(const vector<vector<double>>& patients) {
+	lock_guard<mutex> lock(mutex_);
+	ScoreReply reply;
+	try {
+		upload_locked();
+		reply = link_.score(*keys_.keys, patients, options_.response_mode, options_.response_timeout_ms);
+	}
+	catch (const ServerError&) {
+		throw;
+	}
+	catch (const exception& e) {
+		// 연결이 살아 있으면 (복호화 오류 등) 재시도해도 같으므로 그대로 전달
+		if (!link_.uses_socket() || link_.connected()) throw;
+		cout << "[Client] Server connection lost (" << e.what() << "), reconnecting...\n";
+		upload_locked();
+		reply = link_.score(*keys_.keys, patients, options_.response_mode, options_.response_timeout_ms);
+	}
+
+	if (reply.model_names.empty()) reply.model_names.push_back("default");
+	if (reply.scores.size() != patients.size() * reply.model_names.size()) {
+		throw runtime_error("서버 응답의 점수 개수가 올바르지 않습니다. (필요: "
+			+ to_string(patients.size() * reply.model_names.size()) + "개, 실제: " + to_string(reply.scores.size()) + "개)");
+	}
+	return reply;
+}
+
+void ClientDaemon::rotation_loop() {
+	unique_lock<mutex> wait_lock(rotation_mutex_);
+	while (!stopping_) {
+		// keys_.created는 이 스레드만 바꾼다
+		auto due = keys_.created + options_.key_rotation;
+		if (rotation_cv_.wait_until(wait_lock, due, [this] { return stopping_; })) break;
+		wait_lock.unlock();
+
+		// 키 생성과 저장은 요청 처리와 겹쳐도 된다. 바꿔 끼우는 동안만 진행 중인 서버 왕복을 기다린다
+		auto start = chrono::steady_clock::now();
+		StoredKeys fresh{ client_.generate_keys(), chrono::system_clock::now() };
+		try {
+			keystore_.save(client_, fresh);
+		}
+		catch (const exception& e) {
+			// 메모리의 새 키는 그대로 쓴다 (다음 시작 때 만료된 키를 보고 다시 만든다)
+			cout << "[Client] Failed to store rotated keys: " << e.what() << "\n";
+		}
+		chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+
+		uint64_t generation = 0;
+		{
+			lock_guard<mutex> lock(mutex_);
+			keys_ = move(fresh);
+			generation = ++key_generation_;
+			try {
+				upload_locked();
+			}
+			catch (const exception& e) {
+				// 다음 요청이 다시 올린다
+				cout << "[Client] Failed to upload rotated keys: " << e.what() << "\n";
+			}
+		}
+		cout << "[Client] Keys rotated (generation " << generation << ", " << elapsed.count() << " ms).\n";
+
+		wait_lock.lock();
+	}
+}
+
+void ClientDaemon::run() {
+	SocketListener listener(options_.listen);
+	cout << "[Client] Daemon is listening on " << describe_endpoint(options_.listen) << " ("
+		<< (link_.uses_socket() ? "server socket" : "Shared_Channel") << ", "
+		<< (options_.response_mode == ResponseMode::encrypted ? "encrypted" : "plain") << " responses)...\n";
+
+	// 웹 앱은 클릭마다 연결 하나를 열고 응답을 받으면 닫으므로 연결을 차례로 처리한다
+	while (true) {
+		SocketConnection connection = listener.accept();
+		serve(connection);
+	}
+}
+
+void ClientDaemon::serve(SocketConnection& connection) {
+	try {
+		Frame frame;
+		while (connection.receive(frame)) {
+			if (frame.type != MessageType::patient_rows) {
+				connection.send(MessageType::error, "Unexpected frame type");
+				continue;
+			}
+
+			auto start = chrono::steady_clock::now();
+			try {
+				istringstream text(frame.payload);
+				PatientRows rows = parse_patient_rows(text, client_.feature_count());
+				ScoreReply reply = score(rows.patients);
+				connection.send(MessageType::response, encode_scores(reply));
+
+				chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+				cout << "[Client] " << rows.patients.size() << " patient(s) x " << reply.model_names.size()
+					<< " model(s) scored in " << elapsed.count() << " ms.\n";
+			}
+			catch (const exception& e) {
+				cout << "[Error] " << e.what() << "\n";
+				connection.send(MessageType::error, e.what());
+			}
+		}
+	}
+	catch (const exception& e) {
+		// 웹 앱이 응답 전에 연결을 끊은 경우 등: 다음 연결을 받는다
+		cout << "[Client] Web app connection closed: " << e.what() << "\n";
+	}
+}
@@ -0,0 +1,70 @@
+﻿#pragma once
+#include "hospital_client.h"
+#include "keystore.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// --- 상주 클라이언트 데몬 (Client_Hospital --daemon <주소>) ---
+// 웹 앱(result_app.py)이 진단할 때마다 클라이언트를 새로 띄우면 SEALContext 생성, 키 생성, 키 업로드를 매번 다시 한다.
+// 데몬은 context를 한 번 만들고 keystore의 키를 회전 주기까지 재사용하며, 서버에는 키를 처음과 회전 때만 올린다.
+// 진단 요청은 로컬 소켓으로 받으므로 클릭마다 드는 비용은 암호화와 서버 연산뿐이다.
+//
+//   웹 앱 → 데몬  patient_rows 프레임 (raw_data.txt와 같은 텍스트)
+//   데몬 → 웹 앱  response 프레임 (encode_scores 형식) 또는 error 프레임 (메시지)
+//
+// 키 회전은 별도 스레드에서 새 키를 만들고 keystore에 저장한 뒤, 진행 중인 요청이 끝나면 바꿔 올린다.
+// 서버 연결이 끊기면 (서버 재시작 등) 다음 요청에서 다시 연결하고 키를 올린 뒤 한 번 재시도한다.
+// key_id를 쓰면 서버가 키 세션을 연결과 무관하게 들고 있으므로 다시 연결할 때 키를 올리지 않는다.
+
+struct DaemonOptions {
+	Endpoint listen;                 // 웹 앱이 연결하는 주소
+	std::string connect_address;     // 서버 --listen 주소 (비면 Shared_Channel 파일 교환)
+	ResponseMode response_mode = ResponseMode::encrypted;
+	std::filesystem::path keystore_dir = "Client_Hospital/keystore";
+	std::chrono::seconds key_rotation{ std::chrono::hours(24) }; // 0이면 회전하지 않음
+	int response_timeout_ms = 30000; // 파일 교환의 응답 대기 한도 (result_app.py의 대기 시간과 같음)
+	std::string key_id;              // 서버의 키 세션 ID (비면 Shared_Channel의 공용 키, ServerLink::set_key_id)
+};
+
+class ClientDaemon {
+public:
+	// keystore에서 키를 읽거나 (없거나 만료되었으면 새로 만들어 저장) 서버에 올린다.
+	// 서버에 연결할 수 없으면 runtime_error
+	ClientDaemon(const CircuitSpec& circuit, const DaemonOptions& options);
+	~ClientDaemon();
+
+	ClientDaemon(const ClientDaemon&) = delete;
+	ClientDaemon& operator=(const ClientDaemon&) = delete;
+
+	// 웹 앱 연결을 하나씩 받아 처리한다 (반환하지 않음, listen 소켓 오류는 runtime_error)
+	void run();
+
+	// 환자 목록 하나를 암호화해 점수를 받는다 (여러 스레드에서 호출 가능, 서버 왕복은 한 번에 하나)
+	ScoreReply score(const std::vector<std::vector<double>>& patients);
+
+private:
+	void serve(SocketConnection& connection);
+	void rotation_loop();
+	// 업로드되지 않은 키 세대를 올린다 (mutex_를 잡은 상태에서 호출)
+	void upload_locked();
+
+	HospitalClient client_;
+	DaemonOptions options_;
+	Keystore keystore_;
+
+	std::mutex mutex_;               // keys_, 세대 번호, link_ (서버 왕복 동안 잡고 있음)
+	StoredKeys keys_;
+	std::uint64_t key_generation_ = 0;
+	std::uint64_t uploaded_generation_ = 0; // 0이면 아직 올리지 않음
+	ServerLink link_;
+
+	std::mutex rotation_mutex_;
+	std::condition_variable rotation_cv_;
+	bool stopping_ = false;
+	std::thread rotation_thread_;
+};
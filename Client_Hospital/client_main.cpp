@@ -2,159 +2,208 @@
 #include <iostream>
 #include <fstream>	
 #include <vector>
-#include <thread>
 #include <chrono>
 #include <filesystem>
 #include <string>
+#include <memory>
+#include "client_daemon.h"
+#include "hospital_client.h"
+#include "../Common/ckks_request.h"
+#include "../Common/param_planner.h"
+#include "../Common/socket_transport.h"
 
 using namespace std;
 using namespace seal;
 namespace fs = std::filesystem;
 
-int main() {
-	// -- 0. 시작 전 Shared_Channel 비우기 --
-	cout << "[Client] Cleaning Shared_Channel..." << "\n";
-	try {
-		for (const auto& entry : fs::directory_iterator("Shared_Channel"))
-			fs::remove_all(entry.path());
+int main(int argc, char* argv[]) {
+	// 명령행: --circuit linear|sigmoid3|mlp13x16 (기본값 sigmoid3, 서버와 같아야 함)
+	//         --connect unix:PATH | tcp:[HOST:]PORT (서버의 --listen 주소, 지정하면 Shared_Channel 대신 소켓 사용)
+	//         --response encrypted|plain (기본값 encrypted: 서버가 결과 암호문을 돌려주고 여기서 복호화,
+	//                                     plain: 비밀키를 올려 서버가 복호화한 점수를 받음, 디버깅용)
+	//         --daemon unix:PATH | tcp:[HOST:]PORT (상주 모드: 웹 앱의 요청을 이 주소에서 받음)
+	//         --keystore DIR (데몬의 키 저장소, 기본값 Client_Hospital/keystore)
+	//         --key-rotation-hours H (데몬의 키 회전 주기, 기본값 24, 0이면 회전하지 않음)
+	//         --key-id ID (서버의 병원별 키 세션: Shared_Channel/keys/ID/에 키를 올리고 요청에 ID를 넣음)
+	string circuit_arg = "sigmoid3";
+	string connect_address;
+	string response_arg = "encrypted";
+	string daemon_address;
+	string keystore_arg = "Client_Hospital/keystore";
+	string rotation_arg = "24";
+	string key_id;
+	for (int i = 1; i + 1 < argc; i++) {
+		if (string(argv[i]) == "--circuit") circuit_arg = argv[i + 1];
+		if (string(argv[i]) == "--connect") connect_address = argv[i + 1];
+		if (string(argv[i]) == "--response") response_arg = argv[i + 1];
+		if (string(argv[i]) == "--daemon") daemon_address = argv[i + 1];
+		if (string(argv[i]) == "--keystore") keystore_arg = argv[i + 1];
+		if (string(argv[i]) == "--key-rotation-hours") rotation_arg = argv[i + 1];
+		if (string(argv[i]) == "--key-id") key_id = argv[i + 1];
+	}
+	bool use_socket = !connect_address.empty();
+	if (response_arg != "encrypted" && response_arg != "plain") {
+		cout << "[Error] --response는 encrypted 또는 plain이어야 합니다.\n";
+		return 1;
+	}
+	// 암호문 응답이면 비밀키는 이 프로세스 밖으로 나가지 않는다
+	bool encrypted_response = response_arg == "encrypted";
+	if (!key_id.empty() && !valid_key_id(key_id)) {
+		cout << "[Error] --key-id는 영문자, 숫자, '-', '_'로 된 64자 이하여야 합니다.\n";
+		return 1;
 	}
-	catch (...) {} // 폴더가 비어있으면 패스
 
-	// -- 1. CKKS Parameters 설정 (서버와 동일하게 맞춤) --
-	EncryptionParameters parms(scheme_type::ckks);
-	// 원래 작동하던 파라미터로 복원
-	size_t poly_modulus_degree = 8192;
-	parms.set_poly_modulus_degree(poly_modulus_degree);
-	parms.set_coeff_modulus(CoeffModulus::Create(poly_modulus_degree, { 60, 40, 40, 60 }));
+	// -- 0. 시작 전 Shared_Channel 비우기 (한 번 실행하는 파일 교환일 때만) --
+	// requests/, responses/ 폴더는 다른 요청이 사용 중일 수 있으므로 남겨 둔다 (파일만 삭제)
+	if (!use_socket && daemon_address.empty()) {
+		cout << "[Client] Cleaning Shared_Channel..." << "\n";
+		try {
+			for (const auto& entry : fs::directory_iterator("Shared_Channel"))
+				if (entry.is_regular_file()) fs::remove(entry.path());
+		}
+		catch (...) {} // 폴더가 비어있으면 패스
+	}
 
-	SEALContext context(parms);
+	// -- 데몬 모드: context와 keystore의 키를 유지하며 웹 앱 요청을 받는다 (client_daemon.h) --
+	if (!daemon_address.empty()) {
+		try {
+			DaemonOptions options;
+			options.listen = parse_endpoint(daemon_address);
+			options.connect_address = connect_address;
+			options.response_mode = encrypted_response ? ResponseMode::encrypted : ResponseMode::plain;
+			options.keystore_dir = keystore_arg;
+			options.key_rotation = chrono::seconds(static_cast<long long>(stod(rotation_arg) * 3600.0));
+			options.key_id = key_id;
+			ClientDaemon daemon(parse_circuit(circuit_arg), options);
+			daemon.run();
+		}
+		catch (const exception& e) {
+			cout << "[Error] 클라이언트 데몬을 시작할 수 없습니다: " << e.what() << "\n";
+			return 1;
+		}
+		return 0;
+	}
+
+	// -- 1. CKKS Parameters 설정 (서버와 동일하게 맞춤) --
+	// 서버와 같은 회로를 넣으면 같은 N과 modulus chain이 나온다
+	HospitalClient client(parse_circuit(circuit_arg));
+	cout << "[Client] Circuit " << circuit_name(client.circuit()) << ": " << describe_plan(client.plan()) << "\n";
 
 	// -- 2. key 생성 (KeyGen) --
+	// 특성 4개 → 블록 크기 4 → 회전 폭 1, 2만 필요 (MLP 회로는 밀집층의 baby/giant step 회전 키가 더 필요)
 	cout << "[Client] Key Generation started." << "\n";
-	KeyGenerator keygen(context);
-	auto sercret_key = keygen.secret_key();
-	PublicKey public_key;
-	keygen.create_public_key(public_key);
-	
-	// RelinKeys 생성 (암호문끼리 곱셈을 위한 키)
-	RelinKeys relin_keys;
-	keygen.create_relin_keys(relin_keys);
+	shared_ptr<const ClientKeys> keys = client.generate_keys();
 
 	// -- 3. key 공유 (Upload Keys) --
-	ofstream pk_file("Shared_Channel/pub_key.dat", ios::binary);
-	public_key.save(pk_file);
-	pk_file.close();
-
-	cout << "[Client] Public key upload to Shared_Channel completed.\n";
-
-	// -- 4. Secret Key도 저장 (서버에서 복호화용) --
-	ofstream sk_file("Shared_Channel/secret_key.dat", ios::binary);
-	sercret_key.save(sk_file);
-	sk_file.close();
-
-	cout << "[Client] Secret key upload to Shared_Channel completed.\n";
-	
-	// -- 5. RelinKeys 저장 (서버에서 다항식 연산용) --
-	ofstream rk_file("Shared_Channel/relin_keys.dat", ios::binary);
-	relin_keys.save(rk_file);
-	rk_file.close();
-
-	cout << "[Client] RelinKeys upload to Shared_Channel completed.\n";
+	// 소켓: 연결 직후 keys 프레임 하나로 보낸다. 서버는 이 연결이 끝날 때까지 키를 메모리에 둔다
+	// 파일: Shared_Channel에 원자적으로 게시. 비밀키는 plain 응답일 때만 (서버에서 복호화용)
+	ServerLink link(client, connect_address);
+	link.set_key_id(key_id);
+	try {
+		link.upload_keys(*keys, !encrypted_response);
+	}
+	catch (const exception& e) {
+		cout << "[Error] 서버에 연결할 수 없습니다: " << e.what() << "\n";
+		return 1;
+	}
 
-	vector <double> input_data;
 	// result_app.py에서 생성한 raw_data.txt 파일 읽기 (루트 디렉토리)
+	// 배치 모드: 한 줄에 여러 값(공백/쉼표 구분)이 있으면 한 줄을 환자 1명으로 본다
 	ifstream infile("raw_data.txt");
 	if (!infile.is_open()) {
 		cout << "[Error] raw_data.txt 파일을 찾을 수 없습니다.\n";
 		cout << "[Error] result_app.py에서 먼저 데이터를 입력해주세요.\n";
 		return 1;
 	}
-	
-	double val;
-	string line;
-	while (getline(infile, line)) {
-		// 빈 줄 건너뛰기
-		if (line.empty() || line.find_first_not_of(" \t\r\n") == string::npos) {
-			continue;
-		}
-		// 문자열을 double로 변환
-		try {
-			val = stod(line);
-			input_data.push_back(val);
-		}
-		catch (...) {
-			// 변환 실패 시 건너뛰기
-			continue;
-		}
+	PatientRows rows;
+	try {
+		rows = parse_patient_rows(infile, client.feature_count());
 	}
-	infile.close();
-
-	if (input_data.empty()) {
-		cout << "[Error] 데이터 파일이 비어있습니다.\n";
+	catch (const exception& e) {
+		cout << "[Error] " << e.what() << "\n";
 		cout << "[Error] result_app.py에서 올바른 데이터를 입력해주세요.\n";
 		return 1;
 	}
-	
-	// 정확히 4개의 값이 필요함 (age, trestbps, chol, thalach)
-	if (input_data.size() != 4) {
-		cout << "[Error] 데이터 개수가 올바르지 않습니다. (필요: 4개, 실제: " << input_data.size() << "개)\n";
-		cout << "[Error] result_app.py에서 4개의 값을 입력해주세요.\n";
-		return 1;
+	infile.close();
+	const vector<vector<double>>& batch_data = rows.patients;
+	bool is_batch = rows.is_batch;
+
+	if (is_batch) {
+		cout << "[Client] Loaded " << batch_data.size() << " patients (batch mode)\n";
 	}
-	
-	cout << "[Client] Loaded " << input_data.size() << " normalized values from result_app.py\n";
-	cout << "[Client] Input data: ";
-	for (size_t i = 0; i < input_data.size(); i++) {
-		cout << input_data[i];
-		if (i < input_data.size() - 1) cout << ", ";
+	else {
+		const vector<double>& input_data = batch_data[0];
+		cout << "[Client] Loaded " << input_data.size() << " normalized values from result_app.py\n";
+		cout << "[Client] Input data: ";
+		for (size_t i = 0; i < input_data.size(); i++) {
+			cout << input_data[i];
+			if (i < input_data.size() - 1) cout << ", ";
+		}
+		cout << "\n";
 	}
-	cout << "\n";
-
-	// -- 5. 평문 데이터를 Shared_Channel에 전송 (서버에서 암호화 및 연산 수행) --
-	// 키 파일이 완전히 닫힌 후에 요청 파일 보내기
-	// 파일 시스템 딜레이를 위해 0.5초 대기
-	this_thread::sleep_for(chrono::milliseconds(500));
 
-	ofstream req_file("Shared_Channel/request.txt");
-	for (size_t i = 0; i < input_data.size(); i++) {
-		req_file << input_data[i];
-		if (i < input_data.size() - 1) req_file << "\n";
+	// -- 4. 입력을 직접 암호화하여 보내고 결과 수신 대기 --
+	// 서버의 모델 목록 (models.txt)마다 점수가 하나씩: scores[patient * model_names.size() + model]
+	// 암호문 응답은 여기서 복호화하고, plain 응답은 서버가 복호화한 점수를 그대로 받는다
+	vector<string> model_names;
+	vector<double> scores;
+	try {
+		ScoreReply reply = link.score(*keys, batch_data,
+			encrypted_response ? ResponseMode::encrypted : ResponseMode::plain);
+		model_names = move(reply.model_names);
+		scores = move(reply.scores);
+	}
+	catch (const ServerError& e) {
+		cout << "[Error] 서버에서 요청 처리에 실패했습니다: " << e.what() << "\n";
+		return 1;
+	}
+	catch (const exception& e) {
+		cout << "[Error] 서버와의 통신에 실패했습니다: " << e.what() << "\n";
+		return 1;
 	}
-	req_file.close();
-
-	cout << "[Client] Plain data has been sent. (request.txt)" << "\n";
-	cout << "[Client] Waiting for result..." << "\n";
-
-	// -- 6. 결과 수신 대기 (Polling) - 서버에서 평문 결과 반환 --
-	while (true) {
-		ifstream resp_check("Shared_Channel/response.txt");
-		if (resp_check.good()) {
-			// 파일이 생성되었어도 쓰기 중일 수 있으니 잠시 대기
-			this_thread::sleep_for(chrono::milliseconds(200));
-
-			double final_score;
-			resp_check >> final_score;
-			resp_check.close();
-
-			// 결과 출력
-			cout << "[Client] Final score received: " << final_score << "\n";
-
-			// 파일로 저장
-			cout << ">>> [Client] 결과 수신 완료. 파일로 저장합니다." << endl;
 
-			ofstream res_file("Client_Hospital/result.txt");
-			res_file << final_score;
-			res_file.close();
+	// 파일로 저장
+	cout << ">>> [Client] 결과 수신 완료. 파일로 저장합니다." << endl;
 
-			cout << "\n>>> [Client] Result has arrived! <<<" << "\n";
+	if (model_names.empty()) model_names.push_back("default");
+	size_t model_count = model_names.size();
+	if (scores.size() != batch_data.size() * model_count) {
+		cout << "[Error] 서버 응답의 점수 개수가 올바르지 않습니다. (필요: " << batch_data.size() * model_count
+			<< "개, 실제: " << scores.size() << "개)\n";
+		return 1;
+	}
 
-			break;
+	ofstream res_file("Client_Hospital/result.txt");
+	if (is_batch) {
+		cout << "[Client] " << scores.size() << " scores received (" << batch_data.size() << " patients x "
+			<< model_count << " models).\n";
+		// 환자 순서대로 한 줄에 점수 하나 (모델이 여러 개면 첫 줄에 모델 이름, 한 줄에 모델별 점수)
+		if (model_count > 1) {
+			res_file << "#";
+			for (const string& name : model_names) res_file << " " << name;
+			res_file << "\n";
 		}
-		else {
-			this_thread::sleep_for(chrono::seconds(1));
-			cout << ".";
+		for (size_t i = 0; i < scores.size(); i++) {
+			res_file << scores[i] << ((i + 1) % model_count == 0 ? "\n" : " ");
 		}
 	}
+	else {
+		// result.txt는 첫 번째 모델 점수 하나 (result_app.py 형식), 모델별 점수는 result_models.txt
+		double final_score = scores[0];
+		cout << "[Client] Final score received: " << final_score << "\n";
+		res_file << final_score;
+
+		if (model_count > 1) {
+			ofstream models_file("Client_Hospital/result_models.txt");
+			for (size_t m = 0; m < model_count; m++) {
+				cout << "[Client]   " << model_names[m] << ": " << scores[m] << "\n";
+				models_file << model_names[m] << " " << scores[m] << "\n";
+			}
+		}
+	}
+	res_file.close();
+
+	cout << "\n>>> [Client] Result has arrived! <<<" << "\n";
 
 	return 0;
 }
\ No newline at end of file
@@ -0,0 +1,402 @@
+﻿#include "hospital_client.h"
+#include "../Common/blob_loader.h"
+#include "../Common/channel.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
+
+using namespace std;
+using namespace seal;
+namespace fs = std::filesystem;
+
+PatientRows parse_patient_rows(istream& in, size_t feature_count) {
+	vector<double> input_data;
+	PatientRows rows;
+	string line;
+	while (getline(in, line)) {
+		// 빈 줄 건너뛰기
+		if (line.empty() || line.find_first_not_of(" \t\r\n") == string::npos) {
+			continue;
+		}
+		replace(line.begin(), line.end(), ',', ' ');
+		istringstream line_stream(line);
+		vector<double> row;
+		// 문자열을 double로 변환 (변환 실패 시 해당 값 건너뛰기)
+		string token;
+		while (line_stream >> token) {
+			try {
+				row.push_back(stod(token));
+			}
+			catch (...) {
+				continue;
+			}
+		}
+		if (row.empty()) continue;
+		if (row.size() == 1) input_data.push_back(row[0]);
+		rows.patients.push_back(move(row));
+	}
+
+	if (rows.patients.empty()) throw runtime_error("데이터 파일이 비어있습니다.");
+
+	rows.is_batch = any_of(rows.patients.begin(), rows.patients.end(),
+		[](const vector<double>& row) { return row.size() > 1; });
+	if (rows.is_batch) {
+		// 배치 모드: 모든 환자가 feature_count개의 값을 가져야 함
+		for (size_t i = 0; i < rows.patients.size(); i++) {
+			if (rows.patients[i].size() != feature_count) {
+				throw runtime_error(to_string(i + 1) + "번째 환자의 데이터 개수가 올바르지 않습니다. (필요: "
+					+ to_string(feature_count) + "개, 실제: " + to_string(rows.patients[i].size()) + "개)");
+			}
+		}
+	}
+	else {
+		// 정확히 feature_count개의 값이 필요함 (기본: age, trestbps, chol, thalach)
+		if (input_data.size() != feature_count) {
+			throw runtime_error("데이터 개수가 올바르지 않습니다. (필요: " + to_string(feature_count) + "개, 실제: "
+				+ to_string(input_data.size()) + "개)");
+		}
+		// 단일 요청도 환자 1명짜리 배치로 보낸다
+		rows.patients.assign(1, input_data);
+	}
+	return rows;
+}
+
+// 서버와 같은 회로를 넣으면 같은 N과 modulus chain이 나온다
+HospitalClient::HospitalClient(const CircuitSpec& circuit)
+	: circuit_(circuit),
+	plan_(plan_parameters(circuit)),
+	context_(make_encryption_parameters(plan_)),
+	encoder_(context_) {
+	// MLP 회로는 입력 특성 수가 회로에 들어 있다
+	size_t feature_count = circuit_.hidden_units > 0 ? circuit_.input_features : 4;
+	layout_ = make_circuit_layout(circuit_, feature_count, encoder_.slot_count());
+}
+
+shared_ptr<const ClientKeys> HospitalClient::generate_keys() const {
+	KeyGenerator keygen(context_);
+	auto keys = make_shared<ClientKeys>();
+	keys->secret_key = keygen.secret_key();
+	keygen.create_public_key(keys->public_key);
+	// RelinKeys: 암호문끼리 곱셈, GaloisKeys: 블록 내 회전-합산과 밀집층 회전
+	keygen.create_relin_keys(keys->relin_keys);
+	keygen.create_galois_keys(circuit_rotation_steps(circuit_, layout_), keys->galois_keys);
+	return keys;
+}
+
+string HospitalClient::serialize_keys(const ClientKeys& keys, bool with_secret_key) {
+	ostringstream key_stream;
+	keys.public_key.save(key_stream);
+	if (with_secret_key) keys.secret_key.save(key_stream);
+	keys.relin_keys.save(key_stream);
+	keys.galois_keys.save(key_stream);
+	return move(key_stream).str();
+}
+
+void HospitalClient::upload_keys(const fs::path& channel_dir, const ClientKeys& keys, bool with_secret_key) {
+	// 모든 파일은 임시 파일에 쓴 뒤 rename으로 게시 → 서버는 완성된 파일만 읽는다
+	fs::create_directories(channel_dir);
+	write_file_atomic(channel_dir / "pub_key.dat", [&](ostream& out) { keys.public_key.save(out); }, true);
+	if (with_secret_key) {
+		write_file_atomic(channel_dir / "secret_key.dat", [&](ostream& out) { keys.secret_key.save(out); }, true);
+	}
+	else {
+		// 이전 plain 실행이 남긴 비밀키는 새 키와 짝이 맞지 않으므로 서버가 쓰지 않게 지운다
+		error_code ec;
+		fs::remove(channel_dir / "secret_key.dat", ec);
+	}
+	write_file_atomic(channel_dir / "relin_keys.dat", [&](ostream& out) { keys.relin_keys.save(out); }, true);
+	write_file_atomic(channel_dir / "galois_keys.dat", [&](ostream& out) { keys.galois_keys.save(out); }, true);
+}
+
+void HospitalClient::upload_session_keys(const fs::path& channel_dir, const string& key_id,
+	const ClientKeys& keys, bool with_secret_key) {
+	// Shared_Channel/keys/는 모든 병원이 쓰므로 병원 디렉터리는 소유자 rwx, 그룹 r-x, 그 밖에는 권한 없음
+	// (Windows는 읽기 전용 속성만 다루므로 디렉터리 ACL로 따로 막는다, readme.md)
+	fs::path key_dir = channel_dir / "keys" / key_id;
+	fs::create_directories(key_dir);
+	error_code ec;
+	fs::permissions(key_dir, fs::perms::owner_all | fs::perms::group_read | fs::perms::group_exec,
+		fs::perm_options::replace, ec);
+	if (ec) throw runtime_error("Cannot restrict permissions of " + key_dir.string() + ": " + ec.message());
+	upload_keys(key_dir, keys, with_secret_key);
+}
+
+void HospitalClient::register_key_session(SocketConnection& connection, const string& key_id, const ClientKeys& keys) const {
+	connection.send(MessageType::key_session, key_id);
+	Frame frame;
+	if (!connection.receive(frame)) throw runtime_error("Server closed the connection");
+	if (frame.type == MessageType::error) throw ServerError(frame.payload);
+	if (frame.type != MessageType::key_challenge) throw runtime_error("Server did not send a key challenge");
+
+	// 서버가 세션 공개키로 암호화한 난수: 비밀키로 풀어 돌려준다
+	BlobReader reader(frame.payload);
+	Ciphertext challenge;
+	reader.load(context_, challenge);
+	Decryptor decryptor(context_, keys.secret_key);
+	Plaintext plain;
+	decryptor.decrypt(challenge, plain);
+	vector<double> slots;
+	encoder_.decode(plain, slots);
+	connection.send(MessageType::key_challenge, read_key_challenge_answer(slots));
+
+	if (!connection.receive(frame)) throw runtime_error("Server closed the connection");
+	if (frame.type == MessageType::error) throw ServerError(frame.payload);
+	if (frame.type != MessageType::key_session) throw runtime_error("Server did not confirm the key session");
+}
+
+// 서버와 같은 규약으로 슬롯 배치 → 비트 인코딩 → 입력 scale로 인코딩
+// 비밀키 암호화(encrypt_symmetric)는 두 번째 다항식을 seed로 대신하므로 직렬화 크기가 약 절반이고,
+// 여기에 zstd(없으면 zlib) 압축을 더해 보낸다. 서버는 인코딩/암호화 없이 바로 연산한다.
+size_t HospitalClient::write_request(ostream& out, const ClientKeys& keys,
+	const vector<vector<double>>& patients, ResponseMode response_mode, const string& key_id) const {
+	Encryptor encryptor(context_, keys.secret_key);
+	vector<vector<double>> packed = pack_patients(layout_, patients);
+
+	CkksRequestHeader header;
+	header.patient_count = patients.size();
+	header.feature_count = layout_.feature_count;
+	header.ciphertext_count = packed.size();
+	header.response_mode = response_mode;
+	header.key_id = key_id;
+
+	write_request_header(out, header);
+	for (const auto& slots : packed) {
+		Plaintext plain_input;
+		encoder_.encode(bit_encode(slots, circuit_.input_bit_scale), input_scale(plan_), plain_input);
+		encryptor.encrypt_symmetric(plain_input).save(out, Serialization::compr_mode_default);
+	}
+	return packed.size();
+}
+
+// 입력 암호문 순, 모델 순 결과 암호문을 복호화하여 블록 첫 슬롯을 점수로 꺼낸다
+ScoreReply HospitalClient::decrypt_response(string_view bytes, const ClientKeys& keys, size_t patient_count) const {
+	BlobReader reader(bytes);
+	CkksResponseHeader response = read_response_header(reader);
+	size_t model_count = response.model_names.size();
+	size_t chunk_count = (patient_count + layout_.patients_per_ciphertext - 1) / layout_.patients_per_ciphertext;
+	if (response.patient_count != patient_count || response.ciphertext_count != chunk_count * model_count) {
+		throw runtime_error("Encrypted response does not match the request");
+	}
+
+	Decryptor decryptor(context_, keys.secret_key);
+	ScoreReply reply;
+	reply.model_names = move(response.model_names);
+	reply.scores.assign(patient_count * model_count, 0.0);
+	for (size_t chunk = 0; chunk < chunk_count; chunk++) {
+		size_t first_patient = chunk * layout_.patients_per_ciphertext;
+		size_t chunk_patients = min(layout_.patients_per_ciphertext, patient_count - first_patient);
+		for (size_t m = 0; m < model_count; m++) {
+			Ciphertext result;
+			reader.load(context_, result);
+			Plaintext plain_result;
+			decryptor.decrypt(result, plain_result);
+			vector<double> slots;
+			encoder_.decode(plain_result, slots);
+
+			vector<double> block_scores = extract_block_leading(layout_, slots, chunk_patients);
+			for (size_t p = 0; p < chunk_patients; p++) {
+				double score = block_scores[p];
+				// sigmoid를 암호 상태에서 계산하지 않는 회로는 z가 오므로 여기서 적용
+				if (circuit_.sigmoid_degree == 0) score = 1.0 / (1.0 + exp(-score));
+				reply.scores[(first_patient + p) * model_count + m] = score;
+			}
+		}
+	}
+	return reply;
+}
+
+string make_request_id() {
+	random_device rd;
+	ostringstream id_stream;
+	id_stream << chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now().time_since_epoch()).count()
+		<< "-" << hex << rd();
+	return id_stream.str();
+}
+
+ScoreReply read_plain_response(istream& in) {
+	ScoreReply reply;
+	string names_line;
+	if (getline(in, names_line) && names_line.rfind("#", 0) == 0) {
+		istringstream names_stream(names_line.substr(1));
+		string name;
+		while (names_stream >> name) reply.model_names.push_back(name);
+	}
+	else {
+		// 이름 줄이 없는 이전 형식: 첫 줄도 점수
+		istringstream first_line(names_line);
+		double score;
+		while (first_line >> score) reply.scores.push_back(score);
+	}
+	double score;
+	while (in >> score) reply.scores.push_back(score);
+	return reply;
+}
+
+ServerLink::ServerLink(const HospitalClient& client, string connect_address, fs::path channel_dir)
+	: client_(client), connect_address_(move(connect_address)), channel_dir_(move(channel_dir)) {}
+
+void ServerLink::set_key_id(string key_id) {
+	if (!key_id.empty() && !valid_key_id(key_id)) {
+		throw invalid_argument("key ID는 영문자, 숫자, '-', '_'로 된 64자 이하여야 합니다: " + key_id);
+	}
+	key_id_ = move(key_id);
+}
+
+void ServerLink::connect() {
+	if (!uses_socket() || connection_) return;
+	connection_ = make_unique<SocketConnection>(SocketConnection::connect(parse_endpoint(connect_address_)));
+	key_session_registered_ = false;
+}
+
+void ServerLink::register_key_session(const ClientKeys& keys) {
+	if (!connection_ || key_id_.empty()) return;
+	try {
+		client_.register_key_session(*connection_, key_id_, keys);
+	}
+	catch (const ServerError&) {
+		// 서버가 거절한 경우: 요청/응답이 짝을 이루므로 연결은 그대로 쓸 수 있다
+		key_session_registered_ = false;
+		throw;
+	}
+	catch (...) {
+		connection_.reset();
+		throw;
+	}
+	key_session_registered_ = true;
+}
+
+size_t ServerLink::upload_keys(const ClientKeys& keys, bool with_secret_key) {
+	if (!uses_socket() || !key_id_.empty()) {
+		// 키 세션은 서버가 keys/<key_id>/에서 읽어 병원별로 들고 있는다
+		fs::path key_dir = key_id_.empty() ? channel_dir_ : channel_dir_ / "keys" / key_id_;
+		if (key_id_.empty()) HospitalClient::upload_keys(key_dir, keys, with_secret_key);
+		else HospitalClient::upload_session_keys(channel_dir_, key_id_, keys, with_secret_key);
+		size_t bytes = 0;
+		for (const char* name : { "pub_key.dat", "secret_key.dat", "relin_keys.dat", "galois_keys.dat" }) {
+			error_code ec;
+			uintmax_t size = fs::file_size(key_dir / name, ec);
+			if (!ec) bytes += static_cast<size_t>(size);
+		}
+		cout << "[Client] Keys uploaded to " << key_dir.string() << " (" << bytes << " bytes).\n";
+		if (!uses_socket()) return bytes;
+
+		// 소켓은 연결하고 키 세션만 등록한다 (요청 헤더의 key_id로 서버가 키 세션을 찾음).
+		// 이미 열린 연결도 새 키로 다시 등록한다
+		connect();
+		register_key_session(keys);
+		return bytes;
+	}
+
+	// 서버는 이 연결이 끝날 때까지 키를 메모리에 둔다. 같은 연결에서 다시 보내면 키를 바꾼다
+	Endpoint endpoint = parse_endpoint(connect_address_);
+	if (!connection_) connection_ = make_unique<SocketConnection>(SocketConnection::connect(endpoint));
+	string payload = HospitalClient::serialize_keys(keys, with_secret_key);
+	try {
+		connection_->send(with_secret_key ? MessageType::keys : MessageType::public_keys, payload);
+	}
+	catch (...) {
+		connection_.reset();
+		throw;
+	}
+	cout << "[Client] Keys sent to " << describe_endpoint(endpoint) << " (" << payload.size() << " bytes).\n";
+	return payload.size();
+}
+
+ScoreReply ServerLink::score(const ClientKeys& keys, const vector<vector<double>>& patients,
+	ResponseMode response_mode, int timeout_ms) {
+	string request_id = make_request_id();
+	size_t patient_count = patients.size();
+
+	if (uses_socket()) {
+		if (!connection_) throw runtime_error("Keys must be sent before requests");
+		// 다시 연결한 뒤에는 (데몬의 재연결 등) 첫 요청 전에 키 세션을 등록한다
+		if (!key_id_.empty() && !key_session_registered_) register_key_session(keys);
+
+		// 같은 연결로 요청 프레임을 보내고 응답 프레임을 기다린다
+		ostringstream request_stream;
+		size_t ciphertext_count = client_.write_request(request_stream, keys, patients, response_mode, key_id_);
+		Frame reply;
+		try {
+			connection_->send(MessageType::request, request_stream.view());
+
+			cout << "[Client] Data encrypted locally (" << ciphertext_count << " ciphertext(s), "
+				<< request_stream.view().size() << " bytes). (request " << request_id << ")" << "\n";
+			cout << "[Client] Waiting for result..." << "\n";
+
+			if (!connection_->receive(reply)) throw runtime_error("Server closed the connection");
+		}
+		catch (...) {
+			// 프레임 중간에 끊긴 연결은 다시 쓸 수 없다
+			connection_.reset();
+			throw;
+		}
+
+		if (reply.type == MessageType::response) return decode_scores(reply.payload);
+		if (reply.type == MessageType::encrypted_response) {
+			ScoreReply scores = client_.decrypt_response(reply.payload, keys, patient_count);
+			cout << "[Client] Encrypted result received (" << reply.payload.size() << " bytes) and decrypted locally.\n";
+			return scores;
+		}
+		throw ServerError(reply.payload);
+	}
+
+	// 키 파일은 이미 rename으로 게시되었으므로 대기 없이 요청 파일 보내기
+	ChannelWatcher response_watcher(channel_dir_ / "responses");
+	fs::path request_path = channel_dir_ / "requests" / (request_id + ".ckks");
+	fs::create_directories(request_path.parent_path());
+	streamoff request_bytes = 0;
+	size_t ciphertext_count = 0;
+	write_file_atomic(request_path, [&](ostream& req_file) {
+		ciphertext_count = client_.write_request(req_file, keys, patients, response_mode, key_id_);
+		// 게시 직후 서버가 파일을 가져갈 수 있으므로 크기는 쓰는 중에 기록
+		request_bytes = req_file.tellp();
+	}, true);
+
+	cout << "[Client] Data encrypted locally (" << ciphertext_count << " ciphertext(s), "
+		<< request_bytes << " bytes). (requests/" << request_id << ".ckks)" << "\n";
+	cout << "[Client] Waiting for result..." << "\n";
+
+	// 결과 암호문(.cresp) 또는 서버가 복호화한 평문 결과(.resp) (inotify)
+	// 서버는 응답을 rename으로 게시하므로 파일이 보이면 이미 완성된 상태
+	string response_name = response_watcher.wait_for_any(
+		{ request_id + ".cresp", request_id + ".resp", request_id + ".err" }, timeout_ms);
+	if (response_name.empty()) {
+		// 늦게 처리되지 않도록 아직 남아 있는 요청은 거둬들인다
+		error_code ec;
+		fs::remove(request_path, ec);
+		throw runtime_error("Timed out waiting for the server response");
+	}
+	fs::path response_path = response_watcher.dir() / response_name;
+
+	ScoreReply reply;
+	if (response_name == request_id + ".err") {
+		ifstream err_file(response_path);
+		string message((istreambuf_iterator<char>(err_file)), istreambuf_iterator<char>());
+		err_file.close();
+		fs::remove(response_path);
+		throw ServerError(message);
+	}
+	if (response_name == request_id + ".cresp") {
+		{
+			MappedFile response_file(response_path);
+			reply = client_.decrypt_response(response_file.bytes(), keys, patient_count);
+			cout << "[Client] Encrypted result received (" << response_file.bytes().size()
+				<< " bytes) and decrypted locally.\n";
+		}
+		fs::remove(response_path);
+	}
+	else {
+		ifstream resp_file(response_path);
+		reply = read_plain_response(resp_file);
+		resp_file.close();
+		fs::remove(response_path);
+	}
+	return reply;
+}
@@ -0,0 +1,141 @@
+﻿#pragma once
+#include "seal/seal.h"
+#include "../Common/batch_layout.h"
+#include "../Common/ckks_request.h"
+#include "../Common/param_planner.h"
+#include "../Common/socket_transport.h"
+#include <filesystem>
+#include <iosfwd>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// --- 병원 클라이언트의 암호화/복호화 (한 번 실행하는 client_main과 상주 데몬이 공유) ---
+// 회로에서 정한 SEALContext, 인코더, 슬롯 배치를 한 번 만들어 두고 요청마다 재사용한다.
+// 키는 ClientKeys 묶음으로 따로 다루므로 keystore에서 읽은 키와 새로 만든 키를 같은 방식으로 쓴다.
+
+// 비밀키는 plain 응답(디버깅용)일 때만 서버에 올라간다
+struct ClientKeys {
+	seal::SecretKey secret_key;
+	seal::PublicKey public_key;
+	seal::RelinKeys relin_keys;
+	seal::GaloisKeys galois_keys;
+};
+
+// raw_data.txt 형식: 한 줄에 값 하나씩이면 환자 1명 (result_app.py), 한 줄에 여러 값(공백/쉼표 구분)이면 한 줄이 환자 1명
+struct PatientRows {
+	std::vector<std::vector<double>> patients;
+	bool is_batch = false;
+};
+
+// 값이 없거나 개수가 feature_count와 맞지 않으면 runtime_error (메시지는 사용자에게 그대로 보여 줌)
+PatientRows parse_patient_rows(std::istream& in, size_t feature_count);
+
+class HospitalClient {
+public:
+	explicit HospitalClient(const CircuitSpec& circuit);
+
+	HospitalClient(const HospitalClient&) = delete;
+	HospitalClient& operator=(const HospitalClient&) = delete;
+
+	const CircuitSpec& circuit() const { return circuit_; }
+	const ParameterPlan& plan() const { return plan_; }
+	const seal::SEALContext& context() const { return context_; }
+	const BatchLayout& layout() const { return layout_; }
+	// 로지스틱 회로는 4개 (age, trestbps, chol, thalach), MLP 회로는 회로 이름의 입력 수
+	size_t feature_count() const { return layout_.feature_count; }
+
+	// 회로에 필요한 회전 폭의 GaloisKeys만 만든다 (전체 회전 키는 수십 MB)
+	std::shared_ptr<const ClientKeys> generate_keys() const;
+
+	// 소켓 keys / public_keys 프레임 내용 (socket_transport.h 순서)
+	static std::string serialize_keys(const ClientKeys& keys, bool with_secret_key);
+	// Shared_Channel에 키 파일을 원자적으로 게시. with_secret_key가 false이면 남아 있는 secret_key.dat를 지운다
+	static void upload_keys(const std::filesystem::path& channel_dir, const ClientKeys& keys, bool with_secret_key);
+	// channel_dir/keys/<key_id>/에 키 세션을 게시. 디렉터리는 소유자와 그룹만 읽을 수 있게 만든다 (다른 병원 차단,
+	// 서버 계정은 병원 그룹에 넣음). 권한을 바꿀 수 없으면 (다른 사용자가 먼저 만든 디렉터리 등) runtime_error
+	static void upload_session_keys(const std::filesystem::path& channel_dir, const std::string& key_id,
+		const ClientKeys& keys, bool with_secret_key);
+
+	// 연결에서 key_id 세션을 쓰겠다고 등록한다: key_session 요청 → 서버가 세션 공개키로 암호화한 key_challenge를
+	// 비밀키로 풀어 답한다 (socket_transport.h). 서버가 거절하면 ServerError, 통신/형식 오류는 runtime_error
+	void register_key_session(SocketConnection& connection, const std::string& key_id, const ClientKeys& keys) const;
+
+	// 요청 헤더 + seed 압축 암호문 (소켓 request 프레임과 .ckks 파일이 같은 형식, ckks_request.h)
+	// key_id가 있으면 서버는 공용 키 대신 그 키 세션으로 연산한다. 반환값은 암호문 개수
+	size_t write_request(std::ostream& out, const ClientKeys& keys,
+		const std::vector<std::vector<double>>& patients, ResponseMode response_mode,
+		const std::string& key_id = std::string()) const;
+
+	// 암호문 응답을 복호화하여 환자 순, 모델 순 점수로 (sigmoid를 암호 상태에서 계산하지 않는 회로는 여기서 적용)
+	// 요청과 환자 수/암호문 수가 맞지 않으면 runtime_error
+	ScoreReply decrypt_response(std::string_view bytes, const ClientKeys& keys, size_t patient_count) const;
+
+private:
+	CircuitSpec circuit_;
+	ParameterPlan plan_;
+	seal::SEALContext context_;
+	seal::CKKSEncoder encoder_;
+	BatchLayout layout_;
+};
+
+// 서버가 요청을 처리하지 못했다고 알려 온 경우 (error 프레임 또는 <id>.err). 통신 오류와 구분하기 위함
+struct ServerError : std::runtime_error {
+	using std::runtime_error::runtime_error;
+};
+
+// 다른 병원의 요청과 섞이지 않도록 시각 + 난수
+std::string make_request_id();
+
+// 서버가 복호화한 평문 응답 (<id>.resp): 첫 줄 "# <모델 이름들>", 이후 환자별 모델 점수
+ScoreReply read_plain_response(std::istream& in);
+
+// --- 서버와의 연결 (소켓 또는 Shared_Channel 파일 교환) ---
+// connect_address가 비어 있으면 Shared_Channel 파일 교환, 아니면 --connect 주소로 소켓 하나를 유지한다.
+// 소켓은 키를 보낸 연결에서만 요청을 처리하므로 upload_keys가 연결을 연다.
+// key_id를 정하면 키를 Shared_Channel/keys/<key_id>/에 게시하고 요청 헤더에 key_id를 넣는다.
+// 서버는 그 병원의 키를 세션으로 들고 있다가 재사용하므로, 소켓도 연결마다 키를 다시 보내지 않는다.
+// 대신 연결마다 한 번 key_challenge에 답해 그 세션의 비밀키를 가졌음을 보인다 (첫 요청 전에 자동으로).
+class ServerLink {
+public:
+	ServerLink(const HospitalClient& client, std::string connect_address,
+		std::filesystem::path channel_dir = "Shared_Channel");
+
+	bool uses_socket() const { return !connect_address_.empty(); }
+	const std::filesystem::path& channel_dir() const { return channel_dir_; }
+
+	// 비우면 Shared_Channel의 공용 키 (병원 하나). valid_key_id가 아니면 invalid_argument
+	void set_key_id(std::string key_id);
+	const std::string& key_id() const { return key_id_; }
+
+	// 소켓: 연결이 없으면 연결한 뒤 keys(public_keys) 프레임 전송, 파일: Shared_Channel에 키 파일 게시
+	// (key_id가 있으면 소켓이어도 keys/<key_id>/에 게시하고, 연결한 뒤 키 세션만 등록한다)
+	// 보낸 바이트 수를 돌려준다. 연결/쓰기 오류는 runtime_error
+	size_t upload_keys(const ClientKeys& keys, bool with_secret_key);
+
+	// 요청 하나를 암호화해 보내고 응답을 점수로 돌려준다 (암호문 응답은 keys로 복호화).
+	// 서버가 보낸 오류는 ServerError, 통신/형식 오류는 runtime_error.
+	// timeout_ms는 파일 교환의 응답 대기 한도 (음수면 무한 대기, 소켓은 연결이 끊기면 오류)
+	ScoreReply score(const ClientKeys& keys, const std::vector<std::vector<double>>& patients,
+		ResponseMode response_mode, int timeout_ms = -1);
+
+	// 키를 보내지 않고 소켓 연결만 연다 (key_id 세션의 키가 이미 게시된 경우, 파일 교환이면 아무것도 하지 않음)
+	// key_id 세션은 다음 score에서 등록한다 (등록에 키가 필요함)
+	void connect();
+	// 소켓 연결을 닫는다 (다음 upload_keys에서 다시 연결)
+	void disconnect() { connection_.reset(); }
+	bool connected() const { return connection_ != nullptr; }
+
+private:
+	// 열린 연결에 key_id 세션을 등록한다 (key_id가 없으면 아무것도 하지 않음). 통신 오류면 연결을 닫는다
+	void register_key_session(const ClientKeys& keys);
+
+	const HospitalClient& client_;
+	std::string connect_address_;
+	std::filesystem::path channel_dir_;
+	std::string key_id_;
+	bool key_session_registered_ = false;   // 지금 연결에서 key_id 세션을 등록했는지
+	std::unique_ptr<SocketConnection> connection_;
+};
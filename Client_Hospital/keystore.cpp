@@ -0,0 +1,101 @@
+﻿#include "keystore.h"
+#include "../Common/blob_loader.h"
+#include "../Common/channel.h"
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <system_error>
+
+using namespace std;
+using namespace seal;
+namespace fs = std::filesystem;
+
+// parms_id (64비트 4개)를 16진수 문자열로: 회로가 같아도 planner가 바뀌면 다른 값이 된다
+static string parms_id_text(const SEALContext& context) {
+	ostringstream text;
+	text << hex << setfill('0');
+	for (uint64_t word : context.key_parms_id()) text << setw(16) << word;
+	return text.str();
+}
+
+static void restrict_to_owner(const fs::path& path, bool directory) {
+	error_code ec;
+	fs::perms owner = fs::perms::owner_read | fs::perms::owner_write;
+	if (directory) owner |= fs::perms::owner_exec;
+	fs::permissions(path, owner, fs::perm_options::replace, ec);
+}
+
+bool Keystore::load(const HospitalClient& client, StoredKeys& stored) const {
+	ifstream index(dir_ / "keystore.txt");
+	if (!index.is_open()) return false;
+
+	string circuit, parms_id, key_dir;
+	long long created = -1;
+	string key, value;
+	while (index >> key >> value) {
+		if (key == "circuit") circuit = value;
+		else if (key == "parms_id") parms_id = value;
+		else if (key == "keys") key_dir = value;
+		else if (key == "created") {
+			try {
+				created = stoll(value);
+			}
+			catch (const exception&) {
+				return false;
+			}
+		}
+	}
+	if (circuit != circuit_name(client.circuit()) || parms_id != parms_id_text(client.context())) return false;
+	if (key_dir.empty() || key_dir.find_first_of("/\\") != string::npos || created < 0) return false;
+
+	// SEAL load가 키와 context의 파라미터 일치를 다시 검사한다
+	try {
+		auto keys = make_shared<ClientKeys>();
+		fs::path dir = dir_ / key_dir;
+		load_mapped(client.context(), dir / "secret_key.dat", keys->secret_key);
+		load_mapped(client.context(), dir / "pub_key.dat", keys->public_key);
+		load_mapped(client.context(), dir / "relin_keys.dat", keys->relin_keys);
+		load_mapped(client.context(), dir / "galois_keys.dat", keys->galois_keys);
+		stored.keys = move(keys);
+	}
+	catch (const exception&) {
+		return false;
+	}
+	stored.created = chrono::system_clock::time_point(chrono::seconds(created));
+	return true;
+}
+
+void Keystore::save(const HospitalClient& client, const StoredKeys& stored) const {
+	long long created = chrono::duration_cast<chrono::seconds>(stored.created.time_since_epoch()).count();
+	string key_dir = "keys-" + to_string(created);
+
+	fs::create_directories(dir_ / key_dir);
+	restrict_to_owner(dir_, true);
+	restrict_to_owner(dir_ / key_dir, true);
+
+	const ClientKeys& keys = *stored.keys;
+	fs::path dir = dir_ / key_dir;
+	write_file_atomic(dir / "secret_key.dat", [&](ostream& out) { keys.secret_key.save(out); }, true);
+	write_file_atomic(dir / "pub_key.dat", [&](ostream& out) { keys.public_key.save(out); }, true);
+	write_file_atomic(dir / "relin_keys.dat", [&](ostream& out) { keys.relin_keys.save(out); }, true);
+	write_file_atomic(dir / "galois_keys.dat", [&](ostream& out) { keys.galois_keys.save(out); }, true);
+	restrict_to_owner(dir / "secret_key.dat", false);
+
+	// 세대 디렉토리가 완성된 뒤에 가리키게 한다
+	write_file_atomic(dir_ / "keystore.txt", [&](ostream& out) {
+		out << "circuit " << circuit_name(client.circuit()) << "\n"
+			<< "parms_id " << parms_id_text(client.context()) << "\n"
+			<< "created " << created << "\n"
+			<< "keys " << key_dir << "\n";
+	});
+
+	// 이전 세대 정리 (실패해도 다음 저장 때 다시 지운다)
+	error_code ec;
+	for (const auto& entry : fs::directory_iterator(dir_, ec)) {
+		string name = entry.path().filename().string();
+		if (entry.is_directory() && name.rfind("keys-", 0) == 0 && name != key_dir) {
+			fs::remove_all(entry.path(), ec);
+		}
+	}
+}
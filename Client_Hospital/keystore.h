@@ -0,0 +1,39 @@
+﻿#pragma once
+#include "hospital_client.h"
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <utility>
+
+// --- 로컬 키 저장소 (클라이언트 데몬) ---
+// 키 생성(KeyGenerator + RelinKeys + GaloisKeys)은 클라이언트 실행 시간의 대부분이므로,
+// 만든 키를 디스크에 두고 회전 주기가 지날 때까지 다시 쓴다.
+//
+//   <dir>/keystore.txt        circuit, parms_id, created (unix 초), keys (키 세대 디렉토리 이름)
+//   <dir>/keys-<created>/     secret_key.dat, pub_key.dat, relin_keys.dat, galois_keys.dat
+//
+// 키 파일을 새 세대 디렉토리에 모두 쓴 뒤 keystore.txt를 원자적으로 바꾸므로,
+// 저장 중에 꺼져도 이전 세대나 새 세대 중 하나가 온전히 남는다. 이전 세대 디렉토리는 그 뒤에 지운다.
+// 비밀키가 들어 있으므로 POSIX에서는 디렉토리와 파일을 소유자만 읽을 수 있게 만든다.
+
+struct StoredKeys {
+	std::shared_ptr<const ClientKeys> keys;
+	std::chrono::system_clock::time_point created;
+};
+
+class Keystore {
+public:
+	explicit Keystore(std::filesystem::path dir) : dir_(std::move(dir)) {}
+
+	// 같은 회로/파라미터(parms_id)로 만든 키가 있으면 읽어 들인다.
+	// 없거나 다른 파라미터이거나 파일이 손상되었으면 false (호출자가 새로 만들어 save)
+	bool load(const HospitalClient& client, StoredKeys& stored) const;
+
+	// 새 세대로 저장하고 이전 세대를 지운다. 쓰기 오류는 예외로 전달
+	void save(const HospitalClient& client, const StoredKeys& stored) const;
+
+	const std::filesystem::path& dir() const { return dir_; }
+
+private:
+	std::filesystem::path dir_;
+};
@@ -0,0 +1,119 @@
+﻿#include "batch_layout.h"
+#include <stdexcept>
+#include <algorithm>
+
+using namespace std;
+
+BatchLayout make_batch_layout(size_t feature_count, size_t slot_count) {
+    if (feature_count == 0) throw runtime_error("Feature count must be positive!");
+
+    BatchLayout layout;
+    layout.feature_count = feature_count;
+    layout.slot_count = slot_count;
+    layout.block_size = 1;
+    while (layout.block_size < feature_count) layout.block_size <<= 1;
+
+    if (layout.block_size > slot_count) throw runtime_error("Feature count exceeds slot count!");
+    layout.patients_per_ciphertext = slot_count / layout.block_size;
+    return layout;
+}
+
+BatchLayout make_dense_layout(size_t feature_count, size_t hidden_count, size_t slot_count) {
+    if (feature_count == 0 || hidden_count == 0) throw runtime_error("Feature and hidden counts must be positive!");
+
+    size_t width = 1;
+    while (width < max(feature_count, hidden_count)) width <<= 1;
+    if (width * 2 > slot_count) throw runtime_error("MLP layer width exceeds slot count!");
+
+    BatchLayout layout;
+    layout.feature_count = feature_count;
+    layout.slot_count = slot_count;
+    layout.replicas = 2;
+    layout.block_size = width * 2;
+    layout.patients_per_ciphertext = slot_count / layout.block_size;
+    return layout;
+}
+
+vector<vector<double>> pack_patients(const BatchLayout& layout,
+    const vector<vector<double>>& patients) {
+    vector<vector<double>> packed;
+    for (size_t first = 0; first < patients.size(); first += layout.patients_per_ciphertext) {
+        size_t count = min(layout.patients_per_ciphertext, patients.size() - first);
+        vector<double> slots(count * layout.block_size, 0.0);
+        for (size_t p = 0; p < count; p++) {
+            const auto& features = patients[first + p];
+            if (features.size() != layout.feature_count) {
+                throw runtime_error("Patient " + to_string(first + p) + " has wrong feature count!");
+            }
+            for (size_t r = 0; r < layout.replicas; r++) {
+                copy(features.begin(), features.end(), slots.begin() + p * layout.block_size + r * layout.vector_width());
+            }
+        }
+        packed.push_back(move(slots));
+    }
+    return packed;
+}
+
+vector<double> replicate_per_block(const BatchLayout& layout,
+    const vector<double>& block_values, size_t patient_count) {
+    if (block_values.size() > layout.block_size) throw runtime_error("Block values exceed block size!");
+
+    vector<double> slots(patient_count * layout.block_size, 0.0);
+    for (size_t p = 0; p < patient_count; p++) {
+        copy(block_values.begin(), block_values.end(), slots.begin() + p * layout.block_size);
+    }
+    return slots;
+}
+
+vector<int> rotation_steps(const BatchLayout& layout) {
+    vector<int> steps;
+    for (size_t step = 1; step < layout.vector_width(); step <<= 1) {
+        steps.push_back(static_cast<int>(step));
+    }
+    return steps;
+}
+
+size_t dense_baby_step(const BatchLayout& layout) {
+    size_t baby_step = 1;
+    while (baby_step * baby_step < layout.vector_width()) baby_step <<= 1;
+    return baby_step;
+}
+
+vector<int> dense_rotation_steps(const BatchLayout& layout) {
+    size_t width = layout.vector_width();
+    size_t baby_step = dense_baby_step(layout);
+
+    vector<int> steps = rotation_steps(layout);
+    for (size_t step = 1; step < baby_step; step++) steps.push_back(static_cast<int>(step));
+    for (size_t step = baby_step; step < width; step += baby_step) steps.push_back(static_cast<int>(step));
+    steps.push_back(-static_cast<int>(width));
+
+    sort(steps.begin(), steps.end());
+    steps.erase(unique(steps.begin(), steps.end()), steps.end());
+    return steps;
+}
+
+vector<double> extract_block_leading(const BatchLayout& layout,
+    const vector<double>& slots, size_t patient_count) {
+    vector<double> scores(patient_count, 0.0);
+    for (size_t p = 0; p < patient_count && p * layout.block_size < slots.size(); p++) {
+        scores[p] = slots[p * layout.block_size];
+    }
+    return scores;
+}
+
+vector<double> bit_encode(const vector<double>& slots, int scale) {
+    if (scale == 0) return slots;
+
+    vector<double> encoded;
+    encoded.reserve(slots.size());
+    for (double val : slots) {
+        // 0.0~1.0 범위를 0~scale 정수로 변환한 뒤 다시 double로 (CKKS는 실수 연산)
+        encoded.push_back(static_cast<double>(static_cast<int>(val * scale)));
+    }
+    return encoded;
+}
+
+double bit_weight_factor(int scale) {
+    return scale == 0 ? 1.0 : 1.0 / scale;
+}
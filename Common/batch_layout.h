@@ -0,0 +1,66 @@
+﻿#pragma once
+#include <vector>
+#include <cstddef>
+
+// --- 입력 인코딩 규약 (클라이언트 암호화와 서버 연산이 같은 값을 써야 함) ---
+// 비트 인코딩: 정규화된 값(0.0~1.0)을 정수로 변환 (예: 0.123 → 1230, 스케일 10000)
+const int bit_scale = 10000; // 10진수 4자리 정밀도 (기본값, 회로마다 CircuitSpec::input_bit_scale로 바꿀 수 있음)
+
+// --- 배치 슬롯 배치 (Slot Packing) ---
+// CKKS 암호문 하나에는 slot_count개의 실수가 들어간다.
+// 환자 한 명의 특성(feature) 벡터를 block_size 크기의 블록에 넣고,
+// 블록을 나란히 이어 붙여 암호문 하나로 여러 환자를 동시에 처리한다.
+//
+//   slot: | p0 f0 f1 f2 f3 | p1 f0 f1 f2 f3 | p2 ... |
+//
+// block_size는 feature_count 이상인 최소 2의 거듭제곱 (회전 연산과 정렬을 맞추기 위함)
+//
+// 밀집층(행렬-벡터 곱)이 있는 MLP 회로는 블록 안에 같은 벡터를 두 번 이어 붙인다.
+//
+//   slot: | p0 x0 x1 .. x(d-1) x0 x1 .. x(d-1) | p1 ... |
+//
+// 암호문 전체를 i칸 회전해도 블록 앞쪽 절반에는 x[(t + i) mod d]가 오므로 블록 안에서 순환 회전한 것과 같다.
+struct BatchLayout {
+    size_t feature_count = 0;
+    size_t block_size = 0;
+    size_t slot_count = 0;
+    size_t patients_per_ciphertext = 0;
+    size_t replicas = 1;  // 블록 안에 벡터를 반복하는 횟수 (MLP 회로는 2)
+
+    // 블록 안 벡터 하나의 폭 d
+    size_t vector_width() const { return block_size / replicas; }
+};
+
+BatchLayout make_batch_layout(size_t feature_count, size_t slot_count);
+
+// MLP 회로용: d는 입력 특성 수와 은닉층 크기 이상인 최소 2의 거듭제곱, 블록 크기는 2d
+BatchLayout make_dense_layout(size_t feature_count, size_t hidden_count, size_t slot_count);
+
+// 환자 목록을 암호문 단위의 슬롯 벡터들로 나눈다 (마지막 암호문은 남는 블록이 0, 블록 안에 replicas번 반복)
+std::vector<std::vector<double>> pack_patients(const BatchLayout& layout,
+    const std::vector<std::vector<double>>& patients);
+
+// block_values(길이 <= block_size)를 patient_count개의 블록에 반복 배치
+std::vector<double> replicate_per_block(const BatchLayout& layout,
+    const std::vector<double>& block_values, size_t patient_count);
+
+// 블록 내 회전-합산에 필요한 회전 폭 (1, 2, 4, ..., vector_width / 2)
+// 클라이언트는 이 회전들에 대한 GaloisKeys만 생성하면 된다.
+std::vector<int> rotation_steps(const BatchLayout& layout);
+
+// 대각선 행렬-벡터 곱의 baby step 크기 g (g * g >= d인 최소 2의 거듭제곱, giant step은 d / g번)
+size_t dense_baby_step(const BatchLayout& layout);
+
+// MLP 회로에 필요한 회전 폭 전체 (오름차순)
+//   baby step 1 .. g-1, giant step g, 2g, .., d-g, 블록 뒤쪽 절반 복제 -d, 출력층 회전-합산
+std::vector<int> dense_rotation_steps(const BatchLayout& layout);
+
+// 복호화된 슬롯 벡터에서 각 블록의 첫 슬롯 값을 환자별 점수로 꺼낸다
+std::vector<double> extract_block_leading(const BatchLayout& layout,
+    const std::vector<double>& slots, size_t patient_count);
+
+// 슬롯 값을 scale배 정수 값으로 변환 (CKKS 인코딩 직전에 적용, scale이 0이면 정수화하지 않고 그대로)
+std::vector<double> bit_encode(const std::vector<double>& slots, int scale = bit_scale);
+
+// bit_encode한 입력에 곱하는 가중치 보정 (1 / scale, scale이 0이면 1)
+double bit_weight_factor(int scale = bit_scale);
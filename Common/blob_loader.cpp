@@ -0,0 +1,107 @@
+﻿#include "blob_loader.h"
+#include <fstream>
+#include <utility>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+namespace fs = std::filesystem;
+
+// 매핑에 성공하면 true (실패하면 호출자가 fallback으로 읽음)
+static bool map_file(const fs::path& path, void*& mapping, const char*& data, size_t& size) {
+#ifdef _WIN32
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER file_size{};
+    bool ok = GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0;
+    HANDLE section = ok ? CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+    CloseHandle(file);
+    if (!section) return false;
+
+    // view가 section을 참조하므로 section 핸들은 바로 닫아도 된다
+    void* view = MapViewOfFile(section, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(section);
+    if (!view) return false;
+
+    mapping = view;
+    data = static_cast<const char*>(view);
+    size = static_cast<size_t>(file_size.QuadPart);
+    return true;
+#else
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+
+    struct stat st {};
+    void* view = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    // 매핑은 fd를 닫아도 유지된다
+    ::close(fd);
+    if (view == MAP_FAILED) return false;
+
+    // 역직렬화는 앞에서부터 한 번 훑으므로 미리 읽어 두게 함
+    madvise(view, static_cast<size_t>(st.st_size), MADV_WILLNEED);
+    mapping = view;
+    data = static_cast<const char*>(view);
+    size = static_cast<size_t>(st.st_size);
+    return true;
+#endif
+}
+
+MappedFile::MappedFile(const fs::path& path) {
+    if (map_file(path, mapping_, data_, size_)) return;
+
+    // 빈 파일이거나 매핑할 수 없는 파일 시스템: 한 번 읽어 들임
+    ifstream in(path, ios::binary);
+    if (!in.is_open()) throw runtime_error("Failed to open " + path.string());
+    fallback_.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+    data_ = fallback_.data();
+    size_ = fallback_.size();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : data_(other.data_), size_(other.size_), mapping_(other.mapping_), fallback_(move(other.fallback_)) {
+    other.data_ = nullptr;
+    other.size_ = 0;
+    other.mapping_ = nullptr;
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        release();
+        data_ = exchange(other.data_, nullptr);
+        size_ = exchange(other.size_, 0);
+        mapping_ = exchange(other.mapping_, nullptr);
+        fallback_ = move(other.fallback_);
+    }
+    return *this;
+}
+
+MappedFile::~MappedFile() {
+    release();
+}
+
+void MappedFile::release() {
+    if (mapping_) {
+#ifdef _WIN32
+        UnmapViewOfFile(mapping_);
+#else
+        munmap(mapping_, size_);
+#endif
+    }
+    mapping_ = nullptr;
+    data_ = nullptr;
+    size_ = 0;
+    fallback_.clear();
+}
@@ -0,0 +1,106 @@
+﻿#pragma once
+#include "seal/seal.h"
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// --- 키/암호문 blob의 복사 없는 로딩 (서버/클라이언트 공용) ---
+// ifstream으로 읽으면 파일 → iostream 버퍼 → SEAL 객체로 수 MB가 한 번 더 복사된다.
+// 파일은 mmap하고 (소켓 프레임은 받은 버퍼 그대로) SEAL의 바이트 버퍼 load(context, data, size)로
+// 바로 역직렬화하여 중간 복사를 없앤다. mmap을 쓸 수 없으면 파일을 한 번 읽어 들이고 그 양을 bytes_copied로 센다.
+
+// 로그/지표용 통계 (여러 blob을 합산할 수 있음)
+struct BlobLoadStats {
+    size_t blobs = 0;
+    size_t bytes_in_place = 0;  // mmap 또는 수신 버퍼에서 바로 역직렬화한 바이트
+    size_t bytes_copied = 0;    // 중간 버퍼로 복사한 바이트 (mmap 불가 시)
+    double load_ms = 0.0;       // 매핑 + 역직렬화 시간
+
+    void add(const BlobLoadStats& other) {
+        blobs += other.blobs;
+        bytes_in_place += other.bytes_in_place;
+        bytes_copied += other.bytes_copied;
+        load_ms += other.load_ms;
+    }
+};
+
+// --- 읽기 전용 파일 매핑 (move만 가능) ---
+// 열 수 없으면 runtime_error. 빈 파일은 매핑하지 않고 빈 bytes()를 돌려준다.
+class MappedFile {
+public:
+    explicit MappedFile(const std::filesystem::path& path);
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    std::string_view bytes() const { return { data_, size_ }; }
+    // false이면 fallback 버퍼로 읽은 것 (그만큼 복사됨)
+    bool mapped() const { return mapping_ != nullptr; }
+
+private:
+    void release();
+
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    void* mapping_ = nullptr;        // 매핑 시작 주소 (POSIX) 또는 view (Windows)
+    std::vector<char> fallback_;
+};
+
+// --- 메모리 blob에서 SEAL 객체와 고정 크기 값을 차례로 꺼내는 reader ---
+// 오류(잘림, 형식 불일치)는 SEAL 또는 runtime_error 예외로 전달된다.
+class BlobReader {
+public:
+    explicit BlobReader(std::string_view bytes) : bytes_(bytes) {}
+
+    template <class T>
+    void load(const seal::SEALContext& context, T& object) {
+        auto data = reinterpret_cast<const seal::seal_byte*>(bytes_.data() + offset_);
+        offset_ += static_cast<size_t>(object.load(context, data, remaining()));
+    }
+
+    template <class T>
+    T read_pod() {
+        if (remaining() < sizeof(T)) throw std::runtime_error("Blob is truncated!");
+        T value{};
+        std::memcpy(&value, bytes_.data() + offset_, sizeof(T));
+        offset_ += sizeof(T);
+        return value;
+    }
+
+    std::string_view read_bytes(size_t size) {
+        if (remaining() < size) throw std::runtime_error("Blob is truncated!");
+        std::string_view view = bytes_.substr(offset_, size);
+        offset_ += size;
+        return view;
+    }
+
+    size_t offset() const { return offset_; }
+    size_t remaining() const { return bytes_.size() - offset_; }
+
+private:
+    std::string_view bytes_;
+    size_t offset_ = 0;
+};
+
+// path를 매핑해 object 하나를 역직렬화하고 통계를 돌려준다
+template <class T>
+BlobLoadStats load_mapped(const seal::SEALContext& context, const std::filesystem::path& path, T& object) {
+    auto start = std::chrono::steady_clock::now();
+    MappedFile file(path);
+    BlobReader reader(file.bytes());
+    reader.load(context, object);
+
+    BlobLoadStats stats;
+    stats.blobs = 1;
+    (file.mapped() ? stats.bytes_in_place : stats.bytes_copied) = file.bytes().size();
+    stats.load_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return stats;
+}
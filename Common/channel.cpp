@@ -0,0 +1,115 @@
+﻿#include "channel.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <stdexcept>
+#include <thread>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+namespace fs = std::filesystem;
+
+void write_file_atomic(const fs::path& path, const function<void(ostream&)>& writer, bool binary) {
+    fs::path tmp_path = path;
+    tmp_path += ".tmp";
+
+    {
+        ofstream out(tmp_path, binary ? ios::binary : ios::out);
+        if (!out.is_open()) throw runtime_error("Failed to open " + tmp_path.string());
+        writer(out);
+        out.flush();
+        if (!out.good()) throw runtime_error("Failed to write " + tmp_path.string());
+    }
+
+    // 같은 디렉토리 안의 rename은 원자적: 읽는 쪽은 이전 파일 또는 완성된 새 파일만 본다
+    fs::rename(tmp_path, path);
+}
+
+ChannelWatcher::ChannelWatcher(const fs::path& dir) : dir_(dir) {
+    fs::create_directories(dir_);
+#ifdef __linux__
+    fd_ = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+    if (fd_ >= 0 && inotify_add_watch(fd_, dir_.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) < 0) {
+        close(fd_);
+        fd_ = -1;
+    }
+#endif
+}
+
+ChannelWatcher::~ChannelWatcher() {
+#ifdef __linux__
+    if (fd_ >= 0) close(fd_);
+#endif
+}
+
+string ChannelWatcher::wait_for_any(const vector<string>& names, int timeout_ms) {
+    auto deadline = chrono::steady_clock::now() + chrono::milliseconds(timeout_ms);
+
+    while (true) {
+        // watch를 먼저 걸어 둔 상태에서 존재 여부를 확인하므로 그 사이에 생긴 파일도 놓치지 않는다
+        for (const auto& name : names) {
+            if (fs::exists(dir_ / name)) return name;
+        }
+
+        int remaining = -1;
+        if (timeout_ms >= 0) {
+            auto left = chrono::duration_cast<chrono::milliseconds>(deadline - chrono::steady_clock::now()).count();
+            if (left <= 0) return "";
+            remaining = static_cast<int>(left);
+        }
+        wait_event(remaining);
+    }
+}
+
+vector<string> ChannelWatcher::list(const vector<string>& extensions) const {
+    vector<string> names;
+    for (const auto& entry : fs::directory_iterator(dir_)) {
+        if (!entry.is_regular_file()) continue;
+        string extension = entry.path().extension().string();
+        if (find(extensions.begin(), extensions.end(), extension) != extensions.end()) {
+            names.push_back(entry.path().filename().string());
+        }
+    }
+    sort(names.begin(), names.end());
+    return names;
+}
+
+vector<string> ChannelWatcher::wait_for_extension(const vector<string>& extensions, int timeout_ms) {
+    auto deadline = chrono::steady_clock::now() + chrono::milliseconds(timeout_ms);
+
+    while (true) {
+        vector<string> names = list(extensions);
+        if (!names.empty()) return names;
+
+        int remaining = -1;
+        if (timeout_ms >= 0) {
+            auto left = chrono::duration_cast<chrono::milliseconds>(deadline - chrono::steady_clock::now()).count();
+            if (left <= 0) return names;
+            remaining = static_cast<int>(left);
+        }
+        wait_event(remaining);
+    }
+}
+
+void ChannelWatcher::wait_event(int timeout_ms) {
+#ifdef __linux__
+    if (fd_ >= 0) {
+        pollfd pfd{ fd_, POLLIN, 0 };
+        if (poll(&pfd, 1, timeout_ms) > 0) {
+            // 이벤트 내용은 쓰지 않음 (호출자가 파일 존재로 다시 판단), 큐만 비운다
+            alignas(inotify_event) char buffer[4096];
+            while (read(fd_, buffer, sizeof(buffer)) > 0) {}
+        }
+        return;
+    }
+#endif
+    // inotify를 쓸 수 없는 환경: 짧은 간격으로 다시 확인
+    int interval = 10;
+    if (timeout_ms >= 0 && timeout_ms < interval) interval = timeout_ms;
+    this_thread::sleep_for(chrono::milliseconds(interval));
+}
@@ -0,0 +1,46 @@
+﻿#pragma once
+#include <filesystem>
+#include <functional>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+// --- Shared_Channel 파일 교환 도우미 (서버/클라이언트 공용) ---
+//
+// 1. 원자적 쓰기: "<이름>.tmp"에 모두 쓴 뒤 rename으로 제자리에 옮긴다.
+//    읽는 쪽은 완성된 파일만 보게 되므로 "쓰기 중일 수 있으니 대기" 같은 sleep이 필요 없다.
+// 2. 이벤트 대기: Linux에서는 inotify로 채널 디렉토리를 감시하여 파일이 들어오는 즉시 깨어난다.
+//    (그 외 플랫폼은 짧은 간격의 polling으로 대체)
+
+// writer가 스트림에 쓴 내용을 path에 원자적으로 게시
+void write_file_atomic(const std::filesystem::path& path,
+    const std::function<void(std::ostream&)>& writer, bool binary = false);
+
+class ChannelWatcher {
+public:
+    explicit ChannelWatcher(const std::filesystem::path& dir);
+    ~ChannelWatcher();
+
+    ChannelWatcher(const ChannelWatcher&) = delete;
+    ChannelWatcher& operator=(const ChannelWatcher&) = delete;
+
+    // names 중 하나가 디렉토리에 생길 때까지 대기 (앞쪽 이름 우선)
+    // 생긴 파일 이름을 반환, timeout_ms가 지나면 빈 문자열 (음수면 무한 대기)
+    std::string wait_for_any(const std::vector<std::string>& names, int timeout_ms = -1);
+
+    // 디렉토리 안에서 extensions 중 하나로 끝나는 파일 이름 목록 (이름순)
+    // 원자적 쓰기 중인 "<이름>.tmp"는 확장자가 다르므로 포함되지 않는다.
+    std::vector<std::string> list(const std::vector<std::string>& extensions) const;
+
+    // extensions 중 하나로 끝나는 파일이 하나 이상 생길 때까지 대기하여 목록을 반환 (timeout 시 빈 목록)
+    std::vector<std::string> wait_for_extension(const std::vector<std::string>& extensions, int timeout_ms = -1);
+
+    const std::filesystem::path& dir() const { return dir_; }
+
+private:
+    // 다음 이벤트(또는 timeout)까지 대기
+    void wait_event(int timeout_ms);
+
+    std::filesystem::path dir_;
+    int fd_ = -1;
+};
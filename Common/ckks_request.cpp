@@ -0,0 +1,111 @@
+﻿#include "ckks_request.h"
+#include "blob_loader.h"
+#include <algorithm>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+static const char request_magic[4] = { 'C', 'K', 'R', 'Q' };
+static const uint32_t request_version = 3;
+static const size_t max_key_id_length = 64;
+static const char response_magic[4] = { 'C', 'K', 'R', 'S' };
+static const uint32_t response_version = 1;
+
+bool valid_key_id(const string& key_id) {
+    if (key_id.empty() || key_id.size() > max_key_id_length) return false;
+    return all_of(key_id.begin(), key_id.end(), [](char c) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '-' || c == '_';
+    });
+}
+
+template <class T>
+static void write_pod(ostream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+void write_request_header(ostream& out, const CkksRequestHeader& header) {
+    out.write(request_magic, sizeof(request_magic));
+    write_pod(out, request_version);
+    write_pod(out, header.patient_count);
+    write_pod(out, header.feature_count);
+    write_pod(out, header.ciphertext_count);
+    write_pod(out, static_cast<uint32_t>(header.response_mode));
+    write_pod(out, static_cast<uint32_t>(header.key_id.size()));
+    out.write(header.key_id.data(), static_cast<streamsize>(header.key_id.size()));
+}
+
+CkksRequestHeader read_request_header(BlobReader& reader) {
+    if (reader.remaining() < sizeof(request_magic)
+        || !equal(begin(request_magic), end(request_magic), reader.read_bytes(sizeof(request_magic)).begin())) {
+        throw runtime_error("Not an encrypted request file!");
+    }
+    if (reader.remaining() < sizeof(uint32_t) + 3 * sizeof(uint64_t)) throw runtime_error("Encrypted request is truncated!");
+    // version 1은 response_mode가 없음 (plain), version 2는 key_id가 없음 (공용 키)
+    uint32_t version = reader.read_pod<uint32_t>();
+    if (version < 1 || version > request_version) throw runtime_error("Unsupported encrypted request version!");
+
+    CkksRequestHeader header;
+    header.patient_count = reader.read_pod<uint64_t>();
+    header.feature_count = reader.read_pod<uint64_t>();
+    header.ciphertext_count = reader.read_pod<uint64_t>();
+    if (version >= 2) {
+        uint32_t mode = reader.read_pod<uint32_t>();
+        if (mode > static_cast<uint32_t>(ResponseMode::encrypted)) throw runtime_error("Unknown response mode!");
+        header.response_mode = static_cast<ResponseMode>(mode);
+    }
+    if (version >= 3) {
+        uint32_t length = reader.read_pod<uint32_t>();
+        if (length > max_key_id_length) throw runtime_error("Key ID is too long!");
+        header.key_id = string(reader.read_bytes(length));
+        if (!header.key_id.empty() && !valid_key_id(header.key_id)) throw runtime_error("Invalid key ID!");
+    }
+    return header;
+}
+
+uint64_t check_request_chunks(const CkksRequestHeader& header, uint64_t patients_per_ciphertext, size_t remaining_bytes) {
+    if (patients_per_ciphertext == 0) throw runtime_error("Batch layout holds no patients!");
+    // 헤더 값은 신뢰할 수 없으므로 (patient_count + ppc - 1)처럼 넘칠 수 있는 계산 없이 비교한다
+    uint64_t expected_chunks = header.patient_count / patients_per_ciphertext
+        + (header.patient_count % patients_per_ciphertext != 0 ? 1 : 0);
+    if (header.ciphertext_count != expected_chunks) {
+        throw runtime_error("Ciphertext count does not match patient count!");
+    }
+    if (expected_chunks > remaining_bytes / sizeof(seal::Serialization::SEALHeader)) {
+        throw runtime_error("Request is truncated: " + to_string(expected_chunks) + " ciphertexts in "
+            + to_string(remaining_bytes) + " bytes");
+    }
+    return expected_chunks;
+}
+
+void write_response_header(ostream& out, const CkksResponseHeader& header) {
+    out.write(response_magic, sizeof(response_magic));
+    write_pod(out, response_version);
+    write_pod(out, header.patient_count);
+    write_pod(out, static_cast<uint64_t>(header.model_names.size()));
+    write_pod(out, header.ciphertext_count);
+    for (const string& name : header.model_names) {
+        write_pod(out, static_cast<uint32_t>(name.size()));
+        out.write(name.data(), static_cast<streamsize>(name.size()));
+    }
+}
+
+CkksResponseHeader read_response_header(BlobReader& reader) {
+    if (reader.remaining() < sizeof(response_magic)
+        || !equal(begin(response_magic), end(response_magic), reader.read_bytes(sizeof(response_magic)).begin())) {
+        throw runtime_error("Not an encrypted response file!");
+    }
+    if (reader.read_pod<uint32_t>() != response_version) throw runtime_error("Unsupported encrypted response version!");
+
+    CkksResponseHeader header;
+    header.patient_count = reader.read_pod<uint64_t>();
+    uint64_t model_count = reader.read_pod<uint64_t>();
+    header.ciphertext_count = reader.read_pod<uint64_t>();
+    if (model_count == 0 || model_count > reader.remaining()) throw runtime_error("Encrypted response is truncated!");
+    for (uint64_t m = 0; m < model_count; m++) {
+        uint32_t length = reader.read_pod<uint32_t>();
+        header.model_names.emplace_back(reader.read_bytes(length));
+    }
+    return header;
+}
@@ -0,0 +1,67 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+class BlobReader;
+
+// --- 암호문 요청 (<id>.ckks) 형식 (서버/클라이언트 공용) ---
+// 클라이언트가 입력을 직접 암호화해 보낼 때 사용한다. 서버는 인코딩/암호화 없이 바로 연산에 넣는다.
+//
+//   [헤더] magic "CKRQ" | version | patient_count | feature_count | ciphertext_count | response_mode (version 2부터)
+//          | key_id 길이 (uint32) + key_id (version 3부터, 최대 64바이트)
+//   [본문] 직렬화된 암호문 ciphertext_count개
+//
+// 환자 배치는 batch_layout.h의 pack_patients, 값 인코딩은 bit_encode와 input_scale(plan)을 따른다.
+// 암호문은 비밀키 암호화(encrypt_symmetric)의 seed 압축 형태로 저장하므로
+// 두 번째 다항식 대신 seed만 전송되어 크기가 약 절반이 된다.
+// 서버가 돌려줄 응답 형식 (version 1 요청은 plain)
+enum class ResponseMode : std::uint32_t {
+    plain = 0,      // 서버가 복호화한 점수 (<id>.resp / response 프레임, 서버에 비밀키 필요)
+    encrypted = 1,  // 결과 암호문 (<id>.cresp / encrypted_response 프레임, 클라이언트가 복호화)
+};
+
+struct CkksRequestHeader {
+    std::uint64_t patient_count = 0;
+    std::uint64_t feature_count = 0;
+    std::uint64_t ciphertext_count = 0;
+    ResponseMode response_mode = ResponseMode::plain;
+    // 서버의 키 세션 ID (Shared_Channel/keys/<key_id>/의 키로 연산). 비어 있으면 Shared_Channel의 공용 키 (병원 하나)
+    std::string key_id;
+};
+
+// key_id는 서버에서 디렉터리 이름으로 쓰이므로 영문자, 숫자, '-', '_'만 (1~64자)
+bool valid_key_id(const std::string& key_id);
+
+void write_request_header(std::ostream& out, const CkksRequestHeader& header);
+
+// 형식이 맞지 않으면 runtime_error. 암호문은 이어서 같은 reader로 역직렬화한다 (blob_loader.h)
+CkksRequestHeader read_request_header(BlobReader& reader);
+
+// 헤더의 암호문 수가 환자 수를 patients_per_ciphertext명씩 나눈 개수와 같고, 본문의 남은 바이트에 그만큼의
+// 암호문(각각 최소 SEAL 직렬화 헤더 하나)이 들어갈 수 있는지 확인한다. 헤더 값으로 메모리를 잡기 전에 호출한다.
+// 맞지 않으면 runtime_error, 맞으면 암호문 수
+std::uint64_t check_request_chunks(const CkksRequestHeader& header, std::uint64_t patients_per_ciphertext,
+    std::size_t remaining_bytes);
+
+// --- 암호문 응답 (<id>.cresp) 형식 ---
+// 서버는 결과를 복호화하지 않고, 암호문마다 마지막 레벨(결과용 소수 하나)까지 mod switch한 뒤
+// 다항식 2개만 남긴 상태로 zstd(없으면 zlib) 압축 직렬화한다. 입력 암호문보다 소수가 적으므로 훨씬 작다.
+//
+//   [헤더] magic "CKRS" | version | patient_count | model_count | ciphertext_count | (이름 길이 uint32 + 이름) x model_count
+//   [본문] 결과 암호문 ciphertext_count개 (입력 암호문 순, 그 안에서 모델 순: ciphertexts[chunk * model_count + model])
+//
+// 환자 점수는 복호화/디코딩한 슬롯의 블록 첫 값 (batch_layout.h의 extract_block_leading).
+// sigmoid를 암호 상태에서 계산하지 않는 회로(sigmoid_degree == 0)는 클라이언트가 sigmoid를 적용한다.
+struct CkksResponseHeader {
+    std::uint64_t patient_count = 0;
+    std::uint64_t ciphertext_count = 0;
+    std::vector<std::string> model_names;
+};
+
+void write_response_header(std::ostream& out, const CkksResponseHeader& header);
+
+// 형식이 맞지 않으면 runtime_error. 암호문은 이어서 같은 reader로 역직렬화한다
+CkksResponseHeader read_response_header(BlobReader& reader);
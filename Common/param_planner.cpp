@@ -0,0 +1,146 @@
+﻿#include "param_planner.h"
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+using namespace seal;
+
+// rescale 후 남는 CKKS 잡음 크기 (N에 따라 약 2^7~2^10) → scale은 정밀도보다 이만큼 커야 함
+static const int ckks_noise_bits = 10;
+// SEAL이 만들 수 있는 소수의 최대 비트 수
+static const int max_prime_bits = 60;
+
+CircuitSpec parse_circuit(const string& name) {
+    CircuitSpec circuit;
+    if (name == "linear") {
+        // 결과가 logit z 하나뿐이라 |z| < 2^9이면 충분하다. 이 1비트로 N=4096에 들어간다 ({39, 30, 39} = 108 <= 109비트)
+        circuit.sigmoid_degree = 0;
+        circuit.integer_bits = 9;
+    }
+    else if (name == "sigmoid3") circuit.sigmoid_degree = 3;
+    else if (name == "sigmoid5") circuit.sigmoid_degree = 5;
+    else if (name == "sigmoid7") circuit.sigmoid_degree = 7;
+    else if (name.rfind("mlp", 0) == 0) {
+        // mlp13x16: 입력 13개, 은닉 16개
+        size_t separator = name.find('x', 3);
+        try {
+            size_t parsed = 0;
+            if (separator == string::npos) throw invalid_argument(name);
+            circuit.input_features = stoul(name.substr(3, separator - 3), &parsed);
+            if (parsed != separator - 3) throw invalid_argument(name);
+            circuit.hidden_units = stoul(name.substr(separator + 1), &parsed);
+            if (parsed != name.size() - separator - 1) throw invalid_argument(name);
+        }
+        catch (const logic_error&) {
+            throw runtime_error("Invalid MLP circuit: " + name + " (use mlp<inputs>x<hidden>, e.g. mlp13x16)");
+        }
+        if (circuit.input_features == 0 || circuit.hidden_units == 0) {
+            throw runtime_error("MLP circuit needs positive input and hidden sizes: " + name);
+        }
+        circuit.sigmoid_degree = 0;
+    }
+    else throw runtime_error("Unknown circuit: " + name + " (use linear, sigmoid3, sigmoid5, sigmoid7 or mlp<inputs>x<hidden>)");
+    return circuit;
+}
+
+string circuit_name(const CircuitSpec& circuit) {
+    if (circuit.hidden_units > 0) return "mlp" + to_string(circuit.input_features) + "x" + to_string(circuit.hidden_units);
+    if (circuit.sigmoid_degree == 0) return "linear";
+    return "sigmoid" + to_string(circuit.sigmoid_degree);
+}
+
+// 차수 d 다항식은 곱셈 깊이 ceil(log2(d + 1))로 평가 가능
+static size_t polynomial_depth(size_t degree) {
+    size_t depth = 0;
+    for (size_t reach = 1; reach < degree + 1; reach <<= 1) depth++;
+    return depth;
+}
+
+size_t circuit_depth(const CircuitSpec& circuit) {
+    size_t depth = 1; // W * x
+    if (circuit.hidden_units > 0) depth += polynomial_depth(circuit.activation_degree) + 1; // 활성화 + 출력층
+    return depth + polynomial_depth(circuit.sigmoid_degree);
+}
+
+// N에서 쓸 수 있는 가장 큰 scale (128비트 보안 예산 안, 지원하지 않는 N이면 0 이하)
+static int largest_scale_bits(const CircuitSpec& circuit, size_t n) {
+    // 전체 비트 = (scale + integer_bits) + scale * depth + (scale + integer_bits)(special)
+    int max_bits = CoeffModulus::MaxBitCount(n, sec_level_type::tc128);
+    if (max_bits == 0) return 0;
+    int scale_bits = (max_bits - 2 * circuit.integer_bits) / static_cast<int>(circuit_depth(circuit) + 2);
+    // 남는 예산은 scale을 키워 정밀도에 쓴다 (단, 결과용 소수가 60비트를 넘지 않게)
+    return min(scale_bits, max_prime_bits - circuit.integer_bits);
+}
+
+ParameterPlan plan_parameters(const CircuitSpec& circuit) {
+    int min_scale_bits = circuit.precision_bits + ckks_noise_bits;
+
+    for (size_t n = 1024; n <= 32768; n <<= 1) {
+        if (largest_scale_bits(circuit, n) >= min_scale_bits) return plan_parameters(circuit, n);
+    }
+    throw runtime_error("No secure CKKS parameters for circuit " + circuit_name(circuit) + "!");
+}
+
+ParameterPlan plan_parameters(const CircuitSpec& circuit, size_t poly_modulus_degree, int scale_bits) {
+    string where = "circuit " + circuit_name(circuit) + ", N=" + to_string(poly_modulus_degree);
+    int largest = largest_scale_bits(circuit, poly_modulus_degree);
+    if (largest <= 0) throw runtime_error("No secure CKKS parameters for " + where + "!");
+
+    if (scale_bits == 0) {
+        if (largest < circuit.precision_bits + ckks_noise_bits) {
+            throw runtime_error("N is too small for the required precision (" + where + ")");
+        }
+        scale_bits = largest;
+    }
+    else if (scale_bits < 0 || scale_bits > largest) {
+        throw runtime_error("Scale 2^" + to_string(scale_bits) + " exceeds the 128-bit security budget or the 60-bit prime limit (" + where
+            + ", max 2^" + to_string(largest) + ")");
+    }
+
+    ParameterPlan plan;
+    plan.poly_modulus_degree = poly_modulus_degree;
+    plan.scale_bits = scale_bits;
+    plan.depth = circuit_depth(circuit);
+    plan.coeff_modulus_bits.push_back(scale_bits + circuit.integer_bits);
+    plan.coeff_modulus_bits.insert(plan.coeff_modulus_bits.end(), plan.depth, scale_bits);
+    // special 소수는 가장 큰 데이터 소수 이상이어야 키 스위칭(회전, 재선형화) 잡음이 scale 아래로 묻힌다
+    plan.coeff_modulus_bits.push_back(scale_bits + circuit.integer_bits);
+    return plan;
+}
+
+EncryptionParameters make_encryption_parameters(const ParameterPlan& plan) {
+    EncryptionParameters parms(scheme_type::ckks);
+    parms.set_poly_modulus_degree(plan.poly_modulus_degree);
+    parms.set_coeff_modulus(CoeffModulus::Create(plan.poly_modulus_degree, plan.coeff_modulus_bits));
+    return parms;
+}
+
+double input_scale(const ParameterPlan& plan) {
+    return pow(2.0, plan.scale_bits);
+}
+
+string describe_plan(const ParameterPlan& plan) {
+    ostringstream out;
+    out << "N=" << plan.poly_modulus_degree << ", coeff {";
+    for (size_t i = 0; i < plan.coeff_modulus_bits.size(); i++) {
+        out << plan.coeff_modulus_bits[i];
+        if (i < plan.coeff_modulus_bits.size() - 1) out << ", ";
+    }
+    out << "}, scale 2^" << plan.scale_bits;
+    return out.str();
+}
+
+BatchLayout make_circuit_layout(const CircuitSpec& circuit, size_t feature_count, size_t slot_count) {
+    if (circuit.hidden_units == 0) return make_batch_layout(feature_count, slot_count);
+    if (feature_count != circuit.input_features) {
+        throw runtime_error("Circuit " + circuit_name(circuit) + " expects " + to_string(circuit.input_features)
+            + " features, got " + to_string(feature_count));
+    }
+    return make_dense_layout(feature_count, circuit.hidden_units, slot_count);
+}
+
+vector<int> circuit_rotation_steps(const CircuitSpec& circuit, const BatchLayout& layout) {
+    return circuit.hidden_units > 0 ? dense_rotation_steps(layout) : rotation_steps(layout);
+}
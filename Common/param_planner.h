@@ -0,0 +1,65 @@
+﻿#pragma once
+#include "seal/seal.h"
+#include "batch_layout.h"
+#include <string>
+#include <vector>
+
+// --- CKKS 파라미터 자동 설계 (서버/클라이언트 공용) ---
+// 실행할 회로의 곱셈 깊이와 필요한 정밀도로부터 128비트 보안을 만족하는 가장 작은 N과
+// modulus chain을 고른다. 양쪽이 같은 CircuitSpec으로 호출하면 같은 파라미터가 나온다.
+//
+//   coeff modulus = { scale + integer_bits (결과용) | scale x depth (rescale용) | scale + integer_bits (special) }
+//   (special 소수는 가장 큰 데이터 소수 이상이어야 함: SEAL의 키 스위칭 잡음 조건)
+//
+// 예) 선형(Wx + b)만: 깊이 1, integer_bits 9 → N=4096 (scale 2^30) / sigmoid 3차 근사: 깊이 3 → N=8192 (scale 2^39)
+//     2층 MLP (밀집층 + 2차 활성화 + 출력층): 깊이 4 → N=8192
+
+// 평가할 회로
+struct CircuitSpec {
+    size_t sigmoid_degree = 3; // sigmoid 근사 다항식 차수 (0이면 Wx + b만 암호 상태에서 계산)
+    int precision_bits = 20;   // 결과에 필요한 소수부 정밀도 (비트)
+    int integer_bits = 10;     // 결과 값의 정수부 크기 (|값| < 2^integer_bits, linear 회로는 9)
+    size_t input_features = 0; // MLP 입력 특성 수 (hidden_units가 0이면 쓰지 않음, 특성 수는 모델이 정함)
+    size_t hidden_units = 0;   // MLP 은닉층 크기 (0이면 로지스틱 회귀 한 층)
+    size_t activation_degree = 2; // MLP 은닉층 활성화 다항식 차수
+    int input_bit_scale = bit_scale; // 입력 정수화 배율 (batch_layout.h의 bit_encode, 0이면 정수화 없음)
+};
+
+struct ParameterPlan {
+    size_t poly_modulus_degree = 0;
+    std::vector<int> coeff_modulus_bits;
+    int scale_bits = 0;  // 입력 및 각 rescale 후의 scale = 2^scale_bits
+    size_t depth = 0;    // rescale 횟수
+};
+
+// 명령행 이름 → 회로 ("linear", "sigmoid3", "sigmoid5", "sigmoid7", "mlp<입력>x<은닉>"), 모르는 이름이면 runtime_error
+// MLP 회로는 출력 z를 복호화한 뒤 평문에서 정확한 sigmoid를 적용한다 (linear와 같음)
+CircuitSpec parse_circuit(const std::string& name);
+std::string circuit_name(const CircuitSpec& circuit);
+
+// W*x (1) + [MLP: 활성화 다항식 + 출력층 (1)] + sigmoid 다항식 평가 (차수 d는 ceil(log2(d + 1)))
+size_t circuit_depth(const CircuitSpec& circuit);
+
+// 조건을 만족하는 N이 없으면 runtime_error
+ParameterPlan plan_parameters(const CircuitSpec& circuit);
+
+// N (과 scale)을 직접 지정한 계획 (파라미터 스윕용). chain 모양은 위와 같다.
+// scale_bits가 0이면 N에서 가장 큰 scale (precision_bits를 만족하지 못하면 runtime_error).
+// 직접 지정한 scale은 정밀도 요구를 검사하지 않고, 128비트 보안 예산이나 60비트 소수 한도를 넘을 때만 runtime_error
+ParameterPlan plan_parameters(const CircuitSpec& circuit, size_t poly_modulus_degree, int scale_bits = 0);
+
+seal::EncryptionParameters make_encryption_parameters(const ParameterPlan& plan);
+
+// 입력 암호문의 scale (= 2^scale_bits, rescale 소수 크기와 맞춤)
+double input_scale(const ParameterPlan& plan);
+
+// 로그 출력용 ("N=8192, coeff {49, 39, 39, 39, 49}, scale 2^39")
+std::string describe_plan(const ParameterPlan& plan);
+
+// --- 회로별 슬롯 배치와 회전 키 (서버/클라이언트가 같은 값을 써야 함) ---
+// 로지스틱 회로는 make_batch_layout, MLP 회로는 make_dense_layout.
+// MLP 회로인데 feature_count가 circuit.input_features와 다르면 runtime_error
+BatchLayout make_circuit_layout(const CircuitSpec& circuit, size_t feature_count, size_t slot_count);
+
+// 클라이언트가 만들어야 하는 GaloisKeys의 회전 폭
+std::vector<int> circuit_rotation_steps(const CircuitSpec& circuit, const BatchLayout& layout);
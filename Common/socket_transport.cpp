@@ -0,0 +1,354 @@
+﻿#include "socket_transport.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <afunix.h>
+#pragma comment(lib, "Ws2_32.lib")
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+using namespace std;
+
+#ifdef _WIN32
+static const socket_handle invalid_handle = static_cast<socket_handle>(INVALID_SOCKET);
+static void close_handle(socket_handle handle) { closesocket(static_cast<SOCKET>(handle)); }
+static const int shutdown_both = SD_BOTH;
+
+// WSAStartup은 프로세스에서 한 번만
+static void ensure_winsock() {
+    static const bool started = [] {
+        WSADATA data;
+        if (WSAStartup(MAKEWORD(2, 2), &data) != 0) throw runtime_error("WSAStartup failed!");
+        return true;
+    }();
+    (void)started;
+}
+#else
+static const socket_handle invalid_handle = -1;
+static void close_handle(socket_handle handle) { ::close(handle); }
+static const int shutdown_both = SHUT_RDWR;
+static void ensure_winsock() {}
+#endif
+
+#ifdef MSG_NOSIGNAL
+static const int send_flags = MSG_NOSIGNAL; // 끊긴 연결에 쓸 때 SIGPIPE 대신 오류 반환
+#else
+static const int send_flags = 0;
+#endif
+
+// 잘못된 길이 필드로 거대한 버퍼를 잡지 않도록 (가장 큰 프레임은 GaloisKeys 수 MB)
+static const uint64_t max_payload_size = uint64_t(1) << 30;
+
+static const size_t frame_header_size = sizeof(uint32_t) + sizeof(uint64_t);
+
+Endpoint parse_endpoint(const string& text) {
+    Endpoint endpoint;
+    if (text.rfind("unix:", 0) == 0) {
+        endpoint.is_unix = true;
+        endpoint.path = text.substr(5);
+        if (endpoint.path.empty()) throw runtime_error("Socket path is empty: " + text);
+        return endpoint;
+    }
+    if (text.rfind("tcp:", 0) == 0) {
+        endpoint.is_unix = false;
+        string rest = text.substr(4);
+        size_t colon = rest.rfind(':');
+        if (colon != string::npos) {
+            endpoint.host = rest.substr(0, colon);
+            rest = rest.substr(colon + 1);
+        }
+        unsigned long port = 0;
+        try {
+            port = stoul(rest);
+        }
+        catch (const exception&) {
+            throw runtime_error("Invalid TCP port: " + text);
+        }
+        if (port == 0 || port > 65535) throw runtime_error("Invalid TCP port: " + text);
+        endpoint.port = static_cast<uint16_t>(port);
+        return endpoint;
+    }
+    throw runtime_error("Unknown endpoint (use unix:PATH or tcp:[HOST:]PORT): " + text);
+}
+
+string describe_endpoint(const Endpoint& endpoint) {
+    if (endpoint.is_unix) return "unix:" + endpoint.path;
+    return "tcp:" + endpoint.host + ":" + to_string(endpoint.port);
+}
+
+// endpoint에 맞는 주소 구조체를 채우고 그 길이를 반환
+static socklen_t make_address(const Endpoint& endpoint, sockaddr_storage& storage) {
+    memset(&storage, 0, sizeof(storage));
+    if (endpoint.is_unix) {
+        auto* address = reinterpret_cast<sockaddr_un*>(&storage);
+        if (endpoint.path.size() >= sizeof(address->sun_path)) {
+            throw runtime_error("Socket path is too long: " + endpoint.path);
+        }
+        address->sun_family = AF_UNIX;
+        memcpy(address->sun_path, endpoint.path.c_str(), endpoint.path.size() + 1);
+        return static_cast<socklen_t>(sizeof(sockaddr_un));
+    }
+
+    auto* address = reinterpret_cast<sockaddr_in*>(&storage);
+    address->sin_family = AF_INET;
+    address->sin_port = htons(endpoint.port);
+    if (inet_pton(AF_INET, endpoint.host.c_str(), &address->sin_addr) != 1) {
+        throw runtime_error("Invalid IPv4 address: " + endpoint.host);
+    }
+    return static_cast<socklen_t>(sizeof(sockaddr_in));
+}
+
+static socket_handle open_socket(const Endpoint& endpoint) {
+    ensure_winsock();
+    socket_handle handle = static_cast<socket_handle>(socket(endpoint.is_unix ? AF_UNIX : AF_INET, SOCK_STREAM, 0));
+    if (handle == invalid_handle) throw runtime_error("Failed to create socket for " + describe_endpoint(endpoint));
+    if (!endpoint.is_unix) {
+        // 프레임 헤더와 payload를 따로 보내므로 Nagle 지연을 끈다
+        int one = 1;
+        setsockopt(handle, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&one), sizeof(one));
+    }
+    return handle;
+}
+
+// --- SocketConnection ---
+
+SocketConnection::SocketConnection(socket_handle handle) : handle_(handle) {}
+
+SocketConnection::SocketConnection(SocketConnection&& other) noexcept : handle_(other.handle_) {
+    other.handle_ = invalid_handle;
+}
+
+SocketConnection& SocketConnection::operator=(SocketConnection&& other) noexcept {
+    if (this != &other) {
+        close();
+        handle_ = other.handle_;
+        other.handle_ = invalid_handle;
+    }
+    return *this;
+}
+
+SocketConnection::~SocketConnection() {
+    close();
+}
+
+void SocketConnection::close() {
+    if (handle_ != invalid_handle) close_handle(handle_);
+    handle_ = invalid_handle;
+}
+
+void SocketConnection::shutdown() {
+    if (handle_ != invalid_handle) ::shutdown(handle_, shutdown_both);
+}
+
+SocketConnection SocketConnection::connect(const Endpoint& endpoint) {
+    sockaddr_storage storage;
+    socklen_t length = make_address(endpoint, storage);
+
+    SocketConnection connection(open_socket(endpoint));
+    if (::connect(connection.handle_, reinterpret_cast<const sockaddr*>(&storage), length) != 0) {
+        throw runtime_error("Failed to connect to " + describe_endpoint(endpoint));
+    }
+    return connection;
+}
+
+static void send_all(socket_handle handle, const char* data, size_t size) {
+    while (size > 0) {
+        int chunk = static_cast<int>(min<size_t>(size, 1 << 30));
+        auto sent = ::send(handle, data, chunk, send_flags);
+        if (sent <= 0) throw runtime_error("Socket send failed (connection closed)");
+        data += sent;
+        size -= static_cast<size_t>(sent);
+    }
+}
+
+// size바이트를 모두 읽으면 true, 처음부터 EOF이면 false (중간에 끊기면 runtime_error)
+static bool receive_all(socket_handle handle, char* data, size_t size) {
+    size_t received = 0;
+    while (received < size) {
+        int chunk = static_cast<int>(min<size_t>(size - received, 1 << 30));
+        auto got = ::recv(handle, data + received, chunk, 0);
+        if (got == 0 && received == 0) return false;
+        if (got <= 0) throw runtime_error("Socket receive failed (connection closed mid-frame)");
+        received += static_cast<size_t>(got);
+    }
+    return true;
+}
+
+void SocketConnection::send(MessageType type, string_view payload) {
+    char header[frame_header_size];
+    uint32_t type_value = static_cast<uint32_t>(type);
+    uint64_t length = payload.size();
+    memcpy(header, &type_value, sizeof(type_value));
+    memcpy(header + sizeof(type_value), &length, sizeof(length));
+
+    send_all(handle_, header, sizeof(header));
+    send_all(handle_, payload.data(), payload.size());
+}
+
+bool SocketConnection::receive(Frame& frame) {
+    char header[frame_header_size];
+    if (!receive_all(handle_, header, sizeof(header))) return false;
+
+    uint32_t type_value = 0;
+    uint64_t length = 0;
+    memcpy(&type_value, header, sizeof(type_value));
+    memcpy(&length, header + sizeof(type_value), sizeof(length));
+    if (!is_known_message_type(type_value)) {
+        throw runtime_error("Unknown frame type: " + to_string(type_value));
+    }
+    if (length > max_payload_size) throw runtime_error("Frame is too large: " + to_string(length) + " bytes");
+
+    frame.type = static_cast<MessageType>(type_value);
+    frame.payload.resize(static_cast<size_t>(length));
+    if (length > 0 && !receive_all(handle_, frame.payload.data(), frame.payload.size())) {
+        throw runtime_error("Socket receive failed (connection closed mid-frame)");
+    }
+    return true;
+}
+
+// --- SocketListener ---
+
+SocketListener::SocketListener(const Endpoint& endpoint) : endpoint_(endpoint), handle_(open_socket(endpoint)) {
+    sockaddr_storage storage;
+    socklen_t length = make_address(endpoint_, storage);
+
+    if (endpoint_.is_unix) {
+        // 이전 실행이 남긴 소켓 파일
+        ::remove(endpoint_.path.c_str());
+    }
+    else {
+        int one = 1;
+        setsockopt(handle_, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&one), sizeof(one));
+    }
+
+    if (::bind(handle_, reinterpret_cast<const sockaddr*>(&storage), length) != 0 || ::listen(handle_, 16) != 0) {
+        close_handle(handle_);
+        throw runtime_error("Failed to listen on " + describe_endpoint(endpoint_));
+    }
+}
+
+SocketListener::~SocketListener() {
+    close_handle(handle_);
+    if (endpoint_.is_unix) ::remove(endpoint_.path.c_str());
+}
+
+SocketConnection SocketListener::accept() {
+    while (true) {
+        socket_handle client = static_cast<socket_handle>(::accept(handle_, nullptr, nullptr));
+        if (client != invalid_handle) {
+            if (!endpoint_.is_unix) {
+                int one = 1;
+                setsockopt(client, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&one), sizeof(one));
+            }
+            return SocketConnection(client);
+        }
+#ifndef _WIN32
+        if (errno == EINTR || errno == ECONNABORTED) continue;
+#endif
+        throw runtime_error("Stopped accepting on " + describe_endpoint(endpoint_));
+    }
+}
+
+void SocketListener::shutdown() {
+    ::shutdown(handle_, shutdown_both);
+}
+
+// --- response payload (socket_transport.h의 ScoreReply 형식) ---
+
+template <class T>
+static void append_pod(string& out, const T& value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <class T>
+static T take_pod(string_view& in) {
+    if (in.size() < sizeof(T)) throw runtime_error("Response is truncated!");
+    T value{};
+    memcpy(&value, in.data(), sizeof(T));
+    in.remove_prefix(sizeof(T));
+    return value;
+}
+
+string encode_scores(const ScoreReply& reply) {
+    size_t model_count = reply.model_names.size();
+    if (model_count == 0 || reply.scores.size() % model_count != 0) throw runtime_error("Score table shape mismatch!");
+
+    string payload;
+    append_pod(payload, static_cast<uint64_t>(reply.scores.size() / model_count));
+    append_pod(payload, static_cast<uint64_t>(model_count));
+    for (const string& name : reply.model_names) {
+        append_pod(payload, static_cast<uint32_t>(name.size()));
+        payload += name;
+    }
+    payload.append(reinterpret_cast<const char*>(reply.scores.data()), reply.scores.size() * sizeof(double));
+    return payload;
+}
+
+ScoreReply decode_scores(string_view payload) {
+    uint64_t patient_count = take_pod<uint64_t>(payload);
+    uint64_t model_count = take_pod<uint64_t>(payload);
+    if (model_count == 0 || model_count > payload.size()) throw runtime_error("Response model count is invalid!");
+
+    ScoreReply reply;
+    for (uint64_t i = 0; i < model_count; i++) {
+        uint32_t length = take_pod<uint32_t>(payload);
+        if (payload.size() < length) throw runtime_error("Response is truncated!");
+        reply.model_names.emplace_back(payload.substr(0, length));
+        payload.remove_prefix(length);
+    }
+
+    if (payload.size() != patient_count * model_count * sizeof(double)) throw runtime_error("Response size mismatch!");
+    reply.scores.resize(static_cast<size_t>(patient_count * model_count));
+    if (!reply.scores.empty()) memcpy(reply.scores.data(), payload.data(), payload.size());
+    return reply;
+}
+
+string encode_server_timing(const ServerTiming& timing) {
+    string payload;
+    append_pod(payload, timing.queue_ms);
+    append_pod(payload, timing.compute_ms);
+    return payload;
+}
+
+ServerTiming decode_server_timing(string_view payload) {
+    ServerTiming timing;
+    timing.queue_ms = take_pod<double>(payload);
+    timing.compute_ms = take_pod<double>(payload);
+    if (!payload.empty()) throw runtime_error("Server timing size mismatch!");
+    return timing;
+}
+
+vector<double> make_key_challenge_slots(string_view nonce) {
+    vector<double> slots(nonce.size() * 8, 0.0);
+    for (size_t i = 0; i < nonce.size(); i++) {
+        for (size_t bit = 0; bit < 8; bit++) {
+            if ((static_cast<unsigned char>(nonce[i]) >> bit) & 1) slots[i * 8 + bit] = 1.0;
+        }
+    }
+    return slots;
+}
+
+string read_key_challenge_answer(const vector<double>& slots) {
+    if (slots.size() < key_challenge_bytes * 8) throw runtime_error("Key challenge is truncated!");
+    string nonce(key_challenge_bytes, '\0');
+    for (size_t i = 0; i < key_challenge_bytes; i++) {
+        unsigned char byte = 0;
+        for (size_t bit = 0; bit < 8; bit++) {
+            if (slots[i * 8 + bit] > 0.5) byte |= static_cast<unsigned char>(1u << bit);
+        }
+        nonce[i] = static_cast<char>(byte);
+    }
+    return nonce;
+}
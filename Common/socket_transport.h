@@ -0,0 +1,162 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// --- 로컬 소켓 전송 (서버/클라이언트 공용) ---
+// Shared_Channel 파일 교환 대신 Unix domain socket 또는 loopback TCP로 키/요청/응답을 주고받는다.
+// 연결 하나가 세션 하나: 키는 연결 직후 한 번만 보내고, 같은 연결에서 요청을 여러 번 보낼 수 있다.
+//
+//   [프레임] type (uint32) | payload 길이 (uint64) | payload
+//
+//   keys        클라이언트 → 서버  PublicKey, SecretKey, RelinKeys, GaloisKeys를 차례로 직렬화
+//   public_keys 클라이언트 → 서버  PublicKey, RelinKeys, GaloisKeys (비밀키 없음, encrypted 응답만 가능)
+//   request     클라이언트 → 서버  ckks_request.h 형식 (헤더 + 암호문)
+//   response    서버 → 클라이언트  encode_scores 형식 (환자 수, 모델 이름, 환자 x 모델 점수)
+//   encrypted_response 서버 → 클라이언트  ckks_request.h의 암호문 응답 형식 (<id>.cresp와 같음)
+//   error       서버 → 클라이언트  오류 메시지. 요청에 대한 오류면 세션은 유지되고,
+//                응답을 기다리지 않는 프레임(keys, public_keys, 알 수 없는 프레임)의 오류면 보낸 뒤 연결을 닫는다
+//   patient_rows 웹 앱 → 클라이언트 데몬  raw_data.txt와 같은 텍스트 (응답은 response 또는 error, client_daemon.h)
+//   server_timing 클라이언트 → 서버  빈 payload: 이 연결의 요청마다 서버 처리 시간을 알려 달라는 요청 (부하 생성기용)
+//                서버 → 클라이언트  encode_server_timing 형식. 켠 연결에서는 요청마다 응답(또는 error) 프레임 바로 앞에 온다
+//   key_session 클라이언트 → 서버  key_id 문자열: 이 연결에서 keys/<key_id>/ 키 세션을 쓰겠다는 요청 (응답은 key_challenge 또는 error)
+//                서버 → 클라이언트  빈 payload: 답이 맞아 등록됨 (틀리면 error). 등록하지 않은 key_id의 요청은 거절된다
+//   key_challenge 서버 → 클라이언트  그 세션의 공개키로 암호화한 난수 (make_key_challenge_slots 배치의 SEAL 암호문)
+//                클라이언트 → 서버  복호화한 난수 (read_key_challenge_answer). 세션의 비밀키를 가진 병원만 답할 수 있다
+//
+// 요청 헤더의 response_mode가 encrypted이면 response 대신 encrypted_response로 응답한다.
+//
+// SEAL 객체는 메모리 버퍼에 직렬화한 뒤 프레임 하나로 보내고, 받는 쪽은 그 버퍼에서 바로 역직렬화한다 (중간 파일 없음).
+
+enum class MessageType : std::uint32_t {
+    keys = 1,
+    request = 2,
+    response = 3,
+    error = 4,
+    public_keys = 5,
+    encrypted_response = 6,
+    patient_rows = 7,
+    server_timing = 8,
+    key_session = 9,
+    key_challenge = 10,
+};
+
+// 수신한 type 값이 위의 프레임 종류인지 (새 종류를 추가하면 여기에도 추가, 없으면 receive가 거부함)
+constexpr bool is_known_message_type(std::uint32_t value) {
+    switch (static_cast<MessageType>(value)) {
+    case MessageType::keys:
+    case MessageType::request:
+    case MessageType::response:
+    case MessageType::error:
+    case MessageType::public_keys:
+    case MessageType::encrypted_response:
+    case MessageType::patient_rows:
+    case MessageType::server_timing:
+    case MessageType::key_session:
+    case MessageType::key_challenge:
+        return true;
+    }
+    return false;
+}
+
+struct Frame {
+    MessageType type = MessageType::error;
+    std::string payload;
+};
+
+// "unix:/tmp/he_server.sock" 또는 "tcp:7000" / "tcp:127.0.0.1:7000" (host 생략 시 127.0.0.1)
+struct Endpoint {
+    bool is_unix = true;
+    std::string path;              // unix
+    std::string host = "127.0.0.1"; // tcp
+    std::uint16_t port = 0;
+};
+
+// 형식이 맞지 않으면 runtime_error
+Endpoint parse_endpoint(const std::string& text);
+std::string describe_endpoint(const Endpoint& endpoint);
+
+#ifdef _WIN32
+using socket_handle = std::uintptr_t;
+#else
+using socket_handle = int;
+#endif
+
+// --- 연결 하나 (move만 가능, 소멸 시 close) ---
+// send/receive는 각각 한 스레드에서만 호출한다. 입출력 오류는 runtime_error
+class SocketConnection {
+public:
+    explicit SocketConnection(socket_handle handle);
+    SocketConnection(SocketConnection&& other) noexcept;
+    SocketConnection& operator=(SocketConnection&& other) noexcept;
+    ~SocketConnection();
+
+    SocketConnection(const SocketConnection&) = delete;
+    SocketConnection& operator=(const SocketConnection&) = delete;
+
+    static SocketConnection connect(const Endpoint& endpoint);
+
+    void send(MessageType type, std::string_view payload);
+    // 상대가 프레임 경계에서 연결을 닫았으면 false
+    bool receive(Frame& frame);
+
+    // 다른 스레드에서 막혀 있는 receive를 깨운다 (서버 종료용)
+    void shutdown();
+
+private:
+    void close();
+
+    socket_handle handle_;
+};
+
+// --- 서버 측 listen 소켓 ---
+// Unix domain socket은 남아 있는 소켓 파일을 지우고 새로 만들며, 소멸 시 파일도 지운다.
+class SocketListener {
+public:
+    explicit SocketListener(const Endpoint& endpoint);
+    ~SocketListener();
+
+    SocketListener(const SocketListener&) = delete;
+    SocketListener& operator=(const SocketListener&) = delete;
+
+    // 다음 연결까지 대기. shutdown 이후에는 runtime_error
+    SocketConnection accept();
+    // 다른 스레드에서 막혀 있는 accept를 깨운다
+    void shutdown();
+
+private:
+    Endpoint endpoint_;
+    socket_handle handle_;
+};
+
+// response 프레임 내용: 환자 순, 모델 순 점수 (scores[patient * model_names.size() + model])
+struct ScoreReply {
+    std::vector<std::string> model_names;
+    std::vector<double> scores;
+};
+
+// patient_count (uint64) | model_count (uint64) | (이름 길이 uint32 + 이름) x model_count | double x (patient x model)
+std::string encode_scores(const ScoreReply& reply);
+// 형식이 맞지 않으면 runtime_error
+ScoreReply decode_scores(std::string_view payload);
+
+// server_timing 프레임 내용: 요청 프레임을 다 받은 뒤 worker가 잡을 때까지 (queue),
+// worker가 역직렬화/연산/응답 직렬화에 쓴 시간 (compute). 응답 전송 시간은 포함하지 않음
+struct ServerTiming {
+    double queue_ms = 0.0;
+    double compute_ms = 0.0;
+};
+
+// queue_ms (double) | compute_ms (double)
+std::string encode_server_timing(const ServerTiming& timing);
+// 형식이 맞지 않으면 runtime_error
+ServerTiming decode_server_timing(std::string_view payload);
+
+// key_challenge 난수 크기 (바이트). 암호문의 앞 key_challenge_bytes * 8 슬롯에 비트 하나씩 (0 또는 1)
+constexpr std::size_t key_challenge_bytes = 16;
+// nonce (key_challenge_bytes 바이트) → 슬롯 값 (바이트 i의 비트 j가 슬롯 i * 8 + j)
+std::vector<double> make_key_challenge_slots(std::string_view nonce);
+// 복호화한 슬롯 값 → nonce (0.5 기준으로 반올림). 슬롯이 모자라면 runtime_error
+std::string read_key_challenge_answer(const std::vector<double>& slots);
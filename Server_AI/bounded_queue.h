@@ -0,0 +1,129 @@
+﻿#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+// --- 고정 크기 lock-free 큐 (여러 생산자 / 여러 소비자) ---
+// 칸마다 sequence 번호를 두는 링 버퍼 (Vyukov bounded MPMC). try_push/try_pop은 CAS만 쓰고 lock이 없다.
+// push/pop은 큐가 가득 차거나 비었을 때 C++20 atomic wait로 잠든다 (대기 중인 스레드가 없으면 깨우기 비용 없음).
+// 파이프라인 단계 사이의 깊이 제한 (backpressure)에 쓴다. T는 기본 생성과 move가 가능해야 한다.
+template <class T>
+class BoundedQueue {
+public:
+    // capacity는 2의 거듭제곱으로 올림 (최소 2)
+    explicit BoundedQueue(size_t capacity) {
+        size_t size = 2;
+        while (size < capacity) size <<= 1;
+        cells_ = std::make_unique<Cell[]>(size);
+        mask_ = size - 1;
+        for (size_t i = 0; i < size; i++) cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    size_t capacity() const { return mask_ + 1; }
+
+    // 동시에 push/pop 중이면 근사값
+    size_t size() const {
+        size_t enqueued = enqueue_pos_.load(std::memory_order_relaxed);
+        size_t dequeued = dequeue_pos_.load(std::memory_order_relaxed);
+        return enqueued > dequeued ? enqueued - dequeued : 0;
+    }
+
+    // 가득 차 있으면 false (value는 그대로)
+    bool try_push(T& value) {
+        Cell* cell;
+        size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+        while (true) {
+            cell = &cells_[pos & mask_];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos);
+            if (diff == 0) {
+                if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            }
+            else if (diff < 0) {
+                return false;
+            }
+            else {
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value = std::move(value);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        notify();
+        return true;
+    }
+
+    // 비어 있으면 false
+    bool try_pop(T& value) {
+        Cell* cell;
+        size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+        while (true) {
+            cell = &cells_[pos & mask_];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos + 1);
+            if (diff == 0) {
+                if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            }
+            else if (diff < 0) {
+                return false;
+            }
+            else {
+                pos = dequeue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+        value = std::move(cell->value);
+        cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+        notify();
+        return true;
+    }
+
+    // 빈칸이 생길 때까지 기다린다. close 이후에는 넣지 않고 false
+    bool push(T value) {
+        while (true) {
+            // 시도 전에 읽어 두므로, 실패 직후 다른 스레드가 pop해도 wait가 바로 깨어난다
+            uint32_t seen = changes_.load(std::memory_order_acquire);
+            if (closed_.load(std::memory_order_acquire)) return false;
+            if (try_push(value)) return true;
+            changes_.wait(seen, std::memory_order_acquire);
+        }
+    }
+
+    // 항목이 들어올 때까지 기다린다. close되고 비어 있으면 false
+    bool pop(T& value) {
+        while (true) {
+            uint32_t seen = changes_.load(std::memory_order_acquire);
+            if (try_pop(value)) return true;
+            if (closed_.load(std::memory_order_acquire)) return false;
+            changes_.wait(seen, std::memory_order_acquire);
+        }
+    }
+
+    // 기다리는 push/pop을 모두 깨운다. 남은 항목은 pop으로 계속 꺼낼 수 있다
+    void close() {
+        closed_.store(true, std::memory_order_release);
+        notify();
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence{ 0 };
+        T value{};
+    };
+
+    void notify() {
+        changes_.fetch_add(1, std::memory_order_release);
+        changes_.notify_all();
+    }
+
+    std::unique_ptr<Cell[]> cells_;
+    size_t mask_ = 0;
+    // 생산자/소비자 위치는 서로 다른 캐시 라인에 둔다 (false sharing 방지)
+    alignas(64) std::atomic<size_t> enqueue_pos_{ 0 };
+    alignas(64) std::atomic<size_t> dequeue_pos_{ 0 };
+    alignas(64) std::atomic<uint32_t> changes_{ 0 };  // push/pop마다 증가 (대기 스레드 깨우기용)
+    std::atomic<bool> closed_{ false };
+};
@@ -0,0 +1,353 @@
+﻿#include "bulk_scoring.h"
+#include "../Common/batch_layout.h"
+#include "model_cache.h"
+#include "server_log.h"
+#include "worker_pool.h"
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <exception>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace seal;
+namespace fs = std::filesystem;
+
+// result_app.py normalize_data / train_model.py MinMaxScaler와 같은 특성 순서와 범위
+// (MLP 모델 파일에 특성 목록이 있으면 그것을 쓴다)
+static const vector<FeatureRange> default_features = {
+    { "age", 29, 77 },
+    { "trestbps", 94, 200 },
+    { "chol", 126, 564 },
+    { "thalach", 71, 202 },
+};
+
+static const string label_column = "condition";
+
+// 암호문 하나 분량의 행 묶음
+struct BulkBatch {
+    vector<size_t> row_numbers;          // 입력 CSV의 데이터 행 번호 (헤더 제외, 1부터)
+    vector<vector<double>> patients;     // 정규화된 특성
+    vector<int> labels;                  // condition 열이 있을 때만
+};
+
+static vector<string> split_csv_line(const string& line) {
+    vector<string> fields;
+    string field;
+    istringstream line_stream(line);
+    while (getline(line_stream, field, ',')) {
+        size_t begin = field.find_first_not_of(" \t\r");
+        size_t end = field.find_last_not_of(" \t\r");
+        fields.push_back(begin == string::npos ? "" : field.substr(begin, end - begin + 1));
+    }
+    return fields;
+}
+
+// --- 헤더로 열 위치를 찾고 한 번에 배치 하나씩 읽는 CSV reader ---
+class CsvRowReader {
+public:
+    CsvRowReader(istream& in, const vector<FeatureRange>& features) : in_(in), features_(features) {
+        string header;
+        if (!getline(in_, header)) throw runtime_error("CSV input is empty!");
+        if (header.rfind("\xEF\xBB\xBF", 0) == 0) header.erase(0, 3);
+
+        vector<string> names = split_csv_line(header);
+        auto find_column = [&names](const string& name) -> ptrdiff_t {
+            for (size_t i = 0; i < names.size(); i++) {
+                if (names[i] == name) return static_cast<ptrdiff_t>(i);
+            }
+            return -1;
+        };
+
+        for (const FeatureRange& feature : features_) {
+            ptrdiff_t index = find_column(feature.name);
+            if (index < 0) throw runtime_error("CSV column missing: " + feature.name);
+            feature_indices_.push_back(static_cast<size_t>(index));
+        }
+        label_index_ = find_column(label_column);
+    }
+
+    bool has_label() const { return label_index_ >= 0; }
+    size_t skipped() const { return skipped_; }
+
+    // 최대 max_rows행을 batch에 채운다. 숫자가 아니거나 열이 모자란 행은 건너뛴다. 반환값 0이면 입력 끝
+    size_t read_batch(size_t max_rows, BulkBatch& batch) {
+        string line;
+        while (batch.patients.size() < max_rows && getline(in_, line)) {
+            row_number_++;
+            if (line.find_first_not_of(" \t\r") == string::npos) continue;
+
+            vector<string> fields = split_csv_line(line);
+            try {
+                vector<double> features;
+                features.reserve(features_.size());
+                for (size_t i = 0; i < features_.size(); i++) {
+                    const FeatureRange& feature = features_[i];
+                    double value = stod(fields.at(feature_indices_[i]));
+                    features.push_back((value - feature.min) / (feature.max - feature.min));
+                }
+                int label = has_label() ? stoi(fields.at(static_cast<size_t>(label_index_))) : 0;
+
+                batch.row_numbers.push_back(row_number_);
+                batch.patients.push_back(move(features));
+                if (has_label()) batch.labels.push_back(label);
+            }
+            catch (const exception&) {
+                skipped_++;
+            }
+        }
+        return batch.patients.size();
+    }
+
+private:
+    istream& in_;
+    const vector<FeatureRange>& features_;
+    vector<size_t> feature_indices_;
+    ptrdiff_t label_index_ = -1;
+    size_t row_number_ = 0;
+    size_t skipped_ = 0;
+};
+
+static double polynomial_value(const vector<double>& coeffs, double x) {
+    double value = 0.0;
+    for (size_t i = coeffs.size(); i-- > 0;) value = value * x + coeffs[i];
+    return value;
+}
+
+// 평문 기준 점수: MLP는 같은 활성화 다항식, 출력은 정확한 sigmoid
+static double reference_score(const LogisticModel& model, const vector<double>& features) {
+    vector<double> inputs = features;
+    if (model.hidden) {
+        const HiddenLayer& hidden = *model.hidden;
+        inputs = hidden.bias;
+        for (size_t t = 0; t < inputs.size(); t++) {
+            for (size_t i = 0; i < features.size(); i++) inputs[t] += hidden.weights[t][i] * features[i];
+            inputs[t] = polynomial_value(hidden.activation, inputs[t]);
+        }
+    }
+
+    double z = model.bias;
+    for (size_t i = 0; i < inputs.size(); i++) z += model.weights[i] * inputs[i];
+    return 1.0 / (1.0 + exp(-z));
+}
+
+// 출력 순서를 입력 순서와 맞추기 위해 worker 결과를 배치 번호로 모아 둔다
+struct BulkResult {
+    shared_ptr<const BulkBatch> batch;
+    vector<double> scores;
+    double seconds = 0.0;
+    exception_ptr error;
+};
+
+// 클라이언트/서버가 보내는 형태 그대로 (compr_mode_default) 직렬화한 크기
+template <class T>
+static size_t serialized_size(const T& object) {
+    ostringstream out;
+    object.save(out, Serialization::compr_mode_default);
+    return out.str().size();
+}
+
+BulkSummary score_csv(const InferenceSetup& setup, const BulkOptions& options) {
+
+    // --- 1. 모델 + 키 (검증 전용: 이 프로세스에서 생성) ---
+    // models.txt가 있으면 모든 모델을 같은 암호문에 적용해 나란히 기록
+    auto models = make_shared<const ModelSet>(load_model_set(options.model_dir));
+    const vector<FeatureRange>& features = models->models.front().features.empty()
+        ? default_features : models->models.front().features;
+    if (models->feature_count() != features.size()) {
+        throw runtime_error("Input data size mismatch with weights!");
+    }
+    const size_t model_count = models->size();
+
+    CKKSEncoder encoder(setup.context);
+    BatchLayout layout = make_circuit_layout(setup.circuit, models->feature_count(), encoder.slot_count());
+
+    cout << "[Server] Bulk scoring: generating keys...\n";
+    KeyGenerator keygen(setup.context);
+    PublicKey public_key;
+    RelinKeys relin_keys;
+    GaloisKeys galois_keys;
+    keygen.create_public_key(public_key);
+    keygen.create_relin_keys(relin_keys);
+    keygen.create_galois_keys(circuit_rotation_steps(setup.circuit, layout), galois_keys);
+
+    CacheSnapshot snapshot;
+    snapshot.keys.encryptor = make_shared<const Encryptor>(setup.context, public_key);
+    snapshot.keys.decryptor = make_shared<Decryptor>(setup.context, keygen.secret_key());
+    snapshot.keys.relin_keys = make_shared<const RelinKeys>(move(relin_keys));
+    snapshot.keys.galois_keys = make_shared<const GaloisKeys>(move(galois_keys));
+    snapshot.models = models;
+    snapshot.constants = make_shared<PlaintextCache>();
+
+    BulkSummary summary;
+    for (const LogisticModel& model : models->models) summary.models.push_back({ model.name });
+
+    if (options.measure_sizes) {
+        // 입력: 클라이언트와 같이 비밀키 암호화(seed 압축) / 결과: 마지막 레벨의 다항식 2개짜리 암호문 (compact_result_inplace와 같은 모양)
+        Plaintext plain;
+        encoder.encode(vector<double>(encoder.slot_count(), 0.0), input_scale(setup.plan), plain);
+        Encryptor symmetric(setup.context, keygen.secret_key());
+        summary.input_ciphertext_bytes = serialized_size(symmetric.encrypt_symmetric(plain));
+
+        Ciphertext result;
+        snapshot.keys.encryptor->encrypt(plain, result);
+        Evaluator evaluator(setup.context);
+        evaluator.mod_switch_to_inplace(result, setup.context.last_parms_id());
+        summary.result_ciphertext_bytes = serialized_size(result);
+        summary.key_bytes = serialized_size(*snapshot.keys.relin_keys) + serialized_size(*snapshot.keys.galois_keys);
+    }
+
+    auto started = chrono::steady_clock::now();
+
+    // --- 2. 입력 / 출력 ---
+    ifstream in(options.input_path);
+    if (!in.is_open()) throw runtime_error("Failed to open " + options.input_path.string());
+    CsvRowReader reader(in, features);
+    summary.has_label = reader.has_label();
+
+    // output_path가 비어 있으면 (파라미터 스윕) 행별 CSV 없이 요약만
+    const bool write_rows = !options.output_path.empty();
+    ofstream out;
+    if (write_rows) {
+        out.open(options.output_path);
+        if (!out.is_open()) throw runtime_error("Failed to open " + options.output_path.string());
+
+        // 모델이 하나면 encrypted_score,plaintext_score,abs_error / 여러 개면 모델마다 <이름>_encrypted,<이름>_plaintext,<이름>_abs_error
+        out << "row" << (reader.has_label() ? "," + label_column : "");
+        for (const LogisticModel& model : models->models) {
+            string prefix = model_count == 1 ? "" : model.name + "_";
+            string suffix = model_count == 1 ? "_score" : "";
+            out << "," << prefix << "encrypted" << suffix << "," << prefix << "plaintext" << suffix << "," << prefix << "abs_error";
+        }
+        out << "\n";
+        out.precision(6);
+        out << fixed;
+    }
+
+    // --- 3. 배치 단위 병렬 채점 (기록되지 않은 배치 수 제한 → 입력 크기와 무관한 메모리) ---
+    mutex result_mutex;
+    condition_variable cv;
+    map<size_t, BulkResult> finished;
+
+    size_t next_to_write = 0;
+
+    // 다음 순서의 배치를 기록 (main 스레드만 호출). wait가 false이고 아직 안 끝났으면 false
+    auto write_next = [&](bool wait) {
+        BulkResult result;
+        {
+            unique_lock<mutex> lock(result_mutex);
+            if (wait) cv.wait(lock, [&] { return finished.count(next_to_write) > 0; });
+            auto it = finished.find(next_to_write);
+            if (it == finished.end()) return false;
+            result = move(it->second);
+            finished.erase(it);
+        }
+        if (result.error) rethrow_exception(result.error);
+
+        const BulkBatch& batch = *result.batch;
+        summary.batches++;
+        summary.batch_seconds += result.seconds;
+        for (size_t i = 0; i < batch.patients.size(); i++) {
+            if (write_rows) {
+                out << batch.row_numbers[i];
+                if (reader.has_label()) out << "," << batch.labels[i];
+            }
+
+            for (size_t m = 0; m < model_count; m++) {
+                double encrypted = result.scores[i * model_count + m];
+                double plaintext = reference_score(models->models[m], batch.patients[i]);
+                double abs_error = fabs(encrypted - plaintext);
+                if (write_rows) out << "," << encrypted << "," << plaintext << "," << abs_error;
+
+                BulkModelSummary& model_summary = summary.models[m];
+                bool encrypted_positive = encrypted >= 0.5;
+                bool plaintext_positive = plaintext >= 0.5;
+                if (encrypted_positive == plaintext_positive) model_summary.agreements++;
+                if (reader.has_label()) {
+                    if (encrypted_positive == (batch.labels[i] != 0)) model_summary.encrypted_correct++;
+                    if (plaintext_positive == (batch.labels[i] != 0)) model_summary.plaintext_correct++;
+                }
+                model_summary.max_abs_error = max(model_summary.max_abs_error, abs_error);
+                model_summary.total_abs_error += abs_error;
+            }
+            if (write_rows) out << "\n";
+        }
+        summary.rows += batch.patients.size();
+        next_to_write++;
+        return true;
+    };
+
+    // pool은 위의 상태보다 나중에 만들어 먼저 소멸 (남은 작업이 끝난 뒤 상태가 정리됨)
+    WorkerPool pool(setup.context, options.workers);
+    const size_t max_pending = pool.size() * 2;
+
+    cout << "[Server] Bulk scoring " << options.input_path << " with " << pool.size() << " workers ("
+         << layout.patients_per_ciphertext << " rows per ciphertext)\n";
+
+    size_t submitted = 0;
+    while (true) {
+        auto batch = make_shared<BulkBatch>();
+        if (reader.read_batch(layout.patients_per_ciphertext, *batch) == 0) break;
+
+        // 앞선 배치가 늦게 끝나도 결과가 쌓이지 않도록, 기록 전인 배치가 max_pending개면 먼저 기록
+        while (submitted - next_to_write >= max_pending) write_next(true);
+
+        size_t sequence = submitted++;
+        pool.submit([&, batch, sequence](WorkerContext& worker) {
+            BulkResult result;
+            result.batch = batch;
+            try {
+                auto batch_start = chrono::steady_clock::now();
+                result.scores = score_patients(setup, worker, snapshot, batch->patients);
+                result.seconds = chrono::duration<double>(chrono::steady_clock::now() - batch_start).count();
+            }
+            catch (...) {
+                result.error = current_exception();
+            }
+            {
+                lock_guard<mutex> lock(result_mutex);
+                finished.emplace(sequence, move(result));
+            }
+            cv.notify_all();
+        });
+
+        while (next_to_write < submitted && write_next(false)) {}
+        if (submitted % 16 == 0) {
+            LogLine() << "[Server] Bulk scoring: " << summary.rows << " rows scored, " << submitted << " batches submitted\n";
+        }
+    }
+    while (next_to_write < submitted) write_next(true);
+    if (write_rows) out.close();
+
+    summary.skipped = reader.skipped();
+    summary.seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+    return summary;
+}
+
+void run_bulk_scoring(const InferenceSetup& setup, const BulkOptions& options) {
+    BulkSummary summary = score_csv(setup, options);
+    size_t rows = summary.rows;
+
+    // --- 4. 요약 ---
+    LogLine log;
+    log << "[Server] Bulk scoring finished: " << rows << " rows (" << summary.skipped << " skipped) in "
+        << summary.seconds << " s (" << (summary.seconds > 0 ? rows / summary.seconds : 0.0) << " rows/s)\n";
+    for (size_t m = 0; rows > 0 && m < summary.models.size(); m++) {
+        const BulkModelSummary& model = summary.models[m];
+        log << "[Server]   model " << model.name << ": encrypted vs plaintext max abs error "
+            << model.max_abs_error << ", mean abs error " << model.total_abs_error / rows
+            << ", decision agreement " << 100.0 * model.agreements / rows << "%\n";
+        if (summary.has_label) {
+            log << "[Server]     accuracy (" << label_column << "): encrypted " << 100.0 * model.encrypted_correct / rows
+                << "%, plaintext " << 100.0 * model.plaintext_correct / rows << "%\n";
+        }
+    }
+    log << "[Server]   scores written to " << options.output_path << "\n";
+}
@@ -0,0 +1,51 @@
+﻿#pragma once
+#include "inference.h"
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// --- CSV 일괄 채점 (오프라인 모델 검증) ---
+// heart_cleveland.csv 형식(헤더 포함)의 CSV를 스트리밍으로 읽어 result_app.py와 같은 범위로 정규화하고,
+// 암호문 하나에 들어가는 만큼(patients_per_ciphertext행)씩 묶어 worker pool에서 병렬로 채점한다.
+// 키는 이 프로세스 안에서 새로 만들므로 클라이언트나 Shared_Channel이 필요 없다.
+// 출력 CSV에는 행마다 암호 경로 점수와 평문 기준 점수(정확한 sigmoid)를 나란히 적는다.
+//   row,condition,encrypted_score,plaintext_score,abs_error
+// MLP 모델(--circuit mlp<입력>x<은닉>)은 모델 파일의 특성 목록과 범위로 정규화하고 평문 기준도 같은 활성화 다항식을 쓴다.
+// models.txt로 모델이 여러 개면 같은 암호문에 모두 적용하고 모델마다 <이름>_encrypted,<이름>_plaintext,<이름>_abs_error 열을 쓴다.
+// 메모리는 입력 크기와 무관하게 (진행 중인 배치 수 x 배치 크기)로 제한된다.
+struct BulkOptions {
+    std::filesystem::path input_path;
+    std::filesystem::path output_path;       // 비어 있으면 CSV를 쓰지 않고 요약만 (파라미터 스윕)
+    std::filesystem::path model_dir = ".";   // models.txt 또는 weights.txt / bias.txt 위치
+    size_t workers = 0;                      // 0이면 CPU 코어 수
+    bool measure_sizes = false;              // 입력/결과 암호문과 키의 직렬화 크기도 잰다
+};
+
+// 모델별 암호 경로 vs 평문 기준 비교
+struct BulkModelSummary {
+    std::string name;
+    size_t agreements = 0;         // 0.5 기준 판정이 같은 행 수
+    size_t encrypted_correct = 0;  // condition 열과 맞은 행 수 (열이 있을 때만)
+    size_t plaintext_correct = 0;
+    double max_abs_error = 0.0;
+    double total_abs_error = 0.0;
+};
+
+struct BulkSummary {
+    size_t rows = 0;
+    size_t skipped = 0;
+    bool has_label = false;
+    double seconds = 0.0;          // 키 생성 제외, 읽기부터 마지막 기록까지
+    size_t batches = 0;
+    double batch_seconds = 0.0;    // 배치(암호문 하나)마다 암호화~복호화에 쓴 시간의 합
+    size_t input_ciphertext_bytes = 0;   // measure_sizes: 클라이언트가 보내는 seed 압축 입력 암호문 하나
+    size_t result_ciphertext_bytes = 0;  // measure_sizes: 마지막 레벨로 줄인 결과 암호문 하나 (암호문 응답)
+    size_t key_bytes = 0;                // measure_sizes: RelinKeys + GaloisKeys
+    std::vector<BulkModelSummary> models;
+};
+
+// CSV 전체를 채점하고 요약을 돌려준다 (output_path가 있으면 행별 CSV도 씀). 입력/모델 파일 문제는 runtime_error
+BulkSummary score_csv(const InferenceSetup& setup, const BulkOptions& options);
+
+// score_csv 후 정확도/오차 요약을 출력한다
+void run_bulk_scoring(const InferenceSetup& setup, const BulkOptions& options);
@@ -0,0 +1,110 @@
+﻿#include "dense_layer.h"
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+using namespace seal;
+
+Ciphertext multiply_dense(WorkerContext& worker, const GaloisKeys& galois_keys, PlaintextCache& constants,
+    const BatchLayout& layout, const string& name, const vector<vector<double>>& weights,
+    double weight_factor, double plain_scale, const Ciphertext& x, DenseStats* stats) {
+
+    size_t width = layout.vector_width();
+    if (layout.replicas != 2) throw runtime_error("Dense layer needs a replicated batch layout!");
+    if (weights.empty() || weights.size() > width || weights.front().size() > width) {
+        throw runtime_error("Dense layer " + name + " does not fit the batch layout!");
+    }
+
+    Evaluator& evaluator = worker.evaluator;
+    CKKSEncoder& encoder = worker.encoder;
+    const MemoryPoolHandle& pool = worker.pool;
+    size_t baby_step = dense_baby_step(layout);
+    size_t giant_steps = width / baby_step;
+    DenseStats local_stats;
+    local_stats.width = width;
+    local_stats.baby_step = baby_step;
+    local_stats.giant_steps = giant_steps;
+
+    // 대각선 i: diag_i[t] = W[t][(t + i) mod d] (범위 밖은 0)
+    auto diagonal = [&](size_t i) {
+        vector<double> diag(width, 0.0);
+        for (size_t t = 0; t < weights.size(); t++) {
+            size_t column = (t + i) % width;
+            if (column < weights[t].size()) diag[t] = weights[t][column] * weight_factor;
+        }
+        return diag;
+    };
+    // 대각선 벡터는 평문 상수를 처음 인코딩할 때만 만든다 (요청마다 width 크기 vector를 할당하지 않음)
+    auto diagonal_is_zero = [&](size_t i) {
+        for (size_t t = 0; t < weights.size(); t++) {
+            size_t column = (t + i) % width;
+            if (column < weights[t].size() && weights[t][column] * weight_factor != 0.0) return false;
+        }
+        return true;
+    };
+
+    // baby step: rot(x, b), b = 1 .. g-1 (한 번씩만 회전, b = 0은 x 그대로). 버퍼는 worker가 요청마다 재사용
+    vector<Ciphertext>& rotated_inputs = worker.scratch.rotations;
+    WorkerScratch::reserve(rotated_inputs, baby_step, pool);
+    for (size_t b = 1; b < baby_step; b++) {
+        evaluator.rotate_vector(x, static_cast<int>(b), galois_keys, rotated_inputs[b], pool);
+        local_stats.rotations++;
+    }
+
+    Ciphertext result(pool);
+    Ciphertext& inner = worker.scratch.inner;
+    Ciphertext& term = worker.scratch.term;
+    bool has_result = false;
+    for (size_t j = 0; j < giant_steps; j++) {
+        size_t shift = j * baby_step;
+        bool has_inner = false;
+        for (size_t b = 0; b < baby_step; b++) {
+            size_t i = shift + b;
+            if (diagonal_is_zero(i)) continue;
+
+            // rot(diag_i, -jg): 블록마다 복제한 슬롯 벡터 전체를 오른쪽으로 jg칸
+            const Plaintext& plain_diag = constants.slots(name + "/diag" + to_string(i), encoder, pool, [&] {
+                vector<double> slots = replicate_per_block(layout, diagonal(i), layout.patients_per_ciphertext);
+                slots.resize(layout.slot_count, 0.0);
+                rotate(slots.begin(), slots.end() - static_cast<ptrdiff_t>(shift), slots.end());
+                return slots;
+            }, x.parms_id(), plain_scale);
+
+            evaluator.multiply_plain(b == 0 ? x : rotated_inputs[b], plain_diag, term, pool);
+            local_stats.multiplications++;
+            if (has_inner) {
+                evaluator.add_inplace(inner, term);
+            }
+            else {
+                inner = term;
+                has_inner = true;
+            }
+        }
+        if (!has_inner) continue;
+
+        if (shift > 0) {
+            evaluator.rotate_vector_inplace(inner, static_cast<int>(shift), galois_keys, pool);
+            local_stats.rotations++;
+        }
+        if (has_result) {
+            evaluator.add_inplace(result, inner);
+        }
+        else {
+            result = inner;
+            has_result = true;
+        }
+    }
+    if (!has_result) throw runtime_error("Dense layer " + name + " has only zero weights!");
+
+    evaluator.rescale_to_next_inplace(result, pool);
+    if (stats) *stats = local_stats;
+    return result;
+}
+
+void replicate_halves_inplace(WorkerContext& worker, const GaloisKeys& galois_keys, const BatchLayout& layout,
+    Ciphertext& y) {
+    // rot(y, -d)는 각 블록의 앞쪽 절반을 뒤쪽 절반으로 옮긴다 (앞쪽 절반에는 이전 블록의 뒤쪽 0이 옴)
+    Ciphertext& shifted = worker.scratch.rotated;
+    worker.evaluator.rotate_vector(y, -static_cast<int>(layout.vector_width()), galois_keys, shifted, worker.pool);
+    worker.evaluator.add_inplace(y, shifted);
+}
@@ -0,0 +1,38 @@
+﻿#pragma once
+#include "seal/seal.h"
+#include "plaintext_cache.h"
+#include "worker_pool.h"
+#include "../Common/batch_layout.h"
+#include <string>
+#include <vector>
+
+// --- 암호문 밀집층: 대각선(Halevi–Shoup) 방식 행렬-벡터 곱 ---
+// 입력은 블록마다 [x | x] (make_dense_layout). 폭 d 정사각 행렬로 0을 채워 보고
+//
+//   y = sum_i diag_i ⊙ rot(x, i),   diag_i[t] = W[t][(t + i) mod d]
+//
+// 회전은 baby-step/giant-step으로 나눈다 (i = j*g + b).
+//
+//   y = sum_j rot( sum_b rot(diag_(jg+b), -jg) ⊙ rot(x, b), jg )
+//
+// - baby step 회전 rot(x, b)는 입력에 대해 한 번씩만 계산해 모든 giant step에서 재사용한다 (hoisting).
+//   회전 수는 d번에서 (g - 1) + (d / g - 1)번으로 줄어든다 (d=16이면 15 → 6).
+// - giant step의 반대 회전은 평문 대각선에 미리 적용해 두고 constants 캐시에 (대각선마다 한 번) 인코딩한다.
+// - 모두 0인 대각선은 곱하지 않는다. rescale은 모든 항을 더한 뒤 한 번만 한다.
+struct DenseStats {
+    size_t width = 0;            // 벡터 폭 d
+    size_t baby_step = 0;        // g
+    size_t giant_steps = 0;      // d / g
+    size_t rotations = 0;        // 암호문 회전 수
+    size_t multiplications = 0;  // 평문 곱셈 수
+};
+
+// y = (weight_factor * W) x. W는 행 x 열 (둘 다 d 이하). 대각선 평문은 plain_scale로 "<name>/diag<i>"에 캐시된다.
+// 결과는 블록 앞쪽 절반에 y, 뒤쪽 절반은 0이며 x보다 한 레벨 아래에 있다.
+seal::Ciphertext multiply_dense(WorkerContext& worker, const seal::GaloisKeys& galois_keys, PlaintextCache& constants,
+    const BatchLayout& layout, const std::string& name, const std::vector<std::vector<double>>& weights,
+    double weight_factor, double plain_scale, const seal::Ciphertext& x, DenseStats* stats = nullptr);
+
+// 블록 앞쪽 절반의 벡터를 뒤쪽 절반에 복사한다 ([y | 0] → [y | y], 회전 1번). 다음 밀집층의 입력 형태
+void replicate_halves_inplace(WorkerContext& worker, const seal::GaloisKeys& galois_keys, const BatchLayout& layout,
+    seal::Ciphertext& y);
@@ -0,0 +1,99 @@
+﻿#include "diagnostics.h"
+#include "server_log.h"
+#include "../Common/channel.h"
+#include <algorithm>
+#include <exception>
+#include <ostream>
+
+using namespace std;
+using namespace seal;
+namespace fs = std::filesystem;
+
+DiagnosticsSink::DiagnosticsSink(const fs::path& channel_dir, size_t sample_every)
+    : channel_dir_(channel_dir), sample_every_(sample_every) {
+    if (enabled()) thread_ = thread(&DiagnosticsSink::run, this);
+}
+
+DiagnosticsSink::~DiagnosticsSink() {
+    if (!thread_.joinable()) return;
+    {
+        lock_guard<mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_one();
+    thread_.join();
+}
+
+void DiagnosticsSink::offer(const Ciphertext& encrypted_input, size_t poly_modulus_degree) {
+    if (!enabled()) return;
+    if (counter_.fetch_add(1) % sample_every_ != 0) return;
+
+    {
+        lock_guard<mutex> lock(mutex_);
+        if (pending_) return; // 이전 저장이 아직 끝나지 않음: 요청을 기다리게 하지 않고 건너뜀
+
+        // worker의 메모리 풀이 아닌 전역 풀에 복사 (worker는 곧 원본을 연산에 사용)
+        pending_ = make_unique<Ciphertext>(MemoryManager::GetPool());
+        *pending_ = encrypted_input;
+        pending_degree_ = poly_modulus_degree;
+    }
+    cv_.notify_one();
+}
+
+void DiagnosticsSink::run() {
+    while (true) {
+        unique_ptr<Ciphertext> sample;
+        size_t poly_modulus_degree;
+        {
+            unique_lock<mutex> lock(mutex_);
+            cv_.wait(lock, [this] { return stopping_ || pending_; });
+            if (!pending_) return;
+            sample = move(pending_);
+            poly_modulus_degree = pending_degree_;
+        }
+
+        try {
+            write_artifacts(*sample, poly_modulus_degree);
+        }
+        catch (const exception& e) {
+            LogLine() << "[Server] Error saving ciphertext info: " << e.what() << "\n";
+        }
+    }
+}
+
+void DiagnosticsSink::write_artifacts(const Ciphertext& encrypted_input, size_t poly_modulus_degree) const {
+    // 1. 암호문 메타데이터 + 일부 계수 (처음 100개)
+    write_file_atomic(channel_dir_ / "ciphertext_info.txt", [&](ostream& cipher_info) {
+        cipher_info << "Ciphertext Information\n";
+        cipher_info << "=====================\n";
+        cipher_info << "Size (polynomials): " << encrypted_input.size() << "\n";
+        cipher_info << "Poly Modulus Degree: " << poly_modulus_degree << "\n";
+        cipher_info << "Coeff Modulus Size: " << encrypted_input.coeff_modulus_size() << "\n";
+        cipher_info << "Scale: " << encrypted_input.scale() << "\n";
+
+        size_t sample_count = min(static_cast<size_t>(100),
+            static_cast<size_t>(encrypted_input.size() * poly_modulus_degree * encrypted_input.coeff_modulus_size()));
+        cipher_info << "\nSample Coefficients (first " << sample_count << "):\n";
+
+        const auto* cipher_data = encrypted_input.data();
+        for (size_t i = 0; i < sample_count; i++) {
+            cipher_info << cipher_data[i];
+            if (i < sample_count - 1) cipher_info << " ";
+        }
+        cipher_info << "\n";
+    });
+
+    // 2. 암호문 바이너리 (이미지 변환용)
+    // save가 돌려주는 바이트 수가 곧 직렬화 크기이므로 크기 측정용 직렬화를 따로 하지 않는다
+    streamoff cipher_size = 0;
+    write_file_atomic(channel_dir_ / "ciphertext_binary.dat", [&](ostream& cipher_binary) {
+        cipher_size = encrypted_input.save(cipher_binary);
+    }, true);
+
+    // 3. 암호문 바이너리 크기 정보
+    write_file_atomic(channel_dir_ / "ciphertext_size.txt", [&](ostream& cipher_size_info) {
+        cipher_size_info << cipher_size << "\n";
+    });
+
+    LogLine() << "[Server] Ciphertext diagnostics saved (" << cipher_size << " bytes).\n";
+}
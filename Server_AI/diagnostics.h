@@ -0,0 +1,42 @@
+﻿#pragma once
+#include "seal/seal.h"
+#include <atomic>
+#include <condition_variable>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// --- 암호문 진단 파일 (시각화용, 선택 기능) ---
+// ciphertext_info.txt / ciphertext_size.txt / ciphertext_binary.dat은 점수 계산에 필요 없다.
+// 요청 경로에서는 샘플링 여부만 보고, 선택된 암호문의 복사본을 백그라운드 스레드에 넘겨 저장한다.
+// sample_every가 0이면 비활성화되어 요청 경로에 추가 직렬화/파일 I/O가 전혀 없다.
+class DiagnosticsSink {
+public:
+    // sample_every번째 요청마다 한 번 저장 (1이면 매 요청)
+    DiagnosticsSink(const std::filesystem::path& channel_dir, size_t sample_every);
+    ~DiagnosticsSink();
+
+    DiagnosticsSink(const DiagnosticsSink&) = delete;
+    DiagnosticsSink& operator=(const DiagnosticsSink&) = delete;
+
+    bool enabled() const { return sample_every_ > 0; }
+
+    // 요청마다 호출. 샘플 차례이고 저장 대기 중인 암호문이 없을 때만 복사해서 넘긴다 (밀리면 버림)
+    void offer(const seal::Ciphertext& encrypted_input, size_t poly_modulus_degree);
+
+private:
+    void run();
+    void write_artifacts(const seal::Ciphertext& encrypted_input, size_t poly_modulus_degree) const;
+
+    std::filesystem::path channel_dir_;
+    size_t sample_every_;
+    std::atomic<size_t> counter_{ 0 };
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::unique_ptr<seal::Ciphertext> pending_;
+    size_t pending_degree_ = 0;
+    bool stopping_ = false;
+    std::thread thread_;
+};
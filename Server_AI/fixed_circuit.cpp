@@ -0,0 +1,53 @@
+﻿#include "fixed_circuit.h"
+
+using namespace std;
+using namespace seal;
+
+FixedLevels::FixedLevels(const SEALContext& context, size_t depth) {
+    auto data = context.first_context_data();
+    if (!data || data->chain_index() != depth) {
+        throw runtime_error("Fixed circuit needs " + to_string(depth) + " levels, context has "
+            + (data ? to_string(data->chain_index()) : string("none")));
+    }
+    parms_ids_.resize(depth + 1);
+    primes_.resize(depth + 1);
+    for (; data; data = data->next_context_data()) {
+        size_t index = data->chain_index();
+        parms_ids_[index] = data->parms_id();
+        // rescale_to_next가 나누는 소수 (polynomial.h의 rescale_prime과 같음)
+        primes_[index] = static_cast<double>(data->parms().coeff_modulus().back().value());
+    }
+}
+
+FixedCircuits::FixedCircuits(const SEALContext& context, const CircuitSpec& circuit, const ParameterPlan& plan)
+    : circuit_(circuit), plan_(plan) {
+    if (circuit.hidden_units > 0) return;
+    levels_ = make_unique<const FixedLevels>(context, circuit_depth(circuit));
+
+    // --- 배포하는 모델 모양 (특성 수) ---
+    // 새 모양은 여기에 한 줄 추가한다 (컴파일 시간과 바이너리 크기가 모양마다 조금씩 늘어남)
+    add<4>(); // train_model.py 로지스틱 회귀: age, trestbps, chol, thalach
+}
+
+const FixedCircuit* FixedCircuits::find(const ModelSet& models) const {
+    if (models.models.empty() || models.hidden_count() != 0) return nullptr;
+    size_t feature_count = models.feature_count();
+    for (const auto& circuit : circuits_) {
+        if (circuit->feature_count() == feature_count) return circuit.get();
+    }
+    return nullptr;
+}
+
+string FixedCircuits::describe() const {
+    if (circuits_.empty()) return "none";
+    string text;
+    for (const auto& circuit : circuits_) {
+        if (!text.empty()) text += ", ";
+        text += circuit->name();
+        if (circuit->sigmoid_degree() > 0) {
+            text += " (baby step " + to_string(circuit->sigmoid_baby_step()) + ", depth "
+                + to_string(circuit->sigmoid_depth()) + ")";
+        }
+    }
+    return text;
+}
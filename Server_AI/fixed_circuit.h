@@ -0,0 +1,429 @@
+﻿#pragma once
+#include "seal/seal.h"
+#include "model_cache.h"
+#include "plaintext_cache.h"
+#include "polynomial.h"
+#include "worker_pool.h"
+#include "../Common/batch_layout.h"
+#include "../Common/param_planner.h"
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// --- 모델 모양별로 컴파일 시점에 특화한 추론 회로 ---
+// inference.cpp의 일반 경로는 특성 수, 다항식 차수, baby step, 레벨을 요청마다 계산하고 분기한다
+// (baby step 선택, 계수 목록 분할과 0 검사, parms_id 탐색, 같은 레벨 피연산자의 복사 후 mod switch).
+// 배포하는 모델 모양(로지스틱 회귀의 특성 수 + sigmoid 차수)은 템플릿 인자로 고정해
+//
+//   - 회전-합산 폭, baby step, 분할 지점, 모든 곱셈/덧셈 항의 레벨(chain index)을 컴파일 시점에 정하고
+//     레벨이 모자라거나 계수 배열이 맞지 않으면 static_assert로 빌드를 멈춘다.
+//   - 0 계수 항과 상수 분기는 if constexpr로 사라지고, 같은 레벨끼리는 복사 없이 바로 곱한다.
+//   - 레벨별 parms_id와 rescale 소수는 서버 시작 때 한 번 표(FixedLevels)로 만든다.
+//     modulus chain 길이가 회로 깊이와 다르면 그때 runtime_error.
+//
+// 연산 순서와 상수 평문의 scale은 일반 경로와 같으므로 결과와 평문 상수 캐시 항목도 같다.
+// 등록되지 않은 모양(MLP 모델, 다른 특성 수)은 일반 경로로 처리한다.
+
+// --- sigmoid 근사 다항식 계수 (c0, c1, ..., cd) ---
+template <size_t Degree>
+struct SigmoidCoefficients;
+
+template <>
+struct SigmoidCoefficients<3> {
+    // 0 근처 Taylor 전개 0.5 + 0.25*z - (1/48)*z^3 (|z| < 2 정도에서 정확)
+    static constexpr std::array<double, 4> values = { 0.5, 0.25, 0.0, -1.0 / 48.0 };
+};
+
+template <>
+struct SigmoidCoefficients<5> {
+    // [-8, 8] 구간 최소제곱 근사 (최대 오차 약 0.061)
+    static constexpr std::array<double, 6> values = { 0.5, 0.1912998522, 0.0, -0.004595579959, 0.0, 4.222206126e-05 };
+};
+
+template <>
+struct SigmoidCoefficients<7> {
+    // [-8, 8] 구간 최소제곱 근사 (최대 오차 약 0.032)
+    static constexpr std::array<double, 8> values = { 0.5, 0.2168917246, 0.0, -0.008194077318, 0.0, 0.0001659080439, 0.0,
+        -1.196247807e-06 };
+};
+
+// 레벨(chain index)별 parms_id와 rescale 소수
+class FixedLevels {
+public:
+    // 데이터 레벨의 최고 chain index가 depth가 아니면 runtime_error
+    FixedLevels(const seal::SEALContext& context, size_t depth);
+
+    size_t depth() const { return parms_ids_.size() - 1; }
+    seal::parms_id_type parms_id(size_t chain_index) const { return parms_ids_[chain_index]; }
+    double prime(size_t chain_index) const { return primes_[chain_index]; }
+
+private:
+    std::vector<seal::parms_id_type> parms_ids_;
+    std::vector<double> primes_;
+};
+
+// --- 계수가 고정된 다항식 (polynomial.h의 baby-step giant-step과 같은 연산 순서) ---
+// Coeffs: 계수 배열 (c0 .. cd), Levels: 입력 x의 chain index
+template <const auto& Coeffs, size_t Levels>
+class FixedPolynomial {
+public:
+    static constexpr size_t degree = Coeffs.size() - 1;
+    static_assert(degree >= 1 && Coeffs[degree] != 0.0, "Polynomial must have degree 1 or more without trailing zeros");
+
+    static constexpr BabyStepPlan plan = choose_baby_step(degree, Levels);
+    static_assert(plan.baby_step != 0, "Not enough levels for polynomial");
+    static constexpr size_t baby_step = plan.baby_step;
+    static constexpr size_t result_level = Levels - plan.depth;
+
+    FixedPolynomial(const FixedLevels& levels, WorkerContext& worker, const seal::RelinKeys& relin_keys,
+        PlaintextCache& constants)
+        : levels_(levels), worker_(worker), relin_keys_(relin_keys), constants_(constants),
+          baby_(worker.scratch.baby_powers), giant_(worker.scratch.giant_powers) {}
+
+    // 결과는 x와 같은 scale, result_level에 있다 (x는 Levels 레벨)
+    seal::Ciphertext evaluate(const seal::Ciphertext& x) {
+        x_ = &x;
+        WorkerScratch::reserve(baby_, plan.top_power + 1, worker_.pool);
+        build_baby(std::make_index_sequence<plan.top_power + 1>());
+        WorkerScratch::reserve(giant_, plan.giant_count, worker_.pool);
+        build_giant(std::make_index_sequence<plan.giant_count>());
+
+        seal::Ciphertext result = evaluate_range<0, degree + 1, result_level>(x.scale());
+        relinearize(result);
+        return result;
+    }
+
+private:
+    // x^j의 레벨 (x^j = x^h * x^(j - h)마다 rescale 한 번)과 x^(k * 2^j)의 레벨
+    static constexpr size_t power_level(size_t j) { return Levels - ceil_log2(j); }
+    static constexpr size_t giant_level(size_t j) { return Levels - ceil_log2(baby_step) - j; }
+
+    static constexpr size_t first_nonzero(size_t from, size_t to) {
+        while (from < to && Coeffs[from] == 0.0) from++;
+        return from;
+    }
+    static constexpr bool all_zero(size_t from, size_t to) { return first_nonzero(from, to) == to; }
+
+    // 항 count개인 조각의 분할 지점 k * 2^j (분할 지점 < count <= 2 * 분할 지점)
+    static constexpr size_t split_power(size_t count) {
+        size_t j = 0;
+        while ((baby_step << (j + 1)) < count) j++;
+        return j;
+    }
+
+    template <size_t J>
+    const seal::Ciphertext& power() const {
+        if constexpr (J == 1) return *x_;
+        else return baby_[J];
+    }
+
+    template <size_t... J>
+    void build_baby(std::index_sequence<J...>) { (build_baby_power<J>(), ...); }
+
+    template <size_t J>
+    void build_baby_power() {
+        if constexpr (J >= 2) {
+            // x^j = x^h * x^(j - h), h = j보다 작은 최대 2의 거듭제곱 (x^h가 같거나 낮은 레벨)
+            constexpr size_t h = size_t(1) << (ceil_log2(J) - 1);
+            seal::Evaluator& evaluator = worker_.evaluator;
+            if constexpr (h == J - h) {
+                evaluator.square(power<h>(), baby_[J], worker_.pool);
+            }
+            else if constexpr (power_level(h) == power_level(J - h)) {
+                evaluator.multiply(power<h>(), power<J - h>(), baby_[J], worker_.pool);
+            }
+            else {
+                seal::Ciphertext& lowered = worker_.scratch.term;
+                evaluator.mod_switch_to(power<J - h>(), levels_.parms_id(power_level(h)), lowered, worker_.pool);
+                evaluator.multiply(power<h>(), lowered, baby_[J], worker_.pool);
+            }
+            evaluator.rescale_to_next_inplace(baby_[J], worker_.pool);
+            // x^(k/2) 이하만 다른 거듭제곱의 인수로 쓰인다. 나머지는 상수배만 되므로 재선형화를 미룸
+            if constexpr (J <= baby_step / 2) relinearize(baby_[J]);
+        }
+    }
+
+    template <size_t... J>
+    void build_giant(std::index_sequence<J...>) { (build_giant_power<J>(), ...); }
+
+    template <size_t J>
+    void build_giant_power() {
+        const seal::Ciphertext* half = nullptr;
+        if constexpr (J == 0) half = &power<baby_step / 2>();
+        else half = &giant_[J - 1];
+        worker_.evaluator.square(*half, giant_[J], worker_.pool);
+        relinearize(giant_[J]);
+        worker_.evaluator.rescale_to_next_inplace(giant_[J], worker_.pool);
+    }
+
+    // 계수 [Begin, End)가 나타내는 다항식을 Chain 레벨, scale로 계산 (상수가 아닌 다항식만)
+    template <size_t Begin, size_t End, size_t Chain>
+    seal::Ciphertext evaluate_range(double scale) {
+        constexpr size_t count = End - Begin;
+        if constexpr (count <= baby_step) {
+            return evaluate_leaf<Begin, End, Chain>(scale);
+        }
+        else {
+            // p = q * x^split + r
+            constexpr size_t j = split_power(count);
+            constexpr size_t middle = Begin + (baby_step << j);
+            if constexpr (all_zero(middle, End)) {
+                return evaluate_range<Begin, middle, Chain>(scale);
+            }
+            else {
+                static_assert(giant_level(j) >= Chain + 1, "Giant step power is below its use");
+                seal::Evaluator& evaluator = worker_.evaluator;
+                const seal::Ciphertext& giant = giant_[j];
+
+                // q * giant를 한 레벨 위에서 곱해 rescale하면 정확히 (Chain, scale)이 되도록 q의 scale을 정함
+                double q_scale = scale * levels_.prime(Chain + 1) / giant.scale();
+
+                seal::Ciphertext result(worker_.pool);
+                if constexpr (all_zero(middle + 1, End)) {
+                    evaluator.mod_switch_to(giant, levels_.parms_id(Chain + 1), result, worker_.pool);
+                    multiply_constant(result, Coeffs[middle], q_scale);
+                }
+                else {
+                    result = evaluate_range<middle, End, Chain + 1>(q_scale);
+                    relinearize(result);
+                    if constexpr (giant_level(j) == Chain + 1) {
+                        evaluator.multiply_inplace(result, giant, worker_.pool);
+                    }
+                    else {
+                        seal::Ciphertext& lowered = worker_.scratch.term;
+                        evaluator.mod_switch_to(giant, levels_.parms_id(Chain + 1), lowered, worker_.pool);
+                        evaluator.multiply_inplace(result, lowered, worker_.pool);
+                    }
+                }
+                evaluator.rescale_to_next_inplace(result, worker_.pool);
+                result.scale() = scale; // 부동소수점 반올림 오차만 정리
+
+                add_remainder<Begin, middle, Chain>(result, scale);
+                return result;
+            }
+        }
+    }
+
+    // 차수 k 미만: sum c_j * x^j (상수배 항을 모두 더한 뒤 rescale 한 번) + c_0
+    template <size_t Begin, size_t End, size_t Chain>
+    seal::Ciphertext evaluate_leaf(double scale) {
+        constexpr size_t first = first_nonzero(Begin + 1, End);
+        static_assert(first < End, "Polynomial leaf has no variable terms");
+        double upper_scale = scale * levels_.prime(Chain + 1);
+
+        seal::Ciphertext result(worker_.pool);
+        add_leaf_terms<Begin, first, Chain>(result, upper_scale, std::make_index_sequence<End - Begin>());
+        worker_.evaluator.rescale_to_next_inplace(result, worker_.pool);
+        result.scale() = scale;
+
+        add_constant<Begin>(result, scale);
+        return result;
+    }
+
+    template <size_t Begin, size_t First, size_t Chain, size_t... J>
+    void add_leaf_terms(seal::Ciphertext& result, double upper_scale, std::index_sequence<J...>) {
+        (add_leaf_term<Begin, First, Chain, J>(result, upper_scale), ...);
+    }
+
+    // c_j * x^j를 Chain + 1 레벨, upper_scale로 만들어 result에 더한다 (첫 항은 result에 바로)
+    template <size_t Begin, size_t First, size_t Chain, size_t J>
+    void add_leaf_term(seal::Ciphertext& result, double upper_scale) {
+        if constexpr (J >= 1 && Coeffs[Begin + J] != 0.0) {
+            static_assert(power_level(J) >= Chain + 1, "Baby step power is below its use");
+            seal::Ciphertext& term = (Begin + J == First) ? result : worker_.scratch.term;
+            worker_.evaluator.mod_switch_to(power<J>(), levels_.parms_id(Chain + 1), term, worker_.pool);
+            multiply_constant(term, Coeffs[Begin + J], upper_scale / term.scale());
+            term.scale() = upper_scale;
+            if constexpr (Begin + J != First) worker_.evaluator.add_inplace(result, term);
+        }
+    }
+
+    // result += r (계수 [Begin, End), r이 상수면 평문 덧셈)
+    template <size_t Begin, size_t End, size_t Chain>
+    void add_remainder(seal::Ciphertext& result, double scale) {
+        if constexpr (!all_zero(Begin + 1, End)) {
+            seal::Ciphertext remainder = evaluate_range<Begin, End, Chain>(scale);
+            worker_.evaluator.add_inplace(result, remainder);
+        }
+        else {
+            add_constant<Begin>(result, scale);
+        }
+    }
+
+    template <size_t I>
+    void add_constant(seal::Ciphertext& result, double scale) {
+        if constexpr (Coeffs[I] != 0.0) {
+            const seal::Plaintext& plain_constant = constants_.constant(worker_.encoder, worker_.pool, Coeffs[I],
+                result.parms_id(), scale);
+            worker_.evaluator.add_plain_inplace(result, plain_constant, worker_.pool);
+        }
+    }
+
+    void multiply_constant(seal::Ciphertext& encrypted, double value, double plain_scale) {
+        const seal::Plaintext& plain_value = constants_.constant(worker_.encoder, worker_.pool, value,
+            encrypted.parms_id(), plain_scale);
+        worker_.evaluator.multiply_plain_inplace(encrypted, plain_value, worker_.pool);
+    }
+
+    void relinearize(seal::Ciphertext& encrypted) {
+        if (encrypted.size() > 2) worker_.evaluator.relinearize_inplace(encrypted, relin_keys_, worker_.pool);
+    }
+
+    const FixedLevels& levels_;
+    WorkerContext& worker_;
+    const seal::RelinKeys& relin_keys_;
+    PlaintextCache& constants_;
+
+    const seal::Ciphertext* x_ = nullptr;
+    std::vector<seal::Ciphertext>& baby_;   // worker.scratch (이 평가 동안만 유효)
+    std::vector<seal::Ciphertext>& giant_;
+};
+
+// --- 등록된 모양 하나 ---
+class FixedCircuit {
+public:
+    virtual ~FixedCircuit() = default;
+
+    virtual size_t feature_count() const = 0;
+    virtual size_t sigmoid_degree() const = 0;
+    virtual size_t sigmoid_baby_step() const = 0;
+    virtual size_t sigmoid_depth() const = 0;
+    std::string name() const {
+        std::string shape = "logistic" + std::to_string(feature_count());
+        return sigmoid_degree() == 0 ? shape : shape + "/sigmoid" + std::to_string(sigmoid_degree());
+    }
+
+    // z = w·x + b를 블록 첫 슬롯에 계산한다 (x는 제자리에서 바뀜, inference.cpp의 일반 경로와 같은 평문 상수)
+    virtual void linear_inplace(WorkerContext& worker, const CacheSnapshot& snapshot, const BatchLayout& layout,
+        const LogisticModel& model, seal::Ciphertext& x) const = 0;
+
+    // sigmoid 근사 다항식 (sigmoid_degree가 0이면 호출하지 않음)
+    virtual seal::Ciphertext sigmoid(WorkerContext& worker, const CacheSnapshot& snapshot, const seal::Ciphertext& z) const = 0;
+};
+
+// 로지스틱 회귀 Features개 특성 + SigmoidDegree차 sigmoid 근사 (0이면 z를 그대로 복호화하는 linear 회로)
+template <size_t Features, size_t SigmoidDegree>
+class FixedLogisticCircuit final : public FixedCircuit {
+public:
+    static_assert(Features > 0, "Feature count must be positive");
+    static constexpr size_t block_width = size_t(1) << ceil_log2(Features);
+    // W*x (1) + sigmoid 다항식 (param_planner.h의 circuit_depth와 같음)
+    static constexpr size_t depth = 1 + ceil_log2(SigmoidDegree + 1);
+
+    FixedLogisticCircuit(const FixedLevels& levels, const CircuitSpec& circuit, const ParameterPlan& plan)
+        : levels_(levels), weight_factor_(bit_weight_factor(circuit.input_bit_scale)), input_scale_(input_scale(plan)) {
+        if (levels.depth() != depth) {
+            throw std::runtime_error("Fixed circuit " + name() + " needs " + std::to_string(depth) + " levels, context has "
+                + std::to_string(levels.depth()));
+        }
+    }
+
+    size_t feature_count() const override { return Features; }
+    size_t sigmoid_degree() const override { return SigmoidDegree; }
+    size_t sigmoid_baby_step() const override { return sigmoid_plan().baby_step; }
+    size_t sigmoid_depth() const override { return sigmoid_plan().depth; }
+
+    void linear_inplace(WorkerContext& worker, const CacheSnapshot& snapshot, const BatchLayout& layout,
+        const LogisticModel& model, seal::Ciphertext& x) const override {
+        seal::Evaluator& evaluator = worker.evaluator;
+        const seal::MemoryPoolHandle& pool = worker.pool;
+        PlaintextCache& constants = *snapshot.constants;
+
+        // W * x: 가중치 평문은 일반 경로와 같은 이름/scale로 캐시 (블록마다 복제)
+        const seal::Plaintext& plain_weights = constants.slots("weights/" + model.name, worker.encoder, pool, [&] {
+            std::vector<double> scaled_weights;
+            for (double w : model.weights) scaled_weights.push_back(w * weight_factor_);
+            return replicate_per_block(layout, scaled_weights, layout.patients_per_ciphertext);
+        }, levels_.parms_id(depth), input_scale_);
+        evaluator.multiply_plain_inplace(x, plain_weights, pool);
+        evaluator.rescale_to_next_inplace(x, pool);
+
+        // 회전-합산: 1, 2, 4, .., block_width / 2
+        rotate_and_sum(worker, *snapshot.keys.galois_keys, x, std::make_index_sequence<ceil_log2(block_width)>());
+
+        const seal::Plaintext& plain_bias = constants.constant(worker.encoder, pool, model.bias, levels_.parms_id(depth - 1),
+            x.scale());
+        evaluator.add_plain_inplace(x, plain_bias, pool);
+    }
+
+    seal::Ciphertext sigmoid(WorkerContext& worker, const CacheSnapshot& snapshot, const seal::Ciphertext& z) const override {
+        if constexpr (SigmoidDegree == 0) {
+            throw std::logic_error("Linear circuit has no sigmoid polynomial");
+        }
+        else {
+            Polynomial polynomial(levels_, worker, *snapshot.keys.relin_keys, *snapshot.constants);
+            return polynomial.evaluate(z);
+        }
+    }
+
+private:
+    template <size_t... Step>
+    static void rotate_and_sum(WorkerContext& worker, const seal::GaloisKeys& galois_keys, seal::Ciphertext& x,
+        std::index_sequence<Step...>) {
+        seal::Ciphertext& rotated = worker.scratch.rotated;
+        ((worker.evaluator.rotate_vector(x, 1 << Step, galois_keys, rotated, worker.pool),
+            worker.evaluator.add_inplace(x, rotated)), ...);
+    }
+
+    static constexpr BabyStepPlan sigmoid_plan() {
+        if constexpr (SigmoidDegree == 0) return BabyStepPlan();
+        else return Polynomial::plan;
+    }
+
+    // z는 W*x 뒤의 레벨 (depth - 1)에 있다
+    template <size_t Degree, bool = (Degree > 0)>
+    struct SigmoidPolynomial {
+        using type = void;
+    };
+    template <size_t Degree>
+    struct SigmoidPolynomial<Degree, true> {
+        using type = FixedPolynomial<SigmoidCoefficients<Degree>::values, depth - 1>;
+    };
+    using Polynomial = typename SigmoidPolynomial<SigmoidDegree>::type;
+
+    const FixedLevels& levels_;
+    double weight_factor_;
+    double input_scale_;
+};
+
+// --- 서버 회로(--circuit)에 대해 등록된 모양 목록 ---
+// 로지스틱 회로(linear, sigmoid3/5/7)만 특화한다. MLP 회로면 비어 있고 모든 요청이 일반 경로로 간다.
+// 요청마다 모델의 특성 수로 찾으므로 모델 파일이 바뀌어 특성 수가 달라지면 자동으로 일반 경로를 쓴다.
+class FixedCircuits {
+public:
+    // 배포하는 모양을 등록한다 (fixed_circuit.cpp). context의 레벨 수가 회로 깊이와 다르면 runtime_error
+    FixedCircuits(const seal::SEALContext& context, const CircuitSpec& circuit, const ParameterPlan& plan);
+
+    FixedCircuits(const FixedCircuits&) = delete;
+    FixedCircuits& operator=(const FixedCircuits&) = delete;
+
+    // Features개 특성 모양을 서버 회로의 sigmoid 차수로 추가 (MLP 회로면 아무 일도 하지 않음)
+    template <size_t Features>
+    void add() {
+        if (!levels_) return;
+        switch (circuit_.sigmoid_degree) {
+        case 0: circuits_.push_back(std::make_unique<FixedLogisticCircuit<Features, 0>>(*levels_, circuit_, plan_)); break;
+        case 3: circuits_.push_back(std::make_unique<FixedLogisticCircuit<Features, 3>>(*levels_, circuit_, plan_)); break;
+        case 5: circuits_.push_back(std::make_unique<FixedLogisticCircuit<Features, 5>>(*levels_, circuit_, plan_)); break;
+        case 7: circuits_.push_back(std::make_unique<FixedLogisticCircuit<Features, 7>>(*levels_, circuit_, plan_)); break;
+        default: throw std::runtime_error("No fixed circuit for sigmoid degree " + std::to_string(circuit_.sigmoid_degree));
+        }
+    }
+
+    // 모델 목록에 맞는 특화 회로 (MLP 모델이거나 등록되지 않은 특성 수면 nullptr)
+    const FixedCircuit* find(const ModelSet& models) const;
+
+    bool empty() const { return circuits_.empty(); }
+    // 로그 출력용 ("logistic13/sigmoid3 (baby step 2, depth 2)")
+    std::string describe() const;
+
+private:
+    CircuitSpec circuit_;
+    ParameterPlan plan_;
+    std::unique_ptr<const FixedLevels> levels_;
+    std::vector<std::unique_ptr<const FixedCircuit>> circuits_;
+};
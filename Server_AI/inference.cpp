@@ -0,0 +1,360 @@
+﻿#include "inference.h"
+#include "../Common/batch_layout.h"
+#include "../Common/blob_loader.h"
+#include "../Common/ckks_request.h"
+#include "dense_layer.h"
+#include "fixed_circuit.h"
+#include "polynomial.h"
+#include "server_log.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+using namespace seal;
+
+// --- Logistic Regression: Sigmoid 근사 다항식 계수 (c0, c1, ..., cd), 고정 회로와 같은 값 (fixed_circuit.h) ---
+static const vector<double>& sigmoid_coefficients(size_t degree) {
+    auto as_vector = [](const auto& values) { return vector<double>(values.begin(), values.end()); };
+    static const vector<double> taylor3 = as_vector(SigmoidCoefficients<3>::values);
+    static const vector<double> fit5 = as_vector(SigmoidCoefficients<5>::values);
+    static const vector<double> fit7 = as_vector(SigmoidCoefficients<7>::values);
+
+    switch (degree) {
+    case 3: return taylor3;
+    case 5: return fit5;
+    case 7: return fit7;
+    }
+    throw runtime_error("Unsupported sigmoid degree: " + to_string(degree));
+}
+
+// z = w·x + b를 블록 첫 슬롯에 계산한다 (x는 제자리에서 바뀜)
+// 블록 안의 w_i * x_i를 회전-합산(rotate-and-sum)으로 블록 첫 슬롯에 모은다.
+// weight_factor: 입력이 bit_scale배 정수로 인코딩되었으면 1 / bit_scale (z가 원래 스케일이 되게 함, bit_weight_factor)
+static void dot_product_inplace(const InferenceSetup& setup, WorkerContext& worker, const CacheSnapshot& snapshot,
+    const BatchLayout& layout, const LogisticModel& model, double weight_factor, Ciphertext& x) {
+
+    Evaluator& evaluator = worker.evaluator;
+    CKKSEncoder& encoder = worker.encoder;
+    const MemoryPoolHandle& pool = worker.pool;
+    PlaintextCache& constants = *snapshot.constants;
+
+    // [Step 1] W * x (가중치 곱하기, 블록마다 복제)
+    // 가중치 평문은 모델당 한 번만 인코딩 (모든 블록에 복제해 두면 환자 수와 무관하게 재사용 가능,
+    // 빈 블록은 입력이 0이므로 결과에 영향 없음)
+    const Plaintext& plain_weights = constants.slots("weights/" + model.name, encoder, pool, [&] {
+        vector<double> scaled_weights;
+        for (double w : model.weights) {
+            scaled_weights.push_back(w * weight_factor);
+        }
+        return replicate_per_block(layout, scaled_weights, layout.patients_per_ciphertext);
+    }, x.parms_id(), input_scale(setup.plan));
+
+    evaluator.multiply_plain_inplace(x, plain_weights, pool);
+    evaluator.rescale_to_next_inplace(x, pool);
+
+    // [Step 2] 내적: 회전-합산 (log2(벡터 폭)번 회전)
+    // 회전 후 더하기를 반복하면 각 블록의 첫 슬롯에 블록 전체의 합 sum(w_i * x_i)가 모인다.
+    //   [a b c d] + rot1 → [a+b b+c c+d ..] + rot2 → [a+b+c+d ...]
+    Ciphertext& rotated = worker.scratch.rotated;
+    for (int step : rotation_steps(layout)) {
+        evaluator.rotate_vector(x, step, *snapshot.keys.galois_keys, rotated, pool);
+        evaluator.add_inplace(x, rotated);
+    }
+
+    // [Step 3] Bias 더하기
+    // 점수는 블록 첫 슬롯만 읽으므로 상수는 모든 슬롯에 같은 값으로 인코딩해도 된다.
+    const Plaintext& plain_bias = constants.constant(encoder, pool, model.bias, x.parms_id(), x.scale());
+    evaluator.add_plain_inplace(x, plain_bias, pool);
+}
+
+// 2층 MLP: h = activation(W1 x + b1) → z = w2·h + b2 (z는 블록 첫 슬롯)
+// 은닉층은 대각선 방식 행렬-벡터 곱 (dense_layer.h), 출력층은 로지스틱 회귀와 같은 회전-합산
+static Ciphertext mlp_logit(const InferenceSetup& setup, WorkerContext& worker, const CacheSnapshot& snapshot,
+    const BatchLayout& layout, const LogisticModel& model, const Ciphertext& encrypted_input, RequestTrace* trace) {
+
+    const HiddenLayer& hidden = *model.hidden;
+    CKKSEncoder& encoder = worker.encoder;
+    const MemoryPoolHandle& pool = worker.pool;
+    const GaloisKeys& galois_keys = *snapshot.keys.galois_keys;
+    PlaintextCache& constants = *snapshot.constants;
+
+    // [Layer 1] W1 x + b1, 다음 층을 위해 블록 뒤쪽 절반에 복제
+    StageTimer hidden_timer(trace, Stage::linear);
+    DenseStats dense_stats;
+    Ciphertext encrypted_h = multiply_dense(worker, galois_keys, constants, layout, "hidden/" + model.name,
+        hidden.weights, bit_weight_factor(setup.circuit.input_bit_scale), input_scale(setup.plan), encrypted_input,
+        &dense_stats);
+
+    const Plaintext& plain_hidden_bias = constants.slots("hidden_bias/" + model.name, encoder, pool, [&] {
+        return replicate_per_block(layout, hidden.bias, layout.patients_per_ciphertext);
+    }, encrypted_h.parms_id(), encrypted_h.scale());
+    worker.evaluator.add_plain_inplace(encrypted_h, plain_hidden_bias, pool);
+    replicate_halves_inplace(worker, galois_keys, layout, encrypted_h);
+    hidden_timer.stop();
+
+    LogLine() << "[Server] Hidden layer (" << hidden.weights.size() << " x " << model.input_count()
+              << ") computed securely for model " << model.name << ": width " << dense_stats.width << ", baby step "
+              << dense_stats.baby_step << " x giant step " << dense_stats.giant_steps << ", "
+              << dense_stats.rotations + 1 << " rotations, " << dense_stats.multiplications << " plaintext multiplications\n";
+
+    // [Activation] 활성화 다항식 (슬롯마다 독립이므로 복제된 두 절반 모두에 적용됨)
+    StageTimer activation_timer(trace, Stage::activation);
+    PolynomialStats poly_stats;
+    Ciphertext activated = evaluate_polynomial(setup.context, worker, *snapshot.keys.relin_keys, constants, encrypted_h,
+        hidden.activation, &poly_stats);
+    activation_timer.stop();
+
+    // [Layer 2] z = w2·h + b2 (출력층 가중치는 블록 앞쪽 절반에만 있으므로 합산 범위는 벡터 폭 d)
+    StageTimer output_timer(trace, Stage::linear);
+    dot_product_inplace(setup, worker, snapshot, layout, model, 1.0, activated);
+    output_timer.stop();
+
+    LogLine() << "[Server] Activation polynomial (degree " << poly_stats.degree << ", depth " << poly_stats.depth
+              << ") and output layer computed securely for model " << model.name << "\n";
+    return activated;
+}
+
+// 회로와 모델 모양이 맞는지 확인하고 슬롯 배치를 정한다
+static BatchLayout request_layout(const InferenceSetup& setup, const ModelSet& models, size_t slot_count) {
+    const CircuitSpec& circuit = setup.circuit;
+    if (models.hidden_count() != circuit.hidden_units) {
+        throw runtime_error(models.hidden_count() == 0
+            ? "Circuit " + circuit_name(circuit) + " needs an MLP model (models.txt: <name> mlp <file>)"
+            : "MLP model with " + to_string(models.hidden_count()) + " hidden units does not match circuit "
+                + circuit_name(circuit));
+    }
+    for (const LogisticModel& model : models.models) {
+        if (model.hidden && model.hidden->activation.size() > circuit.activation_degree + 1) {
+            throw runtime_error("Activation polynomial of model " + model.name + " exceeds degree "
+                + to_string(circuit.activation_degree));
+        }
+    }
+    return make_circuit_layout(circuit, models.feature_count(), slot_count);
+}
+
+void compact_result_inplace(const SEALContext& context, WorkerContext& worker, const RelinKeys& relin_keys,
+    Ciphertext& result) {
+    // 다항식 3개 이상이면 직렬화 크기가 그만큼 커지므로 2개로 줄인다 (현재 회로는 이미 relinearize된 상태)
+    if (result.size() > 2) worker.evaluator.relinearize_inplace(result, relin_keys, worker.pool);
+    // 남은 scale(2^scale_bits)과 결과 정수부는 마지막 소수(scale + integer_bits 비트)에 들어가도록 planner가 잡아 둠
+    if (result.parms_id() != context.last_parms_id()) {
+        worker.evaluator.mod_switch_to_inplace(result, context.last_parms_id(), worker.pool);
+    }
+}
+
+// 입력 암호문(chunk당 최대 patients_per_ciphertext명)에 모델마다 z를 계산하고 sigmoid 근사를 적용해 복호화한다.
+// 로지스틱 회귀는 z = Wx + b, MLP는 은닉층을 거친 출력층의 z. sigmoid 다항식은 블록 첫 슬롯의 z에 한 번만 적용된다.
+// 모델이 여러 개면 같은 입력 암호문에 모델별 가중치 평문을 곱한다 (암호화/업로드는 한 번).
+// 반환값은 환자 순, 모델 순: scores[patient * 모델 수 + model]
+// encrypted_results가 있으면 복호화하지 않고 compact_result_inplace한 결과 암호문을 chunk 순, 모델 순으로 넣는다 (반환값은 비어 있음)
+static vector<double> score_ciphertexts(const InferenceSetup& setup, WorkerContext& worker, const CacheSnapshot& snapshot,
+    const BatchLayout& layout, vector<Ciphertext>& chunks, size_t total_patients, RequestTrace* trace,
+    vector<Ciphertext>* encrypted_results = nullptr) {
+
+    CKKSEncoder& encoder = worker.encoder;
+    const MemoryPoolHandle& pool = worker.pool;
+    const KeySet& keys = snapshot.keys;
+    const ModelSet& models = *snapshot.models;
+    PlaintextCache& constants = *snapshot.constants;
+
+    // 암호문 응답만 쓰는 클라이언트는 비밀키를 올리지 않는다
+    if (!encrypted_results && !keys.decryptor) {
+        throw runtime_error("Secret key is missing: plain responses need the secret key (use encrypted responses)");
+    }
+
+    vector<double> scores(encrypted_results ? 0 : total_patients * models.size());
+
+    // 모델 모양이 등록되어 있으면 컴파일 시점에 특화한 회로로 평가 (요청마다 한 번 찾음)
+    const FixedCircuit* fixed = setup.fixed_circuits ? setup.fixed_circuits->find(models) : nullptr;
+
+    for (size_t chunk = 0; chunk < chunks.size(); chunk++) {
+        size_t first_patient = chunk * layout.patients_per_ciphertext;
+        size_t patient_count = min(layout.patients_per_ciphertext, total_patients - first_patient);
+        Ciphertext& encrypted_input = chunks[chunk];
+
+        // 시각화용 파일은 첫 암호문만 (샘플링된 요청에서 백그라운드로) 저장
+        if (chunk == 0) setup.diagnostics.offer(encrypted_input, setup.plan.poly_modulus_degree);
+
+        for (size_t m = 0; m < models.size(); m++) {
+            const LogisticModel& model = models.models[m];
+
+            // --- 3. 동형암호 연산 (Prediction) ---
+            Ciphertext encrypted_z(pool);
+            if (model.hidden) {
+                // 밀집층은 입력을 읽기만 하므로 복사가 필요 없다
+                encrypted_z = mlp_logit(setup, worker, snapshot, layout, model, encrypted_input, trace);
+            }
+            else {
+                // 마지막 모델은 입력 암호문을 그대로 쓰고, 그 전 모델들은 복사본에서 연산
+                StageTimer linear_timer(trace, Stage::linear);
+                if (m + 1 == models.size()) encrypted_z = move(encrypted_input);
+                else encrypted_z = encrypted_input;
+                // 입력이 bit_scale배 정수로 인코딩되므로 가중치는 bit_scale로 나눔
+                if (fixed) fixed->linear_inplace(worker, snapshot, layout, model, encrypted_z);
+                else dot_product_inplace(setup, worker, snapshot, layout, model,
+                    bit_weight_factor(setup.circuit.input_bit_scale), encrypted_z);
+                linear_timer.stop();
+
+                LogLine() << "[Server] Linear prediction (Wx + b) computed securely for model " << model.name
+                          << (fixed ? " (fixed circuit " + fixed->name() + ")" : string()) << "\n";
+            }
+
+            // --- 3-1. Sigmoid ---
+            // 선형/MLP 회로는 z를 그대로 복호화한 뒤 평문에서 정확한 sigmoid를 적용한다 (곱셈 깊이를 아낌)
+            Ciphertext encrypted_result(pool);
+            if (setup.circuit.sigmoid_degree == 0) {
+                encrypted_result = move(encrypted_z);
+            }
+            else if (fixed) {
+                StageTimer sigmoid_timer(trace, Stage::sigmoid);
+                encrypted_result = fixed->sigmoid(worker, snapshot, encrypted_z);
+                sigmoid_timer.stop();
+
+                LogLine() << "[Server] Sigmoid polynomial (degree " << fixed->sigmoid_degree()
+                          << ") computed securely: fixed circuit " << fixed->name() << ", depth " << fixed->sigmoid_depth()
+                          << ", baby step " << fixed->sigmoid_baby_step() << "\n";
+            }
+            else {
+                PolynomialStats poly_stats;
+                StageTimer sigmoid_timer(trace, Stage::sigmoid);
+                encrypted_result = evaluate_polynomial(setup.context, worker, *keys.relin_keys, constants, encrypted_z,
+                    sigmoid_coefficients(setup.circuit.sigmoid_degree), &poly_stats);
+                sigmoid_timer.stop();
+
+                LogLine() << "[Server] Sigmoid polynomial (degree " << poly_stats.degree << ") computed securely: depth "
+                          << poly_stats.depth << ", baby step " << poly_stats.baby_step << ", "
+                          << poly_stats.multiplications << " ct-ct multiplications, "
+                          << poly_stats.relinearizations << " relinearizations\n";
+            }
+
+            if (encrypted_results) {
+                // --- 4. 결과 암호문 응답 (복호화와 점수 추출은 클라이언트에서) ---
+                StageTimer compact_timer(trace, Stage::compact);
+                compact_result_inplace(setup.context, worker, *keys.relin_keys, encrypted_result);
+                encrypted_results->push_back(move(encrypted_result));
+                continue;
+            }
+
+            // --- 4. 복호화 및 최종 점수 계산 ---
+            StageTimer decrypt_timer(trace, Stage::decrypt);
+            Plaintext& plain_result = worker.scratch.plain;
+            keys.decryptor->decrypt(encrypted_result, plain_result);
+            vector<double>& result_vec = worker.scratch.slots;
+            encoder.decode(plain_result, result_vec, pool);
+
+            // 환자별 점수는 블록 첫 슬롯 값 하나 (합산은 이미 암호 상태에서 끝남)
+            vector<double> block_scores = extract_block_leading(layout, result_vec, patient_count);
+            for (size_t p = 0; p < patient_count; p++) {
+                double score = block_scores[p];
+                if (setup.circuit.sigmoid_degree == 0) score = 1.0 / (1.0 + exp(-score));
+                scores[(first_patient + p) * models.size() + m] = score;
+            }
+        }
+    }
+
+    return scores;
+}
+
+// 평문 요청: 서버가 직접 환자들을 슬롯에 배치하고 공개키로 암호화
+vector<double> score_patients(const InferenceSetup& setup, WorkerContext& worker, const CacheSnapshot& snapshot,
+    const vector<vector<double>>& patients, RequestTrace* trace) {
+
+    CKKSEncoder& encoder = worker.encoder;
+    const MemoryPoolHandle& pool = worker.pool;
+
+    BatchLayout layout = request_layout(setup, *snapshot.models, encoder.slot_count());
+    vector<vector<double>> packed = pack_patients(layout, patients);
+
+    LogLine() << "[Server] Packing " << patients.size() << " patient(s) into " << packed.size()
+         << " ciphertext(s) (" << layout.patients_per_ciphertext << " per ciphertext, block size "
+         << layout.block_size << ")\n";
+
+    vector<Ciphertext> chunks;
+    chunks.reserve(packed.size());
+    for (size_t chunk = 0; chunk < packed.size(); chunk++) {
+        // 비트 인코딩 후 암호화 (scale: rescale 소수 크기와 맞춤)
+        StageTimer encrypt_timer(trace, Stage::encrypt);
+        Plaintext plain_input(pool);
+        encoder.encode(bit_encode(packed[chunk], setup.circuit.input_bit_scale), input_scale(setup.plan), plain_input, pool);
+        chunks.emplace_back(pool);
+        snapshot.keys.encryptor->encrypt(plain_input, chunks.back(), pool);
+        encrypt_timer.stop();
+
+        LogLine() << "[Server] Data encrypted successfully. (chunk " << chunk + 1 << "/" << packed.size() << ")\n";
+    }
+
+    return score_ciphertexts(setup, worker, snapshot, layout, chunks, patients.size(), trace);
+}
+
+// 암호문 요청: 클라이언트가 같은 배치/인코딩 규약으로 암호화한 입력을 역직렬화
+EncryptedInput load_encrypted_request(const InferenceSetup& setup, const CacheSnapshot& snapshot,
+    string_view request_bytes, const MemoryPoolHandle& pool, RequestTrace* trace) {
+
+    const ModelSet& models = *snapshot.models;
+    StageTimer load_timer(trace, Stage::input_load);
+
+    BlobReader reader(request_bytes);
+    CkksRequestHeader header = read_request_header(reader);
+    if (header.patient_count == 0) {
+        throw runtime_error("Request contains no patient data!");
+    }
+    if (header.feature_count != models.feature_count()) {
+        throw runtime_error("Input data size mismatch with weights!");
+    }
+
+    EncryptedInput input;
+    input.patient_count = header.patient_count;
+    input.response_mode = header.response_mode;
+    // CKKS 슬롯 수 = N / 2 (CKKSEncoder::slot_count와 같음)
+    input.layout = request_layout(setup, models, setup.plan.poly_modulus_degree / 2);
+    const BatchLayout& layout = input.layout;
+    // 헤더 값으로 reserve하기 전에 환자 수/암호문 수/남은 바이트를 맞춰 본다 (넘침 없이)
+    uint64_t expected_chunks = check_request_chunks(header, layout.patients_per_ciphertext, reader.remaining());
+
+    input.chunks.reserve(expected_chunks);
+    for (uint64_t chunk = 0; chunk < expected_chunks; chunk++) {
+        // load가 seed로부터 두 번째 다항식을 복원하고, 파라미터가 context와 맞는지 검증한다
+        input.chunks.emplace_back(pool);
+        Ciphertext& encrypted_input = input.chunks.back();
+        reader.load(setup.context, encrypted_input);
+
+        if (encrypted_input.parms_id() != setup.context.first_parms_id() || encrypted_input.size() != 2) {
+            throw runtime_error("Encrypted input is not a fresh ciphertext!");
+        }
+        if (encrypted_input.scale() != input_scale(setup.plan)) {
+            throw runtime_error("Encrypted input scale mismatch!");
+        }
+    }
+
+    load_timer.stop();
+
+    LogLine() << "[Server] Encrypted input received: " << header.patient_count << " patient(s) in "
+         << input.chunks.size() << " ciphertext(s)\n";
+    return input;
+}
+
+vector<double> score_encrypted_input(const InferenceSetup& setup, WorkerContext& worker, const CacheSnapshot& snapshot,
+    EncryptedInput& input, RequestTrace* trace) {
+    return score_ciphertexts(setup, worker, snapshot, input.layout, input.chunks, input.patient_count, trace);
+}
+
+vector<Ciphertext> evaluate_encrypted_input(const InferenceSetup& setup, WorkerContext& worker,
+    const CacheSnapshot& snapshot, EncryptedInput& input, RequestTrace* trace) {
+    vector<Ciphertext> results;
+    results.reserve(input.chunks.size() * snapshot.models->size());
+    score_ciphertexts(setup, worker, snapshot, input.layout, input.chunks, input.patient_count, trace, &results);
+    return results;
+}
+
+void save_encrypted_response(ostream& out, const ModelSet& models, size_t patient_count,
+    const vector<Ciphertext>& results) {
+    CkksResponseHeader header;
+    header.patient_count = patient_count;
+    header.ciphertext_count = results.size();
+    header.model_names = models.names();
+    write_response_header(out, header);
+    for (const Ciphertext& result : results) result.save(out, Serialization::compr_mode_default);
+}
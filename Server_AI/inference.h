@@ -0,0 +1,66 @@
+﻿#pragma once
+#include "seal/seal.h"
+#include "diagnostics.h"
+#include "metrics.h"
+#include "../Common/batch_layout.h"
+#include "../Common/ckks_request.h"
+#include "../Common/param_planner.h"
+#include "model_cache.h"
+#include "worker_pool.h"
+#include <iosfwd>
+#include <string_view>
+#include <vector>
+
+class FixedCircuits;
+
+// 요청마다 바뀌지 않는 서버 공용 설정
+struct InferenceSetup {
+    const seal::SEALContext& context;
+    CircuitSpec circuit;
+    ParameterPlan plan;
+    DiagnosticsSink& diagnostics;
+    const FixedCircuits* fixed_circuits = nullptr; // 모델 모양별 특화 회로 (fixed_circuit.h, nullptr이면 모두 일반 경로)
+};
+
+// --- 배치 추론 ---
+// 환자 목록을 암호화 → W*x + b (MLP 모델은 은닉층 → 출력층) → sigmoid 근사 → 복호화하여 환자별 점수를 돌려준다.
+// 슬롯 배치와 모델 모양은 setup.circuit을 따른다 (맞지 않으면 runtime_error).
+// snapshot의 모델이 여러 개면 환자마다 모델 수만큼 점수가 나온다 (scores[patient * 모델 수 + model]).
+// worker의 Evaluator/CKKSEncoder/메모리 풀만 사용하므로 여러 worker에서 동시에 호출해도 된다.
+// 첫 입력 암호문은 diagnostics에 넘겨진다 (샘플링되지 않으면 아무 일도 하지 않음)
+// 키, 모델, 평문 상수 캐시는 snapshot에서 가져온다.
+// trace가 있으면 encrypt / linear / activation / sigmoid / decrypt 단계 시간을 더한다.
+// 로지스틱 모델의 모양이 setup.fixed_circuits에 등록되어 있으면 W*x + b와 sigmoid는 특화 회로로 계산한다 (결과는 같음).
+std::vector<double> score_patients(const InferenceSetup& setup, WorkerContext& worker, const CacheSnapshot& snapshot,
+    const std::vector<std::vector<double>>& patients, RequestTrace* trace = nullptr);
+
+// 클라이언트가 암호화해 보낸 <id>.ckks 요청 (ckks_request.h 형식)
+// 암호문을 그대로 역직렬화하여 같은 연산에 넣는다 (서버 측 인코딩/암호화 없음).
+// 역직렬화까지 끝난 요청은 파이프라인의 ingest 단계에서 만들어 evaluate 단계로 넘긴다.
+struct EncryptedInput {
+    BatchLayout layout;
+    std::vector<seal::Ciphertext> chunks;
+    size_t patient_count = 0;
+    ResponseMode response_mode = ResponseMode::plain;
+};
+
+// 헤더를 검증하고 암호문을 pool에 역직렬화한다 (input_load 단계, Evaluator 불필요)
+// request_bytes는 매핑한 요청 파일 또는 소켓 수신 버퍼로, 중간 스트림 없이 바로 역직렬화한다.
+EncryptedInput load_encrypted_request(const InferenceSetup& setup, const CacheSnapshot& snapshot,
+    std::string_view request_bytes, const seal::MemoryPoolHandle& pool, RequestTrace* trace = nullptr);
+
+// plain 응답: 복호화한 점수 (snapshot.keys.decryptor 필요, input.chunks는 연산 중에 바뀜)
+std::vector<double> score_encrypted_input(const InferenceSetup& setup, WorkerContext& worker,
+    const CacheSnapshot& snapshot, EncryptedInput& input, RequestTrace* trace = nullptr);
+
+// encrypted 응답: 복호화하지 않은 결과 암호문 (ciphertexts[chunk * 모델 수 + model], compact_result_inplace 적용됨)
+std::vector<seal::Ciphertext> evaluate_encrypted_input(const InferenceSetup& setup, WorkerContext& worker,
+    const CacheSnapshot& snapshot, EncryptedInput& input, RequestTrace* trace = nullptr);
+
+// 응답 크기를 최소로: 다항식 2개로 relinearize (필요 시) + 마지막 레벨(결과용 소수 하나)로 mod switch
+void compact_result_inplace(const seal::SEALContext& context, WorkerContext& worker, const seal::RelinKeys& relin_keys,
+    seal::Ciphertext& result);
+
+// <id>.cresp 파일 / encrypted_response 프레임 내용 (ckks_request.h 형식, 암호문은 zstd 압축)
+void save_encrypted_response(std::ostream& out, const ModelSet& models, size_t patient_count,
+    const std::vector<seal::Ciphertext>& results);
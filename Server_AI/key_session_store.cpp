@@ -0,0 +1,192 @@
+﻿#include "key_session_store.h"
+#include <chrono>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+
+using namespace std;
+using namespace seal;
+namespace fs = std::filesystem;
+
+// --- 역직렬화된 키의 메모리 크기 (RNS 계수 uint64_t 기준, 객체 머리 부분은 무시) ---
+static size_t ciphertext_bytes(const Ciphertext& ct) {
+    return ct.size() * ct.poly_modulus_degree() * ct.coeff_modulus_size() * sizeof(uint64_t);
+}
+
+// RelinKeys / GaloisKeys: 키 하나마다 분해 수만큼의 PublicKey (암호문)
+static size_t kswitch_bytes(const KSwitchKeys& keys) {
+    size_t bytes = 0;
+    for (const auto& key : keys.data()) {
+        for (const PublicKey& part : key) bytes += ciphertext_bytes(part.data());
+    }
+    return bytes;
+}
+
+KeySessionStore::KeySessionStore(const SEALContext& context, fs::path keys_dir, size_t budget_bytes)
+    : context_(context), keys_dir_(move(keys_dir)), budget_bytes_(budget_bytes) {
+    stats_.budget_bytes = budget_bytes;
+}
+
+bool KeySessionStore::acquire(const string& key_id, KeySet& keys, KeySessionLoad* load) {
+    if (!valid_key_id(key_id)) throw runtime_error("Invalid key ID: " + key_id);
+    fs::path dir = keys_dir_ / key_id;
+    bool files_present = fs::exists(dir / "pub_key.dat") && fs::exists(dir / "relin_keys.dat")
+        && fs::exists(dir / "galois_keys.dat");
+
+    // 세션을 찾거나 만들고 LRU 맨 앞으로
+    shared_ptr<Session> session;
+    {
+        lock_guard<mutex> lock(mutex_);
+        auto it = sessions_.find(key_id);
+        if (!files_present) {
+            // 병원이 키를 지웠으면 들고 있던 세션도 버린다
+            if (it != sessions_.end()) {
+                Session& gone = *it->second;
+                gone.evicted = true;
+                bytes_ -= gone.bytes;
+                lru_.erase(gone.lru_position);
+                sessions_.erase(it);
+            }
+            return false;
+        }
+        if (it == sessions_.end()) {
+            session = make_shared<Session>();
+            session->key_id = key_id;
+            lru_.push_front(session.get());
+            session->lru_position = lru_.begin();
+            sessions_.emplace(key_id, session);
+        }
+        else {
+            session = it->second;
+            lru_.splice(lru_.begin(), lru_, session->lru_position);
+        }
+    }
+
+    KeySessionLoad result;
+    bool was_loaded = false;
+    {
+        lock_guard<mutex> session_lock(session->load_mutex);
+        was_loaded = session->keys.galois_keys != nullptr;
+        try {
+            // 클라이언트는 rename으로 키 파일을 교체하므로 mtime/크기가 바뀌면 키가 바뀐 것 (키 회전)
+            bool changed = !was_loaded;
+            if (!changed) {
+                changed = stamp_changed(dir / "pub_key.dat", session->pk_stamp)
+                    || stamp_changed(dir / "relin_keys.dat", session->rk_stamp)
+                    || stamp_changed(dir / "galois_keys.dat", session->gk_stamp);
+                fs::path sk_path = dir / "secret_key.dat";
+                if (!changed) changed = fs::exists(sk_path) ? stamp_changed(sk_path, session->sk_stamp) : session->sk_stamp.valid;
+            }
+            if (changed) load_session_locked(*session, result);
+        }
+        catch (...) {
+            // 다음 요청에서 다시 읽도록 stamp를 무효화
+            session->pk_stamp = session->sk_stamp = session->rk_stamp = session->gk_stamp = FileStamp();
+            if (!was_loaded) {
+                lock_guard<mutex> lock(mutex_);
+                if (!session->evicted) {
+                    session->evicted = true;
+                    lru_.erase(session->lru_position);
+                    sessions_.erase(key_id);
+                }
+            }
+            throw;
+        }
+        keys = session->keys;
+    }
+
+    lock_guard<mutex> lock(mutex_);
+    if (result.loaded) {
+        (was_loaded ? stats_.reloads : stats_.misses)++;
+        stats_.total_load_ms += result.load_ms;
+        // 로딩 중에 내보내진 세션은 이 요청에만 쓰고 합계에 넣지 않는다
+        if (!session->evicted) {
+            bytes_ = bytes_ - session->bytes + result.bytes;
+            session->bytes = result.bytes;
+            evict_locked(session.get());
+        }
+    }
+    else {
+        stats_.hits++;
+        result.bytes = session->bytes;
+    }
+    if (load) *load = result;
+    return true;
+}
+
+size_t KeySessionStore::load_session_locked(Session& session, KeySessionLoad& load) {
+    auto start = chrono::steady_clock::now();
+    fs::path dir = keys_dir_ / session.key_id;
+
+    // stamp는 읽기 전에 찍는다: 읽는 도중 파일이 바뀌면 다음 요청에서 다시 읽게 됨
+    FileStamp pk_stamp, sk_stamp, rk_stamp, gk_stamp;
+    auto load_key = [&](const fs::path& path, FileStamp& stamp, auto& key) {
+        stamp_changed(path, stamp);
+        load.blobs.add(load_mapped(context_, path, key));
+    };
+
+    KeySet keys;
+    size_t bytes = 0;
+
+    PublicKey public_key;
+    load_key(dir / "pub_key.dat", pk_stamp, public_key);
+    keys.encryptor = make_shared<const Encryptor>(context_, public_key);
+    bytes += ciphertext_bytes(public_key.data());
+
+    // 비밀키는 plain 응답을 받는 병원만 올린다
+    fs::path sk_path = dir / "secret_key.dat";
+    if (fs::exists(sk_path)) {
+        SecretKey secret_key;
+        load_key(sk_path, sk_stamp, secret_key);
+        keys.decryptor = make_shared<Decryptor>(context_, secret_key);
+        bytes += secret_key.data().coeff_count() * sizeof(uint64_t);
+    }
+
+    auto relin_keys = make_shared<RelinKeys>();
+    load_key(dir / "relin_keys.dat", rk_stamp, *relin_keys);
+    bytes += kswitch_bytes(*relin_keys);
+    keys.relin_keys = move(relin_keys);
+
+    auto galois_keys = make_shared<GaloisKeys>();
+    load_key(dir / "galois_keys.dat", gk_stamp, *galois_keys);
+    bytes += kswitch_bytes(*galois_keys);
+    keys.galois_keys = move(galois_keys);
+
+    session.keys = move(keys);
+    session.pk_stamp = pk_stamp;
+    session.sk_stamp = sk_stamp;
+    session.rk_stamp = rk_stamp;
+    session.gk_stamp = gk_stamp;
+
+    load.loaded = true;
+    load.bytes = bytes;
+    load.load_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    return bytes;
+}
+
+void KeySessionStore::evict_locked(const Session* keep) {
+    // 뒤(가장 오래 쓰지 않은 세션)부터. 아직 처음 로딩 중인 세션(bytes 0)은 내보내도 줄어드는 양이 없으므로 건너뜀
+    auto it = lru_.end();
+    while (bytes_ > budget_bytes_ && it != lru_.begin()) {
+        --it;
+        Session* victim = *it;
+        if (victim == keep || victim->bytes == 0) continue;
+
+        it = lru_.erase(it);
+        victim->evicted = true;
+        bytes_ -= victim->bytes;
+        victim->bytes = 0;
+        stats_.evictions++;
+        // 맵에서 지우면 Session이 사라질 수 있으므로 이름을 먼저 복사 (처리 중인 요청의 KeySet은 그대로 유효)
+        string key_id = victim->key_id;
+        sessions_.erase(key_id);
+    }
+}
+
+KeySessionStats KeySessionStore::stats() const {
+    lock_guard<mutex> lock(mutex_);
+    KeySessionStats stats = stats_;
+    stats.sessions = sessions_.size();
+    stats.bytes = bytes_;
+    return stats;
+}
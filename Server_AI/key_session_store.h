@@ -0,0 +1,90 @@
+﻿#pragma once
+#include "seal/seal.h"
+#include "model_cache.h"
+#include "../Common/blob_loader.h"
+#include "../Common/ckks_request.h"
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// --- 병원(테넌트)별 키 세션 저장소 ---
+// ServerCache는 Shared_Channel의 키 한 벌만 들고 있어서 다른 병원이 키를 올리면 덮어쓴다.
+// 요청 헤더에 key_id가 있으면 keys_dir/<key_id>/의 키를 세션으로 읽어 두고 같은 병원의 다음 요청에 재사용한다.
+//
+//   keys_dir/<key_id>/pub_key.dat, relin_keys.dat, galois_keys.dat (secret_key.dat는 plain 응답용, 선택)
+//
+// 역직렬화된 키(Encryptor, RelinKeys, GaloisKeys, Decryptor)의 메모리 크기를 세션마다 계산해 합계가 예산을 넘으면
+// 가장 오래 쓰지 않은 세션부터 내보낸다 (LRU). 내보낸 세션은 다음 요청에서 디스크에서 다시 읽는다.
+// 인코딩된 평문 상수(가중치, bias, 다항식 계수)는 키와 무관하므로 세션마다 두지 않고 모델의 PlaintextCache를 함께 쓴다.
+//
+// 처리 중인 요청은 KeySet의 shared_ptr을 들고 있으므로, 내보낸 세션의 메모리는 그 요청이 끝난 뒤에 풀린다
+// (그동안 실제 사용량이 예산을 잠시 넘을 수 있음). 세션 하나가 예산보다 크면 그 세션만 남긴다.
+// 여러 스레드가 동시에 acquire해도 안전하며, 서로 다른 세션의 로딩은 병렬로 진행된다.
+//
+// key_id는 요청 헤더에 클라이언트가 적는 값일 뿐이므로, 소켓 연결은 먼저 세션의 비밀키를 가졌음을 보여야 한다
+// (key_session / key_challenge 프레임, socket_server.h). Shared_Channel 파일 교환은 keys/<key_id>/ 디렉터리
+// 권한으로 보호한다 (병원마다 OS 그룹을 나누고 서버 계정만 모든 그룹에 넣음, readme.md).
+
+struct KeySessionStats {
+    size_t hits = 0;          // 메모리에 있고 키 파일이 그대로여서 재사용
+    size_t misses = 0;        // 메모리에 없어 디스크에서 로드 (처음 또는 내보낸 뒤)
+    size_t reloads = 0;       // 메모리에 있었지만 키 파일이 바뀌어 다시 로드 (클라이언트 키 회전)
+    size_t evictions = 0;     // 예산 때문에 내보낸 세션 수
+    size_t sessions = 0;      // 메모리에 있는 세션 수
+    size_t bytes = 0;         // 메모리에 있는 세션 키의 크기 합
+    size_t budget_bytes = 0;
+    double total_load_ms = 0.0;
+};
+
+// acquire 한 번의 결과 (요청 trace/로그용)
+struct KeySessionLoad {
+    bool loaded = false;      // 디스크에서 읽었는지 (miss 또는 reload)
+    size_t bytes = 0;         // 이 세션 키의 메모리 크기
+    double load_ms = 0.0;
+    BlobLoadStats blobs;
+};
+
+class KeySessionStore {
+public:
+    KeySessionStore(const seal::SEALContext& context, std::filesystem::path keys_dir, size_t budget_bytes);
+
+    KeySessionStore(const KeySessionStore&) = delete;
+    KeySessionStore& operator=(const KeySessionStore&) = delete;
+
+    // key_id 세션의 키를 keys에 채운다. 키 파일이 없으면 false, key_id가 잘못되었거나 (valid_key_id) 키 형식 오류는 runtime_error
+    bool acquire(const std::string& key_id, KeySet& keys, KeySessionLoad* load = nullptr);
+
+    KeySessionStats stats() const;
+    const std::filesystem::path& dir() const { return keys_dir_; }
+
+private:
+    struct Session {
+        std::string key_id;
+        std::mutex load_mutex;        // 같은 세션을 두 스레드가 동시에 읽지 않도록 (아래 필드 보호)
+        KeySet keys;
+        FileStamp pk_stamp, sk_stamp, rk_stamp, gk_stamp;
+
+        // 아래는 store의 mutex_로 보호
+        size_t bytes = 0;
+        bool evicted = false;
+        std::list<Session*>::iterator lru_position;
+    };
+
+    // 디스크에서 세션 키를 읽는다 (session.load_mutex를 잡은 상태에서 호출)
+    size_t load_session_locked(Session& session, KeySessionLoad& load);
+    // 예산을 넘으면 keep을 제외하고 LRU 끝부터 내보낸다 (mutex_를 잡은 상태에서 호출)
+    void evict_locked(const Session* keep);
+
+    const seal::SEALContext& context_;
+    std::filesystem::path keys_dir_;
+    size_t budget_bytes_;
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, std::shared_ptr<Session>> sessions_;
+    std::list<Session*> lru_;         // 앞쪽이 가장 최근에 쓴 세션
+    size_t bytes_ = 0;
+    KeySessionStats stats_;
+};
@@ -0,0 +1,243 @@
+﻿#include "metrics.h"
+#include "key_session_store.h"
+#include "server_log.h"
+#include "../Common/channel.h"
+#include <exception>
+#include <fstream>
+#include <sstream>
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+using namespace std;
+namespace fs = std::filesystem;
+
+const char* stage_name(Stage stage) {
+    switch (stage) {
+    case Stage::key_load: return "key_load";
+    case Stage::model_load: return "model_load";
+    case Stage::input_load: return "input_load";
+    case Stage::encrypt: return "encrypt";
+    case Stage::linear: return "linear";
+    case Stage::activation: return "activation";
+    case Stage::sigmoid: return "sigmoid";
+    case Stage::decrypt: return "decrypt";
+    case Stage::compact: return "compact";
+    case Stage::response_write: return "response_write";
+    case Stage::request: return "request";
+    case Stage::count: break;
+    }
+    return "unknown";
+}
+
+#if HE_METRICS
+
+// 프로세스 RSS (Linux: /proc/self/statm의 두 번째 값 x 페이지 크기, 그 밖의 플랫폼은 0 = 내보내지 않음)
+static uint64_t resident_bytes() {
+#ifdef __linux__
+    ifstream statm("/proc/self/statm");
+    uint64_t total_pages = 0, resident_pages = 0;
+    if (statm >> total_pages >> resident_pages) return resident_pages * static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+#endif
+    return 0;
+}
+
+void RequestTrace::add(Stage stage, double elapsed_seconds) {
+    size_t index = static_cast<size_t>(stage);
+    seconds[index] += elapsed_seconds;
+    recorded[index] = true;
+}
+
+string RequestTrace::summary() const {
+    ostringstream out;
+    out.precision(3);
+    out << fixed;
+    for (size_t i = 0; i < stage_count; i++) {
+        if (!recorded[i]) continue;
+        if (out.tellp() > 0) out << ", ";
+        out << stage_name(static_cast<Stage>(i)) << " " << seconds[i] * 1000.0 << " ms";
+    }
+    if (blob_bytes_in_place > 0 || blob_bytes_copied > 0) {
+        out << "; blobs " << blob_bytes_in_place << " bytes in place, " << blob_bytes_copied << " bytes copied";
+    }
+    if (pool_bytes_reserved > 0) {
+        out << "; pool +" << pool_bytes_grown << " bytes (" << pool_bytes_reserved << " bytes reserved)";
+    }
+    return out.str();
+}
+
+void LatencyHistogram::observe(double seconds) {
+    size_t bucket = 0;
+    while (bucket < bounds.size() && seconds > bounds[bucket]) bucket++;
+    buckets_[bucket].fetch_add(1, memory_order_relaxed);
+    sum_ns_.fetch_add(static_cast<uint64_t>(seconds * 1e9), memory_order_relaxed);
+    count_.fetch_add(1, memory_order_relaxed);
+}
+
+double LatencyHistogram::quantile(double q) const {
+    // 관측 도중 읽으면 버킷 합과 count_가 조금 어긋날 수 있으므로 버킷 합을 기준으로 함
+    array<uint64_t, bounds.size() + 1> counts;
+    uint64_t total = 0;
+    for (size_t i = 0; i < counts.size(); i++) {
+        counts[i] = buckets_[i].load(memory_order_relaxed);
+        total += counts[i];
+    }
+    if (total == 0) return 0.0;
+
+    double target = q * static_cast<double>(total);
+    uint64_t cumulative = 0;
+    for (size_t i = 0; i < counts.size(); i++) {
+        if (counts[i] == 0 || cumulative + counts[i] < target) {
+            cumulative += counts[i];
+            continue;
+        }
+        if (i == bounds.size()) return bounds.back(); // +Inf 버킷: 마지막 경계로 보고
+        double lower = (i == 0) ? 0.0 : bounds[i - 1];
+        double fraction = (target - static_cast<double>(cumulative)) / static_cast<double>(counts[i]);
+        return lower + (bounds[i] - lower) * fraction;
+    }
+    return bounds.back();
+}
+
+void LatencyHistogram::write(ostream& out, const string& name, const string& labels) const {
+    uint64_t cumulative = 0;
+    for (size_t i = 0; i < buckets_.size(); i++) {
+        cumulative += buckets_[i].load(memory_order_relaxed);
+        out << name << "_bucket{" << labels << ",le=\"";
+        if (i < bounds.size()) out << bounds[i];
+        else out << "+Inf";
+        out << "\"} " << cumulative << "\n";
+    }
+    out << name << "_sum{" << labels << "} " << static_cast<double>(sum_ns_.load(memory_order_relaxed)) / 1e9 << "\n";
+    out << name << "_count{" << labels << "} " << cumulative << "\n";
+}
+
+void ServerMetrics::record(const RequestTrace& trace, bool succeeded, size_t patient_count) {
+    for (size_t i = 0; i < stage_count; i++) {
+        if (trace.recorded[i]) stages_[i].observe(trace.seconds[i]);
+    }
+    (succeeded ? requests_succeeded_ : requests_failed_).fetch_add(1, memory_order_relaxed);
+    if (succeeded) patients_scored_.fetch_add(patient_count, memory_order_relaxed);
+    blob_bytes_in_place_.fetch_add(trace.blob_bytes_in_place, memory_order_relaxed);
+    blob_bytes_copied_.fetch_add(trace.blob_bytes_copied, memory_order_relaxed);
+    if (trace.pool_bytes_grown > 0) {
+        pool_bytes_grown_.fetch_add(trace.pool_bytes_grown, memory_order_relaxed);
+        requests_grew_pool_.fetch_add(1, memory_order_relaxed);
+    }
+    uint64_t peak = pool_bytes_peak_.load(memory_order_relaxed);
+    while (trace.pool_bytes_reserved > peak
+        && !pool_bytes_peak_.compare_exchange_weak(peak, trace.pool_bytes_reserved, memory_order_relaxed)) {}
+}
+
+void ServerMetrics::write_prometheus(ostream& out) const {
+    out.precision(9);
+
+    out << "# HELP he_requests_total Requests handled by the server.\n";
+    out << "# TYPE he_requests_total counter\n";
+    out << "he_requests_total{result=\"success\"} " << requests_succeeded_.load() << "\n";
+    out << "he_requests_total{result=\"error\"} " << requests_failed_.load() << "\n";
+
+    out << "# HELP he_patients_scored_total Patients scored in successful requests.\n";
+    out << "# TYPE he_patients_scored_total counter\n";
+    out << "he_patients_scored_total " << patients_scored_.load() << "\n";
+
+    out << "# HELP he_blob_bytes_total Key and ciphertext bytes deserialized, by whether they were copied first.\n";
+    out << "# TYPE he_blob_bytes_total counter\n";
+    out << "he_blob_bytes_total{mode=\"in_place\"} " << blob_bytes_in_place_.load() << "\n";
+    out << "he_blob_bytes_total{mode=\"copied\"} " << blob_bytes_copied_.load() << "\n";
+
+    out << "# HELP he_pool_growth_bytes_total Bytes the per-thread memory pools had to reserve while serving requests.\n";
+    out << "# TYPE he_pool_growth_bytes_total counter\n";
+    out << "he_pool_growth_bytes_total " << pool_bytes_grown_.load() << "\n";
+
+    out << "# HELP he_pool_growth_requests_total Requests that grew a memory pool (flat once the pools are warm).\n";
+    out << "# TYPE he_pool_growth_requests_total counter\n";
+    out << "he_pool_growth_requests_total " << requests_grew_pool_.load() << "\n";
+
+    out << "# HELP he_pool_reserved_peak_bytes Largest memory pool seen at the end of a request (peak working set of one worker).\n";
+    out << "# TYPE he_pool_reserved_peak_bytes gauge\n";
+    out << "he_pool_reserved_peak_bytes " << pool_bytes_peak_.load() << "\n";
+
+    uint64_t resident = resident_bytes();
+    if (resident > 0) {
+        out << "# HELP he_process_resident_bytes Resident set size of the server process.\n";
+        out << "# TYPE he_process_resident_bytes gauge\n";
+        out << "he_process_resident_bytes " << resident << "\n";
+    }
+
+    out << "# HELP he_stage_duration_seconds Time spent in each request stage.\n";
+    out << "# TYPE he_stage_duration_seconds histogram\n";
+    for (size_t i = 0; i < stage_count; i++) {
+        stages_[i].write(out, "he_stage_duration_seconds", string("stage=\"") + stage_name(static_cast<Stage>(i)) + "\"");
+    }
+
+    // 대시보드용 p50/p95/p99 (서버 시작 이후 전체, 버킷 보간 추정값)
+    out << "# HELP he_stage_duration_quantile_seconds Estimated stage latency quantiles since server start.\n";
+    out << "# TYPE he_stage_duration_quantile_seconds gauge\n";
+    for (size_t i = 0; i < stage_count; i++) {
+        for (const char* q : { "0.5", "0.95", "0.99" }) {
+            out << "he_stage_duration_quantile_seconds{stage=\"" << stage_name(static_cast<Stage>(i))
+                << "\",quantile=\"" << q << "\"} " << stages_[i].quantile(stod(q)) << "\n";
+        }
+    }
+
+    if (!key_sessions_) return;
+    KeySessionStats sessions = key_sessions_->stats();
+    out << "# HELP he_key_session_lookups_total Key session lookups by outcome (reload: key files changed).\n";
+    out << "# TYPE he_key_session_lookups_total counter\n";
+    out << "he_key_session_lookups_total{result=\"hit\"} " << sessions.hits << "\n";
+    out << "he_key_session_lookups_total{result=\"miss\"} " << sessions.misses << "\n";
+    out << "he_key_session_lookups_total{result=\"reload\"} " << sessions.reloads << "\n";
+
+    out << "# HELP he_key_session_evictions_total Key sessions evicted to stay within the memory budget.\n";
+    out << "# TYPE he_key_session_evictions_total counter\n";
+    out << "he_key_session_evictions_total " << sessions.evictions << "\n";
+
+    out << "# HELP he_key_session_load_seconds_total Time spent loading key sessions from disk.\n";
+    out << "# TYPE he_key_session_load_seconds_total counter\n";
+    out << "he_key_session_load_seconds_total " << sessions.total_load_ms / 1000.0 << "\n";
+
+    out << "# HELP he_key_sessions Key sessions resident in memory.\n";
+    out << "# TYPE he_key_sessions gauge\n";
+    out << "he_key_sessions " << sessions.sessions << "\n";
+
+    out << "# HELP he_key_session_bytes Memory held by resident key sessions, and the configured budget.\n";
+    out << "# TYPE he_key_session_bytes gauge\n";
+    out << "he_key_session_bytes{kind=\"resident\"} " << sessions.bytes << "\n";
+    out << "he_key_session_bytes{kind=\"budget\"} " << sessions.budget_bytes << "\n";
+}
+
+MetricsExporter::MetricsExporter(const ServerMetrics& metrics, const fs::path& path, chrono::seconds interval)
+    : metrics_(metrics), path_(path), interval_(interval) {
+    thread_ = thread(&MetricsExporter::run, this);
+}
+
+MetricsExporter::~MetricsExporter() {
+    {
+        lock_guard<mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_one();
+    thread_.join();
+}
+
+void MetricsExporter::run() {
+    while (true) {
+        export_now();
+        unique_lock<mutex> lock(mutex_);
+        if (cv_.wait_for(lock, interval_, [this] { return stopping_; })) break;
+    }
+    export_now();
+}
+
+void MetricsExporter::export_now() const {
+    try {
+        // scraper가 쓰다 만 파일을 읽지 않도록 rename으로 교체
+        write_file_atomic(path_, [&](ostream& out) { metrics_.write_prometheus(out); });
+    }
+    catch (const exception& e) {
+        LogLine() << "[Server] Error writing metrics: " << e.what() << "\n";
+    }
+}
+
+#endif
@@ -0,0 +1,182 @@
+﻿#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+
+// --- 단계별 지연 시간 계측 ---
+// 요청 하나의 단계별 시간은 RequestTrace에 모으고 (worker 스레드 하나만 씀, 공유 상태 없음),
+// 요청이 끝날 때 ServerMetrics::record로 한 번에 히스토그램에 반영한다 (atomic 카운터만 사용, lock 없음).
+// HE_METRICS=0으로 빌드하면 아래 타입들이 빈 inline 함수가 되어 계측 코드가 완전히 빠진다.
+//   (CMake: -DENABLE_SERVER_METRICS=OFF)
+#ifndef HE_METRICS
+#define HE_METRICS 1
+#endif
+
+class KeySessionStore;
+
+enum class Stage : size_t {
+    key_load,        // 키 파일 역직렬화 (캐시가 다시 읽은 경우만)
+    model_load,      // weights.txt / bias.txt (캐시가 다시 읽은 경우만)
+    input_load,      // 요청 파일 파싱 또는 암호문 역직렬화
+    encrypt,         // 서버 측 인코딩 + 암호화 (.req 요청만)
+    linear,          // W*x, 회전-합산, bias (MLP는 두 밀집층)
+    activation,      // MLP 은닉층 활성화 다항식
+    sigmoid,         // sigmoid 근사 다항식
+    decrypt,         // 복호화 + 디코딩 + 점수 추출
+    compact,         // 결과 암호문을 마지막 레벨로 mod switch (암호문 응답만)
+    response_write,  // .resp 게시
+    request,         // 요청 전체 (소켓: worker 처리 시간, Shared_Channel: 파이프라인 진입부터 응답까지)
+    count
+};
+
+constexpr size_t stage_count = static_cast<size_t>(Stage::count);
+
+const char* stage_name(Stage stage);
+
+#if HE_METRICS
+
+// 요청 하나의 단계별 누적 시간 (chunk가 여러 개면 합산)
+struct RequestTrace {
+    std::array<double, stage_count> seconds{};
+    std::array<bool, stage_count> recorded{};
+    uint64_t blob_bytes_in_place = 0;  // 키/암호문 blob을 mmap 또는 수신 버퍼에서 바로 역직렬화한 바이트
+    uint64_t blob_bytes_copied = 0;    // 중간 버퍼로 복사한 바이트
+    // 스레드별 메모리 풀 (worker_pool.h): 이 요청 동안 풀이 새로 확보한 바이트와, 요청이 끝났을 때 풀 크기.
+    // 풀은 해제된 블록을 재사용하므로 정상 상태에서는 grown이 0이고, reserved가 worker의 최대 작업량 (최고 수위)
+    uint64_t pool_bytes_grown = 0;
+    uint64_t pool_bytes_reserved = 0;
+
+    void add(Stage stage, double elapsed_seconds);
+    void add_blob_bytes(uint64_t in_place, uint64_t copied) {
+        blob_bytes_in_place += in_place;
+        blob_bytes_copied += copied;
+    }
+    // before/after: 단계 전후의 풀 크기 (MemoryPoolHandle::alloc_byte_count)
+    void add_pool_bytes(uint64_t before, uint64_t after) {
+        pool_bytes_grown += after > before ? after - before : 0;
+        pool_bytes_reserved = pool_bytes_reserved > after ? pool_bytes_reserved : after;
+    }
+    // 로그용: "input_load 0.8 ms, linear 12.1 ms, ..."
+    std::string summary() const;
+};
+
+// 생성부터 stop(또는 소멸)까지의 시간을 trace에 더한다. trace가 nullptr이면 아무것도 하지 않음
+class StageTimer {
+public:
+    StageTimer(RequestTrace* trace, Stage stage)
+        : trace_(trace), stage_(stage), start_(std::chrono::steady_clock::now()) {}
+    ~StageTimer() { stop(); }
+
+    StageTimer(const StageTimer&) = delete;
+    StageTimer& operator=(const StageTimer&) = delete;
+
+    void stop() {
+        if (!trace_) return;
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start_;
+        trace_->add(stage_, elapsed.count());
+        trace_ = nullptr;
+    }
+
+private:
+    RequestTrace* trace_;
+    Stage stage_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+// 고정 버킷 (100us ~ 10s, 로그 간격) 히스토그램. observe는 atomic 증가 세 번
+class LatencyHistogram {
+public:
+    static constexpr std::array<double, 16> bounds = {
+        0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025,
+        0.05, 0.1, 0.25, 0.5, 1.0, 2.5, 5.0, 10.0
+    };
+
+    void observe(double seconds);
+    uint64_t count() const { return count_; }
+    // 버킷 안에서 선형 보간한 분위수 추정값 (관측이 없으면 0)
+    double quantile(double q) const;
+    // Prometheus histogram 형식 (_bucket / _sum / _count)
+    void write(std::ostream& out, const std::string& name, const std::string& labels) const;
+
+private:
+    std::array<std::atomic<uint64_t>, bounds.size() + 1> buckets_{}; // 마지막은 +Inf
+    std::atomic<uint64_t> count_{ 0 };
+    std::atomic<uint64_t> sum_ns_{ 0 };
+};
+
+// 서버 전체 누적 지표 (모든 worker가 공유)
+class ServerMetrics {
+public:
+    void record(const RequestTrace& trace, bool succeeded, size_t patient_count);
+    // Prometheus text exposition format
+    void write_prometheus(std::ostream& out) const;
+
+    // 병원별 키 세션 저장소의 hit/miss/eviction과 상주 크기를 함께 내보낸다 (store가 더 오래 살아 있어야 함)
+    void attach_key_sessions(const KeySessionStore* store) { key_sessions_ = store; }
+
+private:
+    std::array<LatencyHistogram, stage_count> stages_;
+    std::atomic<uint64_t> requests_succeeded_{ 0 };
+    std::atomic<uint64_t> requests_failed_{ 0 };
+    std::atomic<uint64_t> patients_scored_{ 0 };
+    std::atomic<uint64_t> blob_bytes_in_place_{ 0 };
+    std::atomic<uint64_t> blob_bytes_copied_{ 0 };
+    std::atomic<uint64_t> pool_bytes_grown_{ 0 };
+    std::atomic<uint64_t> requests_grew_pool_{ 0 };
+    std::atomic<uint64_t> pool_bytes_peak_{ 0 };
+    const KeySessionStore* key_sessions_ = nullptr;
+};
+
+// interval마다 (그리고 종료 시) path에 지표 파일을 원자적으로 게시한다.
+// node_exporter의 textfile collector 디렉터리를 가리키면 그대로 수집된다.
+class MetricsExporter {
+public:
+    MetricsExporter(const ServerMetrics& metrics, const std::filesystem::path& path, std::chrono::seconds interval);
+    ~MetricsExporter();
+
+    MetricsExporter(const MetricsExporter&) = delete;
+    MetricsExporter& operator=(const MetricsExporter&) = delete;
+
+private:
+    void run();
+    void export_now() const;
+
+    const ServerMetrics& metrics_;
+    std::filesystem::path path_;
+    std::chrono::seconds interval_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stopping_ = false;
+    std::thread thread_;
+};
+
+#else
+
+struct RequestTrace {
+    void add(Stage, double) {}
+    void add_blob_bytes(uint64_t, uint64_t) {}
+    void add_pool_bytes(uint64_t, uint64_t) {}
+    std::string summary() const { return {}; }
+};
+
+class StageTimer {
+public:
+    StageTimer(RequestTrace*, Stage) {}
+    void stop() {}
+};
+
+class ServerMetrics {
+public:
+    void record(const RequestTrace&, bool, size_t) {}
+    void attach_key_sessions(const KeySessionStore*) {}
+};
+
+#endif
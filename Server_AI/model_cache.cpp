@@ -0,0 +1,330 @@
+﻿#include "model_cache.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+using namespace seal;
+namespace fs = std::filesystem;
+
+LogisticModel load_model(const fs::path& weights_path, const fs::path& bias_path) {
+    LogisticModel model;
+
+    // Weights 읽기
+    ifstream w_file(weights_path);
+    if (!w_file.is_open()) throw runtime_error("weights.txt not found!");
+    double temp;
+    while (w_file >> temp) model.weights.push_back(temp);
+    w_file.close();
+
+    // Bias 읽기
+    ifstream b_file(bias_path);
+    if (!b_file.is_open()) throw runtime_error("bias.txt not found!");
+    b_file >> model.bias;
+    b_file.close();
+
+    return model;
+}
+
+LogisticModel load_mlp_model(const fs::path& path) {
+    ifstream in(path);
+    if (!in.is_open()) throw runtime_error("MLP model file not found: " + path.string());
+
+    // 주석을 지운 토큰 스트림
+    stringstream tokens;
+    string line;
+    while (getline(in, line)) tokens << line.substr(0, line.find('#')) << "\n";
+
+    auto read_values = [&](const string& section, size_t count) {
+        vector<double> values(count);
+        for (double& value : values) {
+            if (!(tokens >> value)) throw runtime_error(path.string() + ": not enough values in " + section);
+        }
+        return values;
+    };
+
+    LogisticModel model;
+    HiddenLayer hidden;
+    size_t input_count = 0, hidden_count = 0;
+    bool has_output_bias = false;
+    string key;
+    while (tokens >> key) {
+        if (key == "input") tokens >> input_count;
+        else if (key == "hidden") tokens >> hidden_count;
+        else if (key == "feature") {
+            FeatureRange feature;
+            if (!(tokens >> feature.name >> feature.min >> feature.max) || feature.max <= feature.min) {
+                throw runtime_error(path.string() + ": invalid feature range");
+            }
+            model.features.push_back(move(feature));
+        }
+        else if (key == "activation") {
+            // 한 줄의 계수 전체
+            getline(tokens, line);
+            istringstream coeff_stream(line);
+            double coeff;
+            while (coeff_stream >> coeff) hidden.activation.push_back(coeff);
+        }
+        else if (input_count == 0 || hidden_count == 0) {
+            throw runtime_error(path.string() + ": input and hidden sizes must come before " + key);
+        }
+        else if (key == "hidden_weights") {
+            for (size_t row = 0; row < hidden_count; row++) {
+                hidden.weights.push_back(read_values(key, input_count));
+            }
+        }
+        else if (key == "hidden_bias") hidden.bias = read_values(key, hidden_count);
+        else if (key == "output_weights") model.weights = read_values(key, hidden_count);
+        else if (key == "output_bias") {
+            model.bias = read_values(key, 1)[0];
+            has_output_bias = true;
+        }
+        else throw runtime_error(path.string() + ": unknown section " + key);
+    }
+
+    if (hidden.weights.size() != hidden_count || hidden.bias.size() != hidden_count
+        || model.weights.size() != hidden_count || !has_output_bias) {
+        throw runtime_error(path.string() + ": missing MLP layer weights");
+    }
+    if (hidden.activation.empty()) throw runtime_error(path.string() + ": missing activation coefficients");
+    if (!model.features.empty() && model.features.size() != input_count) {
+        throw runtime_error(path.string() + ": feature list does not match input size");
+    }
+    model.hidden = move(hidden);
+    return model;
+}
+
+vector<string> ModelSet::names() const {
+    vector<string> result;
+    for (const LogisticModel& model : models) result.push_back(model.name);
+    return result;
+}
+
+struct ManifestEntry {
+    string name;
+    fs::path weights_path;  // MLP면 모델 파일
+    fs::path bias_path;     // MLP면 비어 있음
+    bool mlp = false;
+};
+
+// models.txt의 목록 (파일이 없으면 weights.txt / bias.txt 하나)
+static vector<ManifestEntry> read_manifest(const fs::path& model_dir) {
+    fs::path manifest_path = model_dir / "models.txt";
+    if (!fs::exists(manifest_path)) {
+        return { { "default", model_dir / "weights.txt", model_dir / "bias.txt" } };
+    }
+
+    ifstream in(manifest_path);
+    if (!in.is_open()) throw runtime_error("Failed to open " + manifest_path.string());
+
+    vector<ManifestEntry> entries;
+    string line;
+    while (getline(in, line)) {
+        line = line.substr(0, line.find('#'));
+        istringstream line_stream(line);
+        ManifestEntry entry;
+        string weights_file, bias_file;
+        if (!(line_stream >> entry.name)) continue;
+        if (!(line_stream >> weights_file >> bias_file)) {
+            throw runtime_error("models.txt: expected \"<name> <weights> <bias>\" or \"<name> mlp <file>\" for model "
+                + entry.name);
+        }
+        entry.mlp = weights_file == "mlp";
+        entry.weights_path = model_dir / (entry.mlp ? bias_file : weights_file);
+        if (!entry.mlp) entry.bias_path = model_dir / bias_file;
+        entries.push_back(move(entry));
+    }
+    return entries;
+}
+
+ModelSet load_model_set(const fs::path& model_dir) {
+    ModelSet set;
+    for (const ManifestEntry& entry : read_manifest(model_dir)) {
+        for (const LogisticModel& loaded : set.models) {
+            if (loaded.name == entry.name) throw runtime_error("Duplicate model name: " + entry.name);
+        }
+        LogisticModel model = entry.mlp ? load_mlp_model(entry.weights_path) : load_model(entry.weights_path, entry.bias_path);
+        model.name = entry.name;
+        set.models.push_back(move(model));
+    }
+
+    if (set.models.empty()) throw runtime_error("No models listed in models.txt!");
+    for (const LogisticModel& model : set.models) {
+        if (model.input_count() == 0 || model.input_count() != set.feature_count()) {
+            throw runtime_error("Model " + model.name + " has " + to_string(model.input_count())
+                + " inputs, expected " + to_string(set.feature_count()));
+        }
+        if (model.hidden_count() != set.hidden_count()) {
+            throw runtime_error("Model " + model.name + " has " + to_string(model.hidden_count())
+                + " hidden units, expected " + to_string(set.hidden_count()));
+        }
+    }
+    return set;
+}
+
+vector<fs::path> model_set_files(const fs::path& model_dir) {
+    vector<fs::path> files;
+    for (const ManifestEntry& entry : read_manifest(model_dir)) {
+        files.push_back(entry.weights_path);
+        if (!entry.bias_path.empty()) files.push_back(entry.bias_path);
+    }
+    return files;
+}
+
+bool stamp_changed(const fs::path& path, FileStamp& stamp) {
+    FileStamp now;
+    now.mtime = fs::last_write_time(path);
+    now.size = fs::file_size(path);
+    now.valid = true;
+
+    if (stamp.valid && stamp.mtime == now.mtime && stamp.size == now.size) return false;
+    stamp = now;
+    return true;
+}
+
+ServerCache::ServerCache(const SEALContext& context, const fs::path& channel_dir, const fs::path& model_dir)
+    : context_(context),
+      pk_path_(channel_dir / "pub_key.dat"),
+      sk_path_(channel_dir / "secret_key.dat"),
+      rk_path_(channel_dir / "relin_keys.dat"),
+      gk_path_(channel_dir / "galois_keys.dat"),
+      model_dir_(model_dir),
+      manifest_path_(model_dir / "models.txt") {}
+
+bool ServerCache::keys_available() const {
+    // secret_key.dat는 선택 (plain 응답을 받는 클라이언트만 올림)
+    return fs::exists(pk_path_) && fs::exists(rk_path_) && fs::exists(gk_path_);
+}
+
+bool ServerCache::acquire(CacheSnapshot& snapshot) {
+    if (!keys_available()) return false;
+
+    lock_guard<mutex> lock(mutex_);
+    refresh_keys_locked();
+    refresh_model_locked();
+    snapshot.keys = keys_;
+    snapshot.models = models_;
+    snapshot.constants = constants_;
+    snapshot.stats = stats_;
+    return true;
+}
+
+void ServerCache::acquire_model(CacheSnapshot& snapshot) {
+    lock_guard<mutex> lock(mutex_);
+    refresh_model_locked();
+    snapshot.models = models_;
+    snapshot.constants = constants_;
+    snapshot.stats = stats_;
+    snapshot.stats.last_keys_reloaded = false;
+    snapshot.stats.last_key_blobs = BlobLoadStats();
+}
+
+CacheStats ServerCache::stats() const {
+    lock_guard<mutex> lock(mutex_);
+    return stats_;
+}
+
+void ServerCache::refresh_keys_locked() {
+    // --- 키: 바뀐 파일만 역직렬화, 관련 Encryptor/Decryptor만 재생성 ---
+    auto key_start = chrono::steady_clock::now();
+    bool any_key_loaded = false;
+    stats_.last_key_blobs = BlobLoadStats();
+
+    // 키 파일은 mmap하여 바이트 버퍼 load로 역직렬화 (iostream 버퍼 복사 없음)
+    auto load_key = [this](const fs::path& path, auto& key) {
+        stats_.last_key_blobs.add(load_mapped(context_, path, key));
+    };
+
+    // 로딩 중 실패하면 stamp를 무효화하여 다음 요청에서 다시 시도
+    auto reload = [](const fs::path& path, FileStamp& stamp, bool force, const auto& load) {
+        if (!stamp_changed(path, stamp) && !force) return false;
+        try {
+            load();
+        }
+        catch (...) {
+            stamp.valid = false;
+            throw;
+        }
+        return true;
+    };
+
+    any_key_loaded |= reload(pk_path_, pk_stamp_, !keys_.encryptor, [&] {
+        PublicKey public_key;
+        load_key(pk_path_, public_key);
+        keys_.encryptor = make_shared<const Encryptor>(context_, public_key);
+    });
+    if (fs::exists(sk_path_)) {
+        any_key_loaded |= reload(sk_path_, sk_stamp_, !keys_.decryptor, [&] {
+            SecretKey secret_key;
+            load_key(sk_path_, secret_key);
+            keys_.decryptor = make_shared<Decryptor>(context_, secret_key);
+        });
+    }
+    else if (keys_.decryptor) {
+        // 암호문 응답만 쓰는 클라이언트로 바뀌면 이전 비밀키를 들고 있지 않는다
+        keys_.decryptor.reset();
+        sk_stamp_ = FileStamp();
+        any_key_loaded = true;
+    }
+    any_key_loaded |= reload(rk_path_, rk_stamp_, !keys_.relin_keys, [&] {
+        auto relin_keys = make_shared<RelinKeys>();
+        load_key(rk_path_, *relin_keys);
+        keys_.relin_keys = move(relin_keys);
+    });
+    any_key_loaded |= reload(gk_path_, gk_stamp_, !keys_.galois_keys, [&] {
+        auto galois_keys = make_shared<GaloisKeys>();
+        load_key(gk_path_, *galois_keys);
+        keys_.galois_keys = move(galois_keys);
+    });
+
+    stats_.last_key_load_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - key_start).count();
+    stats_.last_keys_reloaded = any_key_loaded;
+    if (any_key_loaded) {
+        stats_.key_loads++;
+        stats_.total_key_load_ms += stats_.last_key_load_ms;
+        stats_.total_key_blobs.add(stats_.last_key_blobs);
+    }
+    else {
+        stats_.key_hits++;
+    }
+}
+
+void ServerCache::refresh_model_locked() {
+    // --- 모델: models.txt 또는 목록의 weights/bias 파일 중 하나라도 바뀌면 전부 다시 읽음 ---
+    auto model_start = chrono::steady_clock::now();
+    bool changed = !models_;
+
+    // models.txt가 생기거나 사라지거나 바뀌면 감시할 파일 목록부터 다시 만든다
+    bool manifest_exists = fs::exists(manifest_path_);
+    bool manifest_changed = manifest_exists ? stamp_changed(manifest_path_, manifest_stamp_) : manifest_stamp_.valid;
+    if (!manifest_exists) manifest_stamp_ = FileStamp();
+    if (manifest_changed || model_files_.empty()) {
+        model_files_ = model_set_files(model_dir_);
+        changed = true;
+    }
+    for (const fs::path& path : model_files_) {
+        if (stamp_changed(path, model_stamps_[path])) changed = true;
+    }
+
+    stats_.last_model_reloaded = changed;
+    if (stats_.last_model_reloaded) {
+        try {
+            models_ = make_shared<const ModelSet>(load_model_set(model_dir_));
+            // 가중치/bias가 바뀌었으므로 인코딩해 둔 평문 상수도 새로 시작
+            constants_ = make_shared<PlaintextCache>();
+        }
+        catch (...) {
+            model_files_.clear();
+            model_stamps_.clear();
+            throw;
+        }
+        stats_.model_loads++;
+    }
+    else {
+        stats_.model_hits++;
+    }
+    stats_.last_model_load_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - model_start).count();
+    if (stats_.last_model_reloaded) stats_.total_model_load_ms += stats_.last_model_load_ms;
+}
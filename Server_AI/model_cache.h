@@ -0,0 +1,154 @@
+﻿#pragma once
+#include "seal/seal.h"
+#include "plaintext_cache.h"
+#include "../Common/blob_loader.h"
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+// MLP 은닉층: h = activation(W x + b), W는 은닉 x 입력
+struct HiddenLayer {
+    std::vector<std::vector<double>> weights;
+    std::vector<double> bias;
+    std::vector<double> activation;  // 활성화 다항식 계수 (c0, c1, ..., cd)
+};
+
+// 입력 특성의 이름과 정규화 범위 (train_model.py의 MinMaxScaler, MLP 모델 파일에만 있음)
+struct FeatureRange {
+    std::string name;
+    double min = 0.0;
+    double max = 1.0;
+};
+
+// 로지스틱 회귀 sigmoid(w·x + b). hidden이 있으면 2층 MLP이고 weights/bias는 출력층 (입력은 은닉층 출력)
+struct LogisticModel {
+    std::string name = "default";
+    std::vector<double> weights;
+    double bias = 0.0;
+    std::optional<HiddenLayer> hidden;
+    std::vector<FeatureRange> features;
+
+    size_t input_count() const { return hidden ? hidden->weights.front().size() : weights.size(); }
+    size_t hidden_count() const { return hidden ? hidden->bias.size() : 0; }
+};
+
+// weights.txt / bias.txt 읽기
+LogisticModel load_model(const std::filesystem::path& weights_path, const std::filesystem::path& bias_path);
+
+// train_model.py --mlp가 만드는 MLP 모델 파일 읽기 (#은 주석)
+//   input 13 / hidden 16 / feature <이름> <min> <max> (입력마다, 선택)
+//   activation c0 c1 c2 / hidden_weights (은닉 x 입력, 행 우선) / hidden_bias / output_weights / output_bias
+// 크기가 맞지 않으면 runtime_error
+LogisticModel load_mlp_model(const std::filesystem::path& path);
+
+// --- 모델 목록 (같은 입력 특성에 여러 모델을 적용) ---
+// model_dir/models.txt가 있으면 한 줄에 모델 하나: "<이름> <weights 파일> <bias 파일>" 또는 "<이름> mlp <MLP 모델 파일>"
+// (경로는 model_dir 기준, #은 주석). 없으면 weights.txt / bias.txt 하나를 "default" 모델로 쓴다.
+// 암호화된 입력 하나에 모든 모델을 적용하므로 점수는 환자마다 모델 수만큼 나온다 (환자 순, 모델 순).
+struct ModelSet {
+    std::vector<LogisticModel> models;
+
+    size_t size() const { return models.size(); }
+    size_t feature_count() const { return models.front().input_count(); }
+    size_t hidden_count() const { return models.front().hidden_count(); }
+    std::vector<std::string> names() const;
+};
+
+// 모델이 없거나, 특성 수나 은닉층 크기가 서로 다르거나, 이름이 겹치면 runtime_error
+ModelSet load_model_set(const std::filesystem::path& model_dir);
+
+// load_model_set이 읽는 파일 목록 (변경 감지용, models.txt 자체는 제외)
+std::vector<std::filesystem::path> model_set_files(const std::filesystem::path& model_dir);
+
+// 파일 변경 감지용 (mtime + 크기)
+// 클라이언트는 rename으로 파일을 교체하므로 내용이 바뀌면 mtime도 반드시 바뀐다.
+struct FileStamp {
+    std::filesystem::file_time_type mtime{};
+    std::uintmax_t size = 0;
+    bool valid = false;
+};
+
+// 현재 파일 상태와 비교하여 바뀌었으면 stamp를 갱신하고 true (파일이 없으면 filesystem_error)
+bool stamp_changed(const std::filesystem::path& path, FileStamp& stamp);
+
+struct CacheStats {
+    size_t key_loads = 0;      // 키 파일 역직렬화 횟수
+    size_t key_hits = 0;       // 변경이 없어 재사용한 횟수 (refresh 단위)
+    size_t model_loads = 0;
+    size_t model_hits = 0;
+    bool last_keys_reloaded = false;  // 마지막 refresh에서 키를 하나라도 다시 읽었는지
+    bool last_model_reloaded = false;
+    double last_key_load_ms = 0.0;    // 마지막 refresh에서 키 로딩에 쓴 시간
+    double last_model_load_ms = 0.0;
+    double total_key_load_ms = 0.0;
+    double total_model_load_ms = 0.0;
+    BlobLoadStats last_key_blobs;     // 마지막 refresh에서 다시 읽은 키 파일 (mmap / 복사 바이트)
+    BlobLoadStats total_key_blobs;
+};
+
+// 요청 처리에 쓰는 키 묶음
+// Encryptor/Decryptor는 생성 시 키를 복사해 두므로 PublicKey/SecretKey는 따로 들고 있지 않는다.
+// decryptor는 클라이언트가 비밀키를 보낸 경우에만 있다 (plain 응답용, 암호문 응답은 필요 없음).
+// 파일이 바뀌면 바뀐 항목만 새 객체로 바꾸고 나머지 shared_ptr은 그대로 재사용한다.
+struct KeySet {
+    std::shared_ptr<const seal::Encryptor> encryptor;
+    std::shared_ptr<seal::Decryptor> decryptor;
+    std::shared_ptr<const seal::RelinKeys> relin_keys;
+    std::shared_ptr<const seal::GaloisKeys> galois_keys;
+};
+
+// 한 요청이 처음부터 끝까지 사용하는 캐시 상태
+// 처리 도중 다른 요청이 키를 다시 로드해도 이 snapshot이 가리키는 객체는 바뀌지 않는다.
+struct CacheSnapshot {
+    KeySet keys;
+    std::shared_ptr<const ModelSet> models;
+    std::shared_ptr<PlaintextCache> constants; // 이 모델들의 인코딩된 평문 상수 (모델과 수명이 같음)
+    CacheStats stats;   // 이 snapshot을 만든 refresh 시점의 통계
+};
+
+// --- 상주 캐시: 모델 목록 + 키 + Encryptor/Decryptor ---
+// 요청마다 수 MB짜리 RelinKeys/GaloisKeys를 다시 역직렬화하지 않도록,
+// 파일이 바뀐 경우에만 해당 항목을 다시 읽고 관련 객체를 재생성한다.
+// 여러 worker 스레드가 동시에 acquire해도 안전하다.
+class ServerCache {
+public:
+    ServerCache(const seal::SEALContext& context, const std::filesystem::path& channel_dir,
+        const std::filesystem::path& model_dir);
+
+    // 키 파일이 모두 있는지 확인 (secret_key.dat는 선택, 없으면 snapshot.keys.decryptor가 비어 있음)
+    bool keys_available() const;
+
+    // 바뀐 파일만 다시 로드한 뒤 현재 상태를 snapshot으로 돌려준다 (키 파일이 없으면 false)
+    bool acquire(CacheSnapshot& snapshot);
+
+    // 모델과 평문 상수만 갱신해 snapshot에 채운다 (snapshot.keys는 건드리지 않음)
+    // 소켓 세션처럼 키를 파일이 아닌 연결로 받은 경우에 쓴다.
+    void acquire_model(CacheSnapshot& snapshot);
+
+    CacheStats stats() const;
+
+private:
+    // 바뀐 파일만 다시 로드 (mutex_를 잡은 상태에서 호출)
+    void refresh_keys_locked();
+    void refresh_model_locked();
+
+    const seal::SEALContext& context_;
+    std::filesystem::path pk_path_, sk_path_, rk_path_, gk_path_;
+    FileStamp pk_stamp_, sk_stamp_, rk_stamp_, gk_stamp_;
+
+    // 모델: models.txt (없을 수 있음) + 그 목록의 weights/bias 파일
+    std::filesystem::path model_dir_, manifest_path_;
+    FileStamp manifest_stamp_;
+    std::vector<std::filesystem::path> model_files_;
+    std::map<std::filesystem::path, FileStamp> model_stamps_;
+
+    mutable std::mutex mutex_;
+    KeySet keys_;
+    std::shared_ptr<const ModelSet> models_;
+    std::shared_ptr<PlaintextCache> constants_;
+    CacheStats stats_;
+};
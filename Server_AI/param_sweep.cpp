@@ -0,0 +1,169 @@
+﻿#include "param_sweep.h"
+#include "bulk_scoring.h"
+#include "diagnostics.h"
+#include "server_log.h"
+#include "../Common/param_planner.h"
+#include <algorithm>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+using namespace seal;
+namespace fs = std::filesystem;
+
+// 스윕 한 점의 결과 (여러 모델이면 가장 나쁜 모델 기준)
+struct SweepPoint {
+    string circuit;
+    ParameterPlan plan;
+    int integer_bits = 0;
+    int bit_scale = 0;
+    string status = "ok";          // ok / skipped: <이유> / failed: <이유>
+    BulkSummary summary;
+    double max_abs_error = 0.0;
+    double mean_abs_error = 0.0;
+    double agreement = 0.0;        // 판정 일치율 (%)
+    double batch_ms = 0.0;         // 암호문 하나 (배치) 평균 처리 시간
+};
+
+static string chain_text(const ParameterPlan& plan) {
+    ostringstream out;
+    for (size_t i = 0; i < plan.coeff_modulus_bits.size(); i++) out << (i ? " " : "") << plan.coeff_modulus_bits[i];
+    return out.str();
+}
+
+static void write_point(ostream& out, const SweepPoint& point) {
+    const BulkSummary& summary = point.summary;
+    out << point.circuit << "," << point.plan.poly_modulus_degree << "," << chain_text(point.plan) << ","
+        << point.plan.scale_bits << "," << point.integer_bits << "," << point.bit_scale << ",\"" << point.status << "\","
+        << summary.rows << "," << point.max_abs_error << "," << point.mean_abs_error << "," << point.agreement << ","
+        << point.batch_ms << "," << (summary.seconds > 0 ? summary.rows / summary.seconds : 0.0) << ","
+        << summary.input_ciphertext_bytes << "," << summary.result_ciphertext_bytes << "," << summary.key_bytes << "\n";
+}
+
+static void run_point(const SweepOptions& options, SweepPoint& point, const CircuitSpec& circuit) {
+    EncryptionParameters parms = make_encryption_parameters(point.plan);
+    SEALContext context(parms);
+    if (!context.parameters_set()) {
+        throw runtime_error(context.parameter_error_message());
+    }
+
+    DiagnosticsSink no_diagnostics(".", 0);
+    InferenceSetup setup{ context, circuit, point.plan, no_diagnostics };
+
+    BulkOptions bulk;
+    bulk.input_path = options.input_path;
+    bulk.model_dir = options.model_dir;
+    bulk.workers = options.workers;
+    bulk.measure_sizes = true;
+    point.summary = score_csv(setup, bulk);
+
+    const BulkSummary& summary = point.summary;
+    if (summary.rows == 0) throw runtime_error("No rows scored");
+    point.agreement = 100.0;
+    for (const BulkModelSummary& model : summary.models) {
+        point.max_abs_error = max(point.max_abs_error, model.max_abs_error);
+        point.mean_abs_error = max(point.mean_abs_error, model.total_abs_error / summary.rows);
+        point.agreement = min(point.agreement, 100.0 * model.agreements / summary.rows);
+    }
+    point.batch_ms = summary.batches > 0 ? 1000.0 * summary.batch_seconds / summary.batches : 0.0;
+}
+
+void run_parameter_sweep(const SweepOptions& options) {
+    ofstream out(options.output_path);
+    if (!out.is_open()) throw runtime_error("Failed to open " + options.output_path.string());
+    out << "circuit,poly_modulus_degree,coeff_modulus_bits,scale_bits,integer_bits,bit_scale,status,rows,"
+           "max_abs_error,mean_abs_error,decision_agreement_pct,batch_latency_ms,rows_per_s,"
+           "input_ciphertext_bytes,result_ciphertext_bytes,key_bytes\n";
+    out.precision(6);
+
+    vector<string> circuits = options.circuits.empty() ? vector<string>{ "sigmoid3" } : options.circuits;
+    optional<SweepPoint> best;
+    size_t points = 0;
+
+    for (const string& circuit_arg : circuits) {
+        CircuitSpec base = parse_circuit(circuit_arg);
+        vector<int> integer_bits = options.integer_bits.empty() ? vector<int>{ base.integer_bits } : options.integer_bits;
+        vector<int> bit_scales = options.bit_scales.empty() ? vector<int>{ base.input_bit_scale } : options.bit_scales;
+
+        for (int integer : integer_bits) {
+            CircuitSpec circuit = base;
+            circuit.integer_bits = integer;
+
+            // N을 지정하지 않으면 planner가 이 회로에 고르는 N 하나 (0, 점마다 계획할 때 정함 → 맞는 N이 없으면 skipped)
+            vector<size_t> degrees = options.poly_degrees;
+            if (degrees.empty()) degrees.push_back(0);
+            vector<int> scales = options.scale_bits.empty() ? vector<int>{ 0 } : options.scale_bits;
+
+            for (size_t n : degrees) {
+                for (int scale : scales) {
+                    for (int quantization : bit_scales) {
+                        circuit.input_bit_scale = quantization;
+
+                        SweepPoint point;
+                        point.circuit = circuit_name(circuit);
+                        point.integer_bits = integer;
+                        point.bit_scale = quantization;
+                        point.plan.poly_modulus_degree = n;
+                        point.plan.scale_bits = scale;
+                        points++;
+
+                        try {
+                            size_t degree = n != 0 ? n : plan_parameters(circuit).poly_modulus_degree;
+                            point.plan.poly_modulus_degree = degree;
+                            point.plan = plan_parameters(circuit, degree, scale);
+                        }
+                        catch (const exception& e) {
+                            point.status = string("skipped: ") + e.what();
+                        }
+
+                        if (point.status == "ok") {
+                            LogLine() << "[Sweep] " << point.circuit << ", " << describe_plan(point.plan)
+                                      << ", integer bits " << integer << ", bit_scale " << quantization << "...\n";
+                            try {
+                                run_point(options, point, circuit);
+                            }
+                            catch (const exception& e) {
+                                point.status = string("failed: ") + e.what();
+                            }
+                        }
+
+                        write_point(out, point);
+                        out.flush();
+
+                        LogLine log;
+                        log << "[Sweep]   " << point.status;
+                        if (point.status == "ok") {
+                            log << ": max abs error " << point.max_abs_error << ", mean " << point.mean_abs_error
+                                << ", decision agreement " << point.agreement << "%, " << point.batch_ms
+                                << " ms per ciphertext, input " << point.summary.input_ciphertext_bytes << " B, result "
+                                << point.summary.result_ciphertext_bytes << " B, keys " << point.summary.key_bytes << " B";
+
+                            // 판정이 모두 같은 점 중 가장 빠른 점 (같으면 입력 암호문이 작은 쪽)
+                            bool unchanged = point.agreement >= 100.0;
+                            bool better = !best || point.batch_ms < best->batch_ms
+                                || (point.batch_ms == best->batch_ms
+                                    && point.summary.input_ciphertext_bytes < best->summary.input_ciphertext_bytes);
+                            if (unchanged && better) best = point;
+                        }
+                        log << "\n";
+                    }
+                }
+            }
+        }
+    }
+
+    LogLine log;
+    log << "[Sweep] " << points << " point(s) written to " << options.output_path << "\n";
+    if (best) {
+        log << "[Sweep] Cheapest configuration with unchanged decisions: " << best->circuit << ", "
+            << describe_plan(best->plan) << ", integer bits " << best->integer_bits << ", bit_scale " << best->bit_scale
+            << " (" << best->batch_ms << " ms per ciphertext, max abs error " << best->max_abs_error << ")\n";
+    }
+    else {
+        log << "[Sweep] No configuration kept every decision unchanged.\n";
+    }
+}
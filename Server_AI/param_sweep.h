@@ -0,0 +1,26 @@
+﻿#pragma once
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// --- CKKS 파라미터 스윕 (정밀도 / 지연 시간 / 크기) ---
+// 회로, N, scale, 결과용 정수부 비트, 입력 정수화 배율(bit_scale)의 조합마다 새 SEALContext와 키를 만들어
+// CSV 전체를 암호 경로로 채점하고 (bulk_scoring.h의 score_csv), 평문 모델과의 오차를 잰다.
+// modulus chain은 planner 규칙 { scale + integer_bits | scale x depth | scale + integer_bits (special) }을 (param_planner.h) 따르므로 scale과 integer_bits가 chain을 정한다.
+// 결과는 점마다 한 줄의 CSV와 로그로 남기고, 마지막에 모든 모델의 판정(0.5 기준)이 평문과 같은 점 중
+// 배치 지연 시간이 가장 짧은 점을 추천한다. 보안 예산을 넘는 점은 건너뛰고 (skipped), 실행 중 실패한 점은 failed로 기록한다.
+struct SweepOptions {
+    std::filesystem::path input_path;
+    std::filesystem::path output_path;
+    std::filesystem::path model_dir = ".";
+    size_t workers = 0;                      // 0이면 CPU 코어 수
+
+    std::vector<std::string> circuits;       // parse_circuit 이름
+    std::vector<size_t> poly_degrees;        // 비어 있으면 회로마다 planner가 고른 N
+    std::vector<int> scale_bits;             // 비어 있으면 N에서 가장 큰 scale
+    std::vector<int> integer_bits;           // 비어 있으면 CircuitSpec 기본값
+    std::vector<int> bit_scales;             // 비어 있으면 batch_layout.h의 bit_scale (0 = 정수화 없음)
+};
+
+// 입력/모델 파일 문제는 runtime_error (파라미터 조합의 실패는 결과 CSV에 기록하고 계속)
+void run_parameter_sweep(const SweepOptions& options);
@@ -0,0 +1,57 @@
+﻿#include "plaintext_cache.h"
+#include <bit>
+#include <mutex>
+
+using namespace std;
+using namespace seal;
+
+size_t PlaintextCache::KeyHash::operator()(const Key& key) const {
+    size_t h = hash<string>()(key.name);
+    auto mix = [&h](uint64_t v) { h ^= hash<uint64_t>()(v) + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2); };
+    for (uint64_t word : key.parms_id) mix(word);
+    mix(key.scale_bits);
+    mix(key.value_bits);
+    return h;
+}
+
+const Plaintext& PlaintextCache::constant(CKKSEncoder& encoder, const MemoryPoolHandle& pool,
+    double value, parms_id_type parms_id, double scale) {
+    Key key{ "", parms_id, bit_cast<uint64_t>(scale), bit_cast<uint64_t>(value) };
+    return find_or_encode(key, [&](Plaintext& plain) {
+        encoder.encode(value, parms_id, scale, plain, pool);
+    });
+}
+
+const Plaintext& PlaintextCache::slots(const string& name, CKKSEncoder& encoder, const MemoryPoolHandle& pool,
+    const function<vector<double>()>& make, parms_id_type parms_id, double scale) {
+    Key key{ name, parms_id, bit_cast<uint64_t>(scale), 0 };
+    return find_or_encode(key, [&](Plaintext& plain) {
+        encoder.encode(make(), parms_id, scale, plain, pool);
+    });
+}
+
+size_t PlaintextCache::size() const {
+    shared_lock<shared_mutex> lock(mutex_);
+    return entries_.size();
+}
+
+const Plaintext& PlaintextCache::find_or_encode(const Key& key, const function<void(Plaintext&)>& encode) {
+    {
+        shared_lock<shared_mutex> lock(mutex_);
+        auto it = entries_.find(key);
+        if (it != entries_.end()) {
+            hits_++;
+            return *it->second;
+        }
+    }
+
+    // 인코딩은 lock 밖에서 (worker의 임시 메모리 풀 사용), 결과는 전역 풀에 상주
+    auto plain = make_unique<Plaintext>(MemoryManager::GetPool());
+    encode(*plain);
+    misses_++;
+
+    unique_lock<shared_mutex> lock(mutex_);
+    // 다른 worker가 먼저 넣었으면 그 값을 사용
+    auto result = entries_.emplace(key, move(plain));
+    return *result.first->second;
+}
@@ -0,0 +1,49 @@
+﻿#pragma once
+#include "seal/seal.h"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// --- 평문 상수 캐시 ---
+// 가중치, bias, 다항식 계수처럼 환자와 무관한 평문은 (이름/값, parms_id, scale)마다 한 번만 인코딩해 둔다.
+// CKKSEncoder의 결과는 이미 NTT 형태이므로 multiply_plain/add_plain에 그대로 쓰인다.
+// ServerCache가 모델을 다시 로드할 때마다 새 캐시를 만들므로, 이전 모델의 상수는 snapshot과 함께 사라진다.
+// 여러 worker가 동시에 조회해도 안전하며, 반환된 참조는 캐시가 살아 있는 동안 유효하다.
+class PlaintextCache {
+public:
+    // 모든 슬롯이 value인 평문
+    const seal::Plaintext& constant(seal::CKKSEncoder& encoder, const seal::MemoryPoolHandle& pool,
+        double value, seal::parms_id_type parms_id, double scale);
+
+    // make()가 만드는 슬롯 벡터 (가중치 등), name으로 구분. 처음 한 번만 make()를 호출한다.
+    const seal::Plaintext& slots(const std::string& name, seal::CKKSEncoder& encoder, const seal::MemoryPoolHandle& pool,
+        const std::function<std::vector<double>()>& make, seal::parms_id_type parms_id, double scale);
+
+    size_t size() const;
+    size_t hits() const { return hits_; }
+    size_t misses() const { return misses_; }
+
+private:
+    struct Key {
+        std::string name;
+        seal::parms_id_type parms_id;
+        std::uint64_t scale_bits;
+        std::uint64_t value_bits;
+        bool operator==(const Key& other) const = default;
+    };
+    struct KeyHash {
+        size_t operator()(const Key& key) const;
+    };
+
+    const seal::Plaintext& find_or_encode(const Key& key, const std::function<void(seal::Plaintext&)>& encode);
+
+    mutable std::shared_mutex mutex_;
+    std::unordered_map<Key, std::unique_ptr<const seal::Plaintext>, KeyHash> entries_;
+    std::atomic<size_t> hits_{ 0 };
+    std::atomic<size_t> misses_{ 0 };
+};
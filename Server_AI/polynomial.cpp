@@ -0,0 +1,208 @@
+﻿#include "polynomial.h"
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+using namespace seal;
+
+double rescale_prime(const SEALContext& context, parms_id_type parms_id) {
+    return static_cast<double>(context.get_context_data(parms_id)->parms().coeff_modulus().back().value());
+}
+
+static bool is_zero(const vector<double>& coeffs, size_t from) {
+    for (size_t i = from; i < coeffs.size(); i++) {
+        if (coeffs[i] != 0.0) return false;
+    }
+    return true;
+}
+
+namespace {
+
+class PolynomialEvaluator {
+public:
+    PolynomialEvaluator(const SEALContext& context, WorkerContext& worker, const RelinKeys& relin_keys,
+        PlaintextCache& constants, PolynomialStats& stats)
+        : context_(context), worker_(worker), relin_keys_(relin_keys), constants_(constants), stats_(stats),
+          baby_(worker.scratch.baby_powers), giant_(worker.scratch.giant_powers) {}
+
+    // x^1 .. x^top, x^k, x^2k, ... 미리 계산
+    void build_powers(const Ciphertext& x, const BabyStepPlan& plan) {
+        baby_step_ = plan.baby_step;
+        // 거듭제곱 버퍼는 worker가 요청마다 재사용 (덮어쓰므로 같은 레벨이면 재할당 없음)
+        WorkerScratch::reserve(baby_, plan.top_power + 1, worker_.pool);
+        baby_[1] = x;
+        for (size_t j = 2; j <= plan.top_power; j++) {
+            // x^j = x^h * x^(j - h), h = j보다 작은 최대 2의 거듭제곱 → 깊이 ceil(log2 j)
+            size_t h = size_t(1) << (ceil_log2(j) - 1);
+            multiply(baby_[h], baby_[j - h], baby_[j]);
+            worker_.evaluator.rescale_to_next_inplace(baby_[j], worker_.pool);
+            // x^(k/2) 이하만 다른 거듭제곱의 인수로 쓰인다. 나머지는 상수배만 되므로 재선형화를 미룸
+            if (j <= baby_step_ / 2) relinearize(baby_[j]);
+        }
+
+        WorkerScratch::reserve(giant_, plan.giant_count, worker_.pool);
+        for (size_t j = 0; j < plan.giant_count; j++) {
+            const Ciphertext& half = (j == 0) ? baby_[baby_step_ / 2] : giant_[j - 1];
+            multiply(half, half, giant_[j]);
+            relinearize(giant_[j]);
+            worker_.evaluator.rescale_to_next_inplace(giant_[j], worker_.pool);
+        }
+    }
+
+    // coeffs가 나타내는 다항식을 chain_index 레벨, scale로 계산 (상수가 아닌 다항식만)
+    Ciphertext evaluate(const vector<double>& coeffs, size_t chain_index, double scale) {
+        if (coeffs.size() <= baby_step_) return evaluate_leaf(coeffs, chain_index, scale);
+
+        // p = q * x^split + r, split = k * 2^j (split < 항 개수 <= 2 * split)
+        size_t j = 0;
+        while ((baby_step_ << (j + 1)) < coeffs.size()) j++;
+        size_t split = baby_step_ << j;
+        vector<double> r(coeffs.begin(), coeffs.begin() + split);
+        vector<double> q(coeffs.begin() + split, coeffs.end());
+
+        if (is_zero(q, 0)) return evaluate(r, chain_index, scale);
+
+        // q * giant를 한 레벨 위에서 곱해 rescale하면 정확히 (chain_index, scale)이 되도록 q의 scale을 정함
+        //   q.scale * giant.scale / p_(chain_index + 1) = scale
+        // 복사 생성은 전역 풀에서 할당하므로 worker 풀의 암호문에 대입
+        Ciphertext giant(worker_.pool);
+        giant = giant_[j];
+        worker_.evaluator.mod_switch_to_inplace(giant, parms_at(chain_index + 1), worker_.pool);
+        double q_scale = scale * rescale_prime(context_, giant.parms_id()) / giant.scale();
+
+        Ciphertext result(worker_.pool);
+        if (is_zero(q, 1)) {
+            multiply_constant(giant, q[0], q_scale);
+            result = move(giant);
+        }
+        else {
+            Ciphertext q_encrypted = evaluate(q, chain_index + 1, q_scale);
+            relinearize(q_encrypted);
+            multiply(q_encrypted, giant, result);
+        }
+        worker_.evaluator.rescale_to_next_inplace(result, worker_.pool);
+        result.scale() = scale; // 부동소수점 반올림 오차만 정리
+
+        add_remainder(result, r, chain_index, scale);
+        return result;
+    }
+
+private:
+    // 차수 k 미만: sum c_j * x^j (상수배 항을 모두 더한 뒤 rescale 한 번) + c_0
+    Ciphertext evaluate_leaf(const vector<double>& coeffs, size_t chain_index, double scale) {
+        parms_id_type upper = parms_at(chain_index + 1);
+        double upper_scale = scale * rescale_prime(context_, upper);
+
+        Ciphertext result(worker_.pool);
+        bool has_terms = false;
+        for (size_t j = 1; j < coeffs.size(); j++) {
+            if (coeffs[j] == 0.0) continue;
+
+            Ciphertext term(worker_.pool);
+            term = baby_[j];
+            worker_.evaluator.mod_switch_to_inplace(term, upper, worker_.pool);
+            multiply_constant(term, coeffs[j], upper_scale / term.scale());
+            term.scale() = upper_scale;
+
+            if (has_terms) worker_.evaluator.add_inplace(result, term);
+            else result = move(term);
+            has_terms = true;
+        }
+        if (!has_terms) throw runtime_error("Polynomial leaf has no variable terms!");
+
+        worker_.evaluator.rescale_to_next_inplace(result, worker_.pool);
+        result.scale() = scale;
+
+        add_remainder(result, { coeffs[0] }, chain_index, scale);
+        return result;
+    }
+
+    // result += r (r이 상수면 평문 덧셈)
+    void add_remainder(Ciphertext& result, const vector<double>& r, size_t chain_index, double scale) {
+        if (!is_zero(r, 1)) {
+            Ciphertext remainder = evaluate(r, chain_index, scale);
+            worker_.evaluator.add_inplace(result, remainder);
+        }
+        else if (r[0] != 0.0) {
+            const Plaintext& plain_constant = constants_.constant(worker_.encoder, worker_.pool, r[0], result.parms_id(), scale);
+            worker_.evaluator.add_plain_inplace(result, plain_constant, worker_.pool);
+        }
+    }
+
+    void multiply_constant(Ciphertext& encrypted, double value, double plain_scale) {
+        const Plaintext& plain_value = constants_.constant(worker_.encoder, worker_.pool, value, encrypted.parms_id(), plain_scale);
+        worker_.evaluator.multiply_plain_inplace(encrypted, plain_value, worker_.pool);
+    }
+
+    // 두 암호문을 낮은 쪽 레벨에 맞춰 곱한다 (재선형화하지 않음)
+    void multiply(const Ciphertext& a, const Ciphertext& b, Ciphertext& destination) {
+        size_t level_a = context_.get_context_data(a.parms_id())->chain_index();
+        size_t level_b = context_.get_context_data(b.parms_id())->chain_index();
+        const Ciphertext& lower = (level_a <= level_b) ? a : b;
+        Ciphertext higher(worker_.pool);
+        higher = (level_a <= level_b) ? b : a;
+        worker_.evaluator.mod_switch_to_inplace(higher, lower.parms_id(), worker_.pool);
+
+        if (&a == &b) worker_.evaluator.square(lower, destination, worker_.pool);
+        else worker_.evaluator.multiply(lower, higher, destination, worker_.pool);
+        stats_.multiplications++;
+    }
+
+    void relinearize(Ciphertext& encrypted) {
+        if (encrypted.size() <= 2) return;
+        worker_.evaluator.relinearize_inplace(encrypted, relin_keys_, worker_.pool);
+        stats_.relinearizations++;
+    }
+
+    parms_id_type parms_at(size_t chain_index) const {
+        auto data = context_.first_context_data();
+        while (data && data->chain_index() > chain_index) data = data->next_context_data();
+        if (!data || data->chain_index() != chain_index) throw runtime_error("Not enough levels for polynomial!");
+        return data->parms_id();
+    }
+
+    const SEALContext& context_;
+    WorkerContext& worker_;
+    const RelinKeys& relin_keys_;
+    PlaintextCache& constants_;
+    PolynomialStats& stats_;
+
+    size_t baby_step_ = 2;
+    vector<Ciphertext>& baby_;   // worker.scratch (이 평가 동안만 유효)
+    vector<Ciphertext>& giant_;
+};
+
+}
+
+Ciphertext evaluate_polynomial(const SEALContext& context, WorkerContext& worker, const RelinKeys& relin_keys,
+    PlaintextCache& constants, const Ciphertext& x, const vector<double>& coeffs, PolynomialStats* stats) {
+
+    // 최고차항 쪽 0 계수 제거
+    vector<double> trimmed(coeffs);
+    while (!trimmed.empty() && trimmed.back() == 0.0) trimmed.pop_back();
+    if (trimmed.size() < 2) throw runtime_error("Polynomial must have degree 1 or more!");
+    size_t degree = trimmed.size() - 1;
+
+    // 남은 레벨 안에서 곱셈이 가장 적은 baby step 선택
+    size_t levels = context.get_context_data(x.parms_id())->chain_index();
+    BabyStepPlan best = choose_baby_step(degree, levels);
+    if (best.baby_step == 0) {
+        throw runtime_error("Not enough levels for polynomial of degree " + to_string(degree) + "!");
+    }
+
+    PolynomialStats local_stats;
+    PolynomialStats& result_stats = stats ? *stats : local_stats;
+    result_stats = PolynomialStats();
+    result_stats.degree = degree;
+    result_stats.baby_step = best.baby_step;
+    result_stats.depth = best.depth;
+
+    PolynomialEvaluator evaluator(context, worker, relin_keys, constants, result_stats);
+    evaluator.build_powers(x, best);
+    Ciphertext result = evaluator.evaluate(trimmed, levels - best.depth, x.scale());
+    if (result.size() > 2) {
+        worker.evaluator.relinearize_inplace(result, relin_keys, worker.pool);
+        result_stats.relinearizations++;
+    }
+    return result;
+}
@@ -0,0 +1,76 @@
+﻿#pragma once
+#include "seal/seal.h"
+#include "plaintext_cache.h"
+#include "worker_pool.h"
+#include <vector>
+
+// rescale_to_next가 나누는 소수 (해당 레벨의 마지막 coeff modulus)
+double rescale_prime(const seal::SEALContext& context, seal::parms_id_type parms_id);
+
+constexpr size_t ceil_log2(size_t value) {
+    size_t bits = 0;
+    while ((size_t(1) << bits) < value) bits++;
+    return bits;
+}
+
+// baby step 크기 k에 대한 곱셈 깊이와 암호문끼리 곱셈 수 (상한)
+// 일반 경로(evaluate_polynomial)와 고정 회로(fixed_circuit.h)가 같은 계획을 쓴다.
+struct BabyStepPlan {
+    size_t baby_step = 0;
+    size_t top_power = 0;   // 실제로 필요한 baby step 최고 차수 min(k - 1, d)
+    size_t giant_count = 0; // x^k, x^2k, ... 개수
+    size_t depth = 0;
+    size_t multiplications = 0;
+};
+
+constexpr BabyStepPlan plan_baby_step(size_t k, size_t degree) {
+    BabyStepPlan plan;
+    plan.baby_step = k;
+    plan.top_power = k - 1 < degree ? k - 1 : degree;
+    while ((k << plan.giant_count) <= degree) plan.giant_count++;
+
+    // 조각의 깊이: x^top (ceil(log2 top)) + 상수배 (1), giant step마다 +1
+    plan.depth = ceil_log2(plan.top_power) + 1 + plan.giant_count;
+    // baby: x^2 .. x^top, giant: 제곱 한 번씩, 분할 노드: 최대 2^giant_count - 1
+    plan.multiplications = (plan.top_power - 1) + plan.giant_count + ((size_t(1) << plan.giant_count) - 1);
+    return plan;
+}
+
+// levels 레벨 안에서 곱셈이 가장 적은 baby step (같으면 깊이가 얕은 쪽). 맞는 k가 없으면 baby_step이 0
+constexpr BabyStepPlan choose_baby_step(size_t degree, size_t levels) {
+    BabyStepPlan best;
+    for (size_t k = 2; k <= (size_t(1) << ceil_log2(degree + 1)); k <<= 1) {
+        BabyStepPlan candidate = plan_baby_step(k, degree);
+        if (candidate.depth > levels) continue;
+        if (best.baby_step == 0 || candidate.multiplications < best.multiplications
+            || (candidate.multiplications == best.multiplications && candidate.depth < best.depth)) {
+            best = candidate;
+        }
+    }
+    return best;
+}
+
+// --- 암호문 다항식 평가 (Paterson–Stockmeyer / baby-step giant-step) ---
+// p(x) = c0 + c1*x + ... + cd*x^d 를 임의의 계수 목록으로 계산한다 (sigmoid 근사 등).
+//
+//   p = q(x) * x^(k*2^j) + r(x)   (giant step: x^k, x^2k, x^4k, ...)
+//   차수 k 미만 조각 = baby step 거듭제곱 x^1 .. x^(k-1)의 상수배 합
+//
+// - baby step 크기 k는 남은 레벨 안에서 암호문끼리 곱셈이 가장 적은 값을 고른다.
+//   (k = 2이면 곱셈 깊이 ceil(log2(d + 1))로 최소, 레벨 여유가 있으면 더 큰 k로 곱셈 수를 줄임)
+// - 모든 덧셈 항의 (레벨, scale)을 위에서부터 정해 두고 상수 계수의 인코딩 scale로 맞추므로
+//   scale 보정용 곱셈이 없다. 상수배 항들은 합친 뒤 한 번만 rescale한다.
+// - 상수 계수 평문은 constants 캐시에서 가져오므로 같은 회로를 반복하면 인코딩이 없다.
+// - 재선형화는 결과가 암호문끼리 곱셈의 피연산자가 될 때와 마지막에만 한다 (lazy relinearization).
+struct PolynomialStats {
+    size_t degree = 0;
+    size_t baby_step = 0;
+    size_t depth = 0;
+    size_t multiplications = 0;   // 암호문끼리 곱셈 수
+    size_t relinearizations = 0;
+};
+
+// 결과는 x와 같은 scale, x보다 depth 레벨 아래에 있다. 레벨이 모자라면 runtime_error.
+seal::Ciphertext evaluate_polynomial(const seal::SEALContext& context, WorkerContext& worker,
+    const seal::RelinKeys& relin_keys, PlaintextCache& constants, const seal::Ciphertext& x, const std::vector<double>& coeffs,
+    PolynomialStats* stats = nullptr);
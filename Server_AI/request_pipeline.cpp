@@ -0,0 +1,328 @@
+﻿#include "request_pipeline.h"
+#include "server_log.h"
+#include "../Common/blob_loader.h"
+#include "../Common/channel.h"
+#include "../Common/ckks_request.h"
+#include <algorithm>
+#include <exception>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+using namespace seal;
+namespace fs = std::filesystem;
+
+// <id>.req: 한 줄에 환자 1명, 값은 공백 또는 쉼표로 구분
+static vector<vector<double>> read_request(istream& in) {
+    vector<vector<double>> patients;
+    string line;
+    while (getline(in, line)) {
+        replace(line.begin(), line.end(), ',', ' ');
+        istringstream line_stream(line);
+        vector<double> features;
+        double temp_val;
+        while (line_stream >> temp_val) features.push_back(temp_val);
+        if (!features.empty()) patients.push_back(move(features));
+    }
+    return patients;
+}
+
+static size_t resolve_depth(const PipelineOptions& options, const WorkerPool& pool) {
+    return options.stage_depth > 0 ? options.stage_depth : pool.size() * 2;
+}
+
+RequestPipeline::RequestPipeline(const InferenceSetup& setup, ServerCache& cache, KeySessionStore& key_sessions,
+    ServerMetrics& metrics, WorkerPool& pool, const fs::path& channel_dir, const PipelineOptions& options)
+    : setup_(setup), cache_(cache), key_sessions_(key_sessions), metrics_(metrics), pool_(pool), channel_dir_(channel_dir),
+      responses_dir_(channel_dir / "responses"),
+      ingest_queue_(resolve_depth(options, pool)),
+      evaluate_queue_(resolve_depth(options, pool)),
+      respond_queue_(resolve_depth(options, pool)) {
+    fs::create_directories(responses_dir_);
+
+    size_t ingest_count = max<size_t>(1, options.ingest_threads);
+    size_t respond_count = max<size_t>(1, options.respond_threads);
+    for (size_t i = 0; i < ingest_count; i++) ingest_threads_.emplace_back(&RequestPipeline::ingest_loop, this);
+    for (size_t i = 0; i < respond_count; i++) respond_threads_.emplace_back(&RequestPipeline::respond_loop, this);
+}
+
+RequestPipeline::~RequestPipeline() {
+    // 앞 단계부터 닫는다: ingest가 끝나면 더 이상 evaluate로 넘어오는 요청이 없다
+    ingest_queue_.close();
+    for (auto& t : ingest_threads_) t.join();
+
+    size_t evaluating = evaluating_.load(memory_order_acquire);
+    while (evaluating > 0) {
+        evaluating_.wait(evaluating, memory_order_acquire);
+        evaluating = evaluating_.load(memory_order_acquire);
+    }
+
+    respond_queue_.close();
+    for (auto& t : respond_threads_) t.join();
+}
+
+void RequestPipeline::submit(const string& request_id, const fs::path& work_path, bool encrypted) {
+    auto job = make_unique<Job>();
+    job->request_id = request_id;
+    job->work_path = work_path;
+    job->encrypted = encrypted;
+    job->request_timer = make_unique<StageTimer>(&job->trace, Stage::request);
+
+    in_flight_.fetch_add(1, memory_order_relaxed);
+    if (!ingest_queue_.push(move(job))) {
+        in_flight_.fetch_sub(1, memory_order_relaxed);
+        throw runtime_error("Request pipeline is shutting down");
+    }
+}
+
+// --- 1. ingest: 파일 I/O와 역직렬화 (Evaluator 없이 스레드별 메모리 풀만 사용) ---
+void RequestPipeline::ingest_loop() {
+    MemoryPoolHandle pool = MemoryPoolHandle::New();
+    JobPtr job;
+    while (ingest_queue_.pop(job)) {
+        uint64_t pool_before = static_cast<uint64_t>(pool.alloc_byte_count());
+        try {
+            ingest(*job, pool);
+        }
+        catch (const exception& e) {
+            job->error = e.what();
+        }
+        job->trace.add_pool_bytes(pool_before, static_cast<uint64_t>(pool.alloc_byte_count()));
+
+        if (!job->error.empty()) {
+            respond_queue_.push(move(job));
+            continue;
+        }
+
+        // evaluate 큐에 넣은 만큼만 pool에 작업을 넘기므로, evaluate_one은 항상 요청 하나를 꺼낸다
+        evaluating_.fetch_add(1, memory_order_relaxed);
+        evaluate_queue_.push(move(job));
+        pool_.submit([this](WorkerContext& worker) { evaluate_one(worker); });
+    }
+}
+
+void RequestPipeline::acquire_snapshot(Job& job, const string& key_id) {
+    const string& request_id = job.request_id;
+    RequestTrace& trace = job.trace;
+    CacheSnapshot& snapshot = job.snapshot;
+
+    if (!key_id.empty()) {
+        // --- 병원별 키 세션: 모델/평문 상수는 공용 캐시, 키는 keys/<key_id>/ 세션 ---
+        cache_.acquire_model(snapshot);
+        KeySessionLoad load;
+        if (!key_sessions_.acquire(key_id, snapshot.keys, &load)) {
+            throw runtime_error("Keys for key ID " + key_id + " are missing.");
+        }
+        if (load.loaded) {
+            trace.add(Stage::key_load, load.load_ms / 1000.0);
+            trace.add_blob_bytes(load.blobs.bytes_in_place, load.blobs.bytes_copied);
+        }
+        KeySessionStats sessions = key_sessions_.stats();
+        LogLine() << "\n[Server][" << request_id << "] Key session " << key_id << " "
+                  << (load.loaded ? "loaded" : "reused") << " (" << load.bytes / 1024 << " KB, "
+                  << load.load_ms << " ms; sessions: " << sessions.sessions << ", " << sessions.bytes / (1024 * 1024)
+                  << "/" << sessions.budget_bytes / (1024 * 1024) << " MB, hits: " << sessions.hits << ", misses: "
+                  << sessions.misses << ", evictions: " << sessions.evictions << ")\n";
+    }
+    else {
+        // 키 & 모델 로딩 (캐시: 바뀐 파일만 역직렬화)
+        if (!cache_.acquire(snapshot)) {
+            LogLine() << "[Server][" << request_id << "] Keys are missing. Waiting for key upload...\n";
+            // 클라이언트는 키를 요청보다 먼저 게시하므로, 마지막 키 파일이 들어올 때까지 잠시 대기
+            ChannelWatcher key_watcher(channel_dir_);
+            key_watcher.wait_for_any({ "galois_keys.dat" }, 1000);
+            if (!cache_.acquire(snapshot)) throw runtime_error("Request exists but Keys are missing.");
+        }
+
+        const CacheStats& cache_stats = snapshot.stats;
+        if (cache_stats.last_keys_reloaded) {
+            trace.add(Stage::key_load, cache_stats.last_key_load_ms / 1000.0);
+            trace.add_blob_bytes(cache_stats.last_key_blobs.bytes_in_place, cache_stats.last_key_blobs.bytes_copied);
+        }
+        LogLine() << "\n[Server][" << request_id << "] Keys " << (cache_stats.last_keys_reloaded ? "loaded" : "reused from cache")
+                  << " (key loads: " << cache_stats.key_loads << ", reused: " << cache_stats.key_hits
+                  << ", " << cache_stats.last_key_load_ms << " ms)\n";
+        if (cache_stats.last_keys_reloaded) {
+            const BlobLoadStats& blobs = cache_stats.last_key_blobs;
+            LogLine() << "[Server][" << request_id << "] Key files: " << blobs.blobs << " mapped, "
+                      << blobs.bytes_in_place << " bytes in place, " << blobs.bytes_copied << " bytes copied, "
+                      << blobs.load_ms << " ms\n";
+        }
+    }
+
+    // --- Weights & Bias (모델 목록) ---
+    const CacheStats& cache_stats = snapshot.stats;
+    if (cache_stats.last_model_reloaded) trace.add(Stage::model_load, cache_stats.last_model_load_ms / 1000.0);
+    const ModelSet& models = *snapshot.models;
+    LogLine log;
+    log << "[Server][" << request_id << "] " << models.size() << (models.size() == 1 ? " model " : " models ")
+        << (cache_stats.last_model_reloaded ? "Loaded" : "Cached") << ".";
+    for (const LogisticModel& model : models.models) log << " " << model.name << " bias: " << model.bias << ";";
+    log << " (model loads: " << cache_stats.model_loads << ", reused: " << cache_stats.model_hits
+        << ", " << cache_stats.last_model_load_ms << " ms)\n";
+}
+
+void RequestPipeline::ingest(Job& job, const MemoryPoolHandle& pool) {
+    const string& request_id = job.request_id;
+    RequestTrace& trace = job.trace;
+
+    if (job.encrypted) {
+        // --- 암호문 입력 로딩 (클라이언트가 seed 압축 형태로 암호화해 보냄) ---
+        // 요청 파일을 mmap하여 매핑된 바이트에서 바로 역직렬화. 역직렬화가 끝나면 매핑은 필요 없다
+        MappedFile req_file(job.work_path);
+        // 헤더의 key_id로 어느 병원의 키를 쓸지 정하므로 키보다 먼저 요청 헤더를 읽는다
+        BlobReader header_reader(req_file.bytes());
+        acquire_snapshot(job, read_request_header(header_reader).key_id);
+
+        size_t request_bytes = req_file.bytes().size();
+        job.request_bytes = request_bytes;
+        trace.add_blob_bytes(req_file.mapped() ? request_bytes : 0, req_file.mapped() ? 0 : request_bytes);
+        LogLine() << "[Server][" << request_id << "] Encrypted input: " << request_bytes << " bytes ("
+                  << (req_file.mapped() ? "mapped" : "copied") << ")\n";
+        job.input = load_encrypted_request(setup_, job.snapshot, req_file.bytes(), pool, &trace);
+        return;
+    }
+
+    // .req는 서버가 암호화하므로 공용 키만 쓴다
+    acquire_snapshot(job, string());
+    const ModelSet& models = *job.snapshot.models;
+
+    // --- 평문 데이터 로딩 ---
+    StageTimer load_timer(&trace, Stage::input_load);
+    ifstream req_file(job.work_path);
+    job.patients = read_request(req_file);
+    req_file.close();
+    load_timer.stop();
+
+    if (job.patients.empty()) {
+        throw runtime_error("Request contains no patient data!");
+    }
+    for (const auto& input_data : job.patients) {
+        if (input_data.size() != models.feature_count()) {
+            throw runtime_error("Input data size mismatch with weights!");
+        }
+    }
+
+    LogLine() << "[Server][" << request_id << "] Input data loaded: " << job.patients.size() << " patient(s) x "
+              << models.feature_count() << " values\n";
+}
+
+// --- 2. evaluate: HE 연산 (worker 스레드) ---
+void RequestPipeline::evaluate_one(WorkerContext& worker) {
+    JobPtr job;
+    evaluate_queue_.pop(job);
+    uint64_t pool_before = worker.pool_bytes();
+
+    try {
+        LogLine() << "[Server][" << job->request_id << "] Evaluating on worker " << worker.id << "\n";
+        if (job->encrypted && job->input.response_mode == ResponseMode::encrypted) {
+            job->results = evaluate_encrypted_input(setup_, worker, job->snapshot, job->input, &job->trace);
+        }
+        else if (job->encrypted) {
+            job->scores = score_encrypted_input(setup_, worker, job->snapshot, job->input, &job->trace);
+        }
+        else {
+            job->scores = score_patients(setup_, worker, job->snapshot, job->patients, &job->trace);
+        }
+
+        const PlaintextCache& constants = *job->snapshot.constants;
+        LogLine() << "[Server][" << job->request_id << "] Plaintext constants: " << constants.size() << " resident (encoded "
+                  << constants.misses() << ", reused " << constants.hits() << " since model load)\n";
+    }
+    catch (const exception& e) {
+        job->error = e.what();
+    }
+    job->trace.add_pool_bytes(pool_before, worker.pool_bytes());
+
+    // 입력 암호문은 더 필요 없으므로 respond 단계로 넘기기 전에 풀에 돌려준다 (환자 수만 남김)
+    job->input.chunks.clear();
+    job->input.chunks.shrink_to_fit();
+    job->patients.clear();
+
+    respond_queue_.push(move(job));
+    if (evaluating_.fetch_sub(1, memory_order_acq_rel) == 1) evaluating_.notify_all();
+}
+
+// --- 3. respond: 응답 게시 (respond 스레드) ---
+void RequestPipeline::respond_loop() {
+    JobPtr job;
+    while (respond_queue_.pop(job)) {
+        respond(*job);
+        job.reset();
+        in_flight_.fetch_sub(1, memory_order_relaxed);
+    }
+}
+
+void RequestPipeline::respond(Job& job) {
+    const string& request_id = job.request_id;
+    RequestTrace& trace = job.trace;
+    bool succeeded = false;
+    size_t patient_count = 0;
+
+    if (job.error.empty() && !job.results.empty()) {
+        try {
+            // 결과 암호문: 마지막 레벨 + zstd 압축, 복호화는 클라이언트에서
+            const ModelSet& models = *job.snapshot.models;
+            size_t response_bytes = 0;
+            StageTimer write_timer(&trace, Stage::response_write);
+            write_file_atomic(responses_dir_ / (request_id + ".cresp"), [&](ostream& out) {
+                save_encrypted_response(out, models, job.input.patient_count, job.results);
+                response_bytes = static_cast<size_t>(out.tellp());
+            }, true);
+            write_timer.stop();
+            succeeded = true;
+            patient_count = job.input.patient_count;
+
+            LogLine() << "[Server][" << request_id << "] " << job.results.size() << " encrypted result(s) sent ("
+                      << patient_count << " patient(s) x " << models.size() << " model(s), " << response_bytes
+                      << " bytes, " << (job.request_bytes > 0 ? 100.0 * response_bytes / job.request_bytes : 0.0)
+                      << "% of request). Standby." << "\n";
+        }
+        catch (const exception& e) {
+            job.error = e.what();
+        }
+    }
+    else if (job.error.empty()) {
+        try {
+            // 첫 줄 "# <모델 이름들>", 이후 환자 순서대로 한 줄에 모델별 점수 (공백 구분)
+            const ModelSet& models = *job.snapshot.models;
+            StageTimer write_timer(&trace, Stage::response_write);
+            write_file_atomic(responses_dir_ / (request_id + ".resp"), [&](ostream& out) {
+                out << "#";
+                for (const LogisticModel& model : models.models) out << " " << model.name;
+                out << "\n";
+                for (size_t i = 0; i < job.scores.size(); i++) {
+                    out << job.scores[i] << ((i + 1) % models.size() == 0 ? "\n" : " ");
+                }
+            });
+            write_timer.stop();
+            succeeded = true;
+            patient_count = job.scores.size() / models.size();
+
+            LogLine() << "[Server][" << request_id << "] " << job.scores.size() << " score(s) sent (" << patient_count
+                      << " patient(s) x " << models.size() << " model(s)). Standby." << "\n";
+        }
+        catch (const exception& e) {
+            job.error = e.what();
+        }
+    }
+
+    if (!succeeded) {
+        LogLine() << "[SERVER ERROR] [" << request_id << "] " << job.error << "\n";
+        // 클라이언트가 무한히 기다리지 않도록 오류 내용을 응답으로 돌려줌
+        try {
+            write_file_atomic(responses_dir_ / (request_id + ".err"), [&](ostream& out) { out << job.error; });
+        }
+        catch (...) {}
+    }
+
+    error_code ec;
+    fs::remove(job.work_path, ec);
+
+    job.request_timer->stop();
+    metrics_.record(trace, succeeded, patient_count);
+#if HE_METRICS
+    LogLine() << "[Server][" << request_id << "] Stage timings: " << trace.summary() << "\n";
+#endif
+}
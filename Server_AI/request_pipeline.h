@@ -0,0 +1,91 @@
+﻿#pragma once
+#include "bounded_queue.h"
+#include "inference.h"
+#include "key_session_store.h"
+#include "metrics.h"
+#include "model_cache.h"
+#include "worker_pool.h"
+#include <atomic>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// --- Shared_Channel 요청 파이프라인 ---
+// 요청 하나를 세 단계로 나누어, 한 요청의 HE 연산 중에 다음 요청의 파일 읽기/역직렬화와
+// 이전 요청의 응답 쓰기가 겹치게 한다. 단계 사이는 BoundedQueue로 이어져 깊이가 제한된다 (가득 차면 앞 단계가 대기).
+//
+//   ingest  (ingest 스레드)   키/모델 스냅샷, <id>.ckks mmap + 역직렬화 또는 <id>.req 파싱
+//                             (.ckks 헤더에 key_id가 있으면 공용 키 대신 KeySessionStore의 세션 키)
+//   evaluate (WorkerPool)     암호화(.req) + 선형/활성화/sigmoid + 복호화 (소켓 세션과 같은 worker 공유)
+//   respond (respond 스레드)  <id>.resp (plain) / <id>.cresp (encrypted) 또는 <id>.err 게시, .work 삭제, 지표 기록
+//
+// 어느 단계에서 실패하든 respond 단계가 .err를 게시한다. .work는 응답을 쓴 뒤에 지우므로,
+// 도중에 서버가 멈추면 다음 실행에서 다시 큐에 들어간다.
+struct PipelineOptions {
+    size_t ingest_threads = 1;
+    size_t respond_threads = 1;
+    size_t stage_depth = 0;   // 단계 사이 큐 깊이 (0 = worker 수 x 2)
+};
+
+class RequestPipeline {
+public:
+    RequestPipeline(const InferenceSetup& setup, ServerCache& cache, KeySessionStore& key_sessions,
+        ServerMetrics& metrics, WorkerPool& pool, const std::filesystem::path& channel_dir, const PipelineOptions& options);
+    // 들어온 요청은 모두 응답한 뒤 스레드를 정리한다 (pool보다 먼저 소멸해야 함)
+    ~RequestPipeline();
+
+    RequestPipeline(const RequestPipeline&) = delete;
+    RequestPipeline& operator=(const RequestPipeline&) = delete;
+
+    // work_path는 requests/<id>.req.work 또는 <id>.ckks.work. ingest 큐가 가득 차 있으면 자리가 날 때까지 대기
+    void submit(const std::string& request_id, const std::filesystem::path& work_path, bool encrypted);
+
+    // submit된 뒤 아직 응답하지 않은 요청 수
+    size_t in_flight() const { return in_flight_.load(std::memory_order_relaxed); }
+    size_t stage_depth() const { return ingest_queue_.capacity(); }
+
+private:
+    struct Job {
+        std::string request_id;
+        std::filesystem::path work_path;
+        bool encrypted = false;
+
+        RequestTrace trace;
+        std::unique_ptr<StageTimer> request_timer;  // submit부터 응답까지 (단계 사이 대기 포함)
+        CacheSnapshot snapshot;
+        EncryptedInput input;                       // .ckks
+        std::vector<std::vector<double>> patients;  // .req
+        std::vector<double> scores;                 // plain 응답
+        std::vector<seal::Ciphertext> results;      // encrypted 응답 (.cresp)
+        size_t request_bytes = 0;
+        std::string error;                          // 비어 있지 않으면 .err로 응답
+    };
+    using JobPtr = std::unique_ptr<Job>;
+
+    void ingest_loop();
+    void ingest(Job& job, const seal::MemoryPoolHandle& pool);
+    // job.snapshot에 모델과 키를 채운다 (key_id가 비면 Shared_Channel의 공용 키)
+    void acquire_snapshot(Job& job, const std::string& key_id);
+    void evaluate_one(WorkerContext& worker);
+    void respond_loop();
+    void respond(Job& job);
+
+    const InferenceSetup& setup_;
+    ServerCache& cache_;
+    KeySessionStore& key_sessions_;
+    ServerMetrics& metrics_;
+    WorkerPool& pool_;
+    std::filesystem::path channel_dir_;
+    std::filesystem::path responses_dir_;
+
+    BoundedQueue<JobPtr> ingest_queue_;
+    BoundedQueue<JobPtr> evaluate_queue_;
+    BoundedQueue<JobPtr> respond_queue_;
+    std::atomic<size_t> in_flight_{ 0 };
+    std::atomic<size_t> evaluating_{ 0 };  // pool에 넘겼지만 respond 큐에 아직 넣지 않은 요청 수
+
+    std::vector<std::thread> ingest_threads_;
+    std::vector<std::thread> respond_threads_;
+};
@@ -0,0 +1,35 @@
+﻿#pragma once
+#include <iostream>
+#include <mutex>
+#include <sstream>
+
+// --- 줄 단위 로그 ---
+// 여러 worker 스레드가 동시에 cout에 쓰면 출력이 섞이므로,
+// 한 문장을 모아 두었다가 소멸 시점에 한 번에 출력한다.
+//   LogLine() << "[Server] z^2 computed." << "\n";
+class LogLine {
+public:
+    LogLine() = default;
+    LogLine(const LogLine&) = delete;
+    LogLine& operator=(const LogLine&) = delete;
+
+    ~LogLine() {
+        std::lock_guard<std::mutex> lock(mutex());
+        std::cout << buffer_.str();
+        std::cout.flush();
+    }
+
+    template <class T>
+    LogLine& operator<<(const T& value) {
+        buffer_ << value;
+        return *this;
+    }
+
+private:
+    static std::mutex& mutex() {
+        static std::mutex log_mutex;
+        return log_mutex;
+    }
+
+    std::ostringstream buffer_;
+};
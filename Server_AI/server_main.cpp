@@ -1,18 +1,69 @@
 ﻿#include "seal/seal.h"
+#include "bulk_scoring.h"
+#include "diagnostics.h"
+#include "fixed_circuit.h"
+#include "inference.h"
+#include "key_session_store.h"
+#include "metrics.h"
+#include "model_cache.h"
+#include "param_sweep.h"
+#include "request_pipeline.h"
+#include "server_log.h"
+#include "socket_server.h"
+#include "worker_pool.h"
+#include "../Common/channel.h"
 #include <iostream>
-#include <fstream>	
 #include <vector>
-#include <thread>
-#include <chrono>
 #include <filesystem>
 #include <sstream>
-#include <algorithm>
+#include <string>
+#include <chrono>
+#include <memory>
 
 using namespace std;
 using namespace seal;
 namespace fs = std::filesystem;
 
-int main() {
+// 명령행: --workers N (기본값 0 = CPU 코어 수), --diagnostics N (N번째 요청마다 암호문 시각화 파일 저장, 기본값 0 = 끔)
+//         --circuit linear|sigmoid3|mlp13x16 (기본값 sigmoid3, 클라이언트와 같아야 함, MLP는 models.txt에 mlp 모델 필요)
+//         --metrics PATH (Prometheus 지표 파일, 기본값 server_metrics.prom, off = 끔), --metrics-interval 초 (기본값 5)
+//         --bulk input.csv [--out scores.csv]: 요청 대기 대신 CSV 전체를 채점하고 종료
+//         --sweep input.csv [--out sweep.csv]: 파라미터 조합마다 CSV를 채점해 오차/지연/크기를 기록하고 종료
+//             --sweep-circuits linear,sigmoid3 (기본값 --circuit) --sweep-n 4096,8192 --sweep-scale 25,30,40
+//             --sweep-integer-bits 5,10 --sweep-bit-scale 0,100,10000 (지정하지 않은 항목은 planner 기본값)
+//         --listen unix:PATH | tcp:[HOST:]PORT: Shared_Channel과 함께 소켓 연결로도 요청을 받음
+//         --ingest-threads N / --respond-threads N (기본값 1): 요청 읽기/역직렬화, 응답 쓰기 단계 스레드 수
+//         --stage-depth N (기본값 0 = worker 수 x 2): 파이프라인 단계 사이 큐 깊이
+//         --key-memory-mb N (기본값 1024): 병원별 키 세션(Shared_Channel/keys/<key_id>/)을 메모리에 둘 한도
+//         --fixed-circuits on|off (기본값 on): 등록된 모델 모양은 컴파일 시점에 특화한 회로로 평가 (off = 모두 일반 경로)
+static string parse_option(int argc, char* argv[], const string& name, const string& default_value) {
+    for (int i = 1; i + 1 < argc; i++) {
+        if (string(argv[i]) == name) return argv[i + 1];
+    }
+    return default_value;
+}
+
+static size_t parse_size_option(int argc, char* argv[], const string& name, size_t default_value) {
+    return static_cast<size_t>(stoul(parse_option(argc, argv, name, to_string(default_value))));
+}
+
+// 쉼표로 구분한 목록 ("4096,8192"), 옵션이 없으면 빈 목록
+template <class T>
+static vector<T> parse_list_option(int argc, char* argv[], const string& name, T (*convert)(const string&)) {
+    vector<T> values;
+    istringstream list(parse_option(argc, argv, name, ""));
+    string item;
+    while (getline(list, item, ',')) {
+        if (!item.empty()) values.push_back(convert(item));
+    }
+    return values;
+}
+
+static string as_string(const string& text) { return text; }
+static size_t as_size(const string& text) { return static_cast<size_t>(stoul(text)); }
+static int as_int(const string& text) { return stoi(text); }
+
+int main(int argc, char* argv[]) {
     cout << "==================================================" << "\n";
     cout << "Current Working Directory: " << fs::current_path() << "\n";
     cout << "Please place 'weights.txt' and 'bias.txt' here" << "\n";
@@ -24,375 +75,147 @@ int main() {
     try {
         cout << "[Server] Initializing encryption parameters...\n";
         cout.flush();
-        
-        EncryptionParameters parms(scheme_type::ckks);
-        // 원래 작동하던 파라미터로 복원
-        size_t poly_modulus_degree = 8192;
-        parms.set_poly_modulus_degree(poly_modulus_degree);
-        parms.set_coeff_modulus(CoeffModulus::Create(poly_modulus_degree, { 60, 40, 40, 60 }));
+
+        // 회로의 곱셈 깊이로부터 N과 modulus chain을 계산 (클라이언트도 같은 planner 사용)
+        //   sigmoid3: 깊이 3 (W*x, z^2, z^3) → N=8192 / linear: 깊이 1 → N=4096 / mlp13x16: 깊이 4 → N=8192
+        string circuit_arg = parse_option(argc, argv, "--circuit", "sigmoid3");
+
+        // 파라미터 스윕: 조합마다 context와 키를 새로 만들므로 서버 context는 만들지 않는다
+        string sweep_input = parse_option(argc, argv, "--sweep", "");
+        if (!sweep_input.empty()) {
+            SweepOptions options;
+            options.input_path = sweep_input;
+            options.output_path = parse_option(argc, argv, "--out",
+                fs::path(sweep_input).replace_extension().string() + "_sweep.csv");
+            options.workers = parse_size_option(argc, argv, "--workers", 0);
+            options.circuits = parse_list_option<string>(argc, argv, "--sweep-circuits", as_string);
+            if (options.circuits.empty()) options.circuits.push_back(circuit_arg);
+            options.poly_degrees = parse_list_option<size_t>(argc, argv, "--sweep-n", as_size);
+            options.scale_bits = parse_list_option<int>(argc, argv, "--sweep-scale", as_int);
+            options.integer_bits = parse_list_option<int>(argc, argv, "--sweep-integer-bits", as_int);
+            options.bit_scales = parse_list_option<int>(argc, argv, "--sweep-bit-scale", as_int);
+            run_parameter_sweep(options);
+            return 0;
+        }
+
+        CircuitSpec circuit = parse_circuit(circuit_arg);
+        ParameterPlan plan = plan_parameters(circuit);
+        EncryptionParameters parms = make_encryption_parameters(plan);
+
+        cout << "[Server] Circuit " << circuit_name(circuit) << ": " << describe_plan(plan) << "\n";
 
         cout << "[Server] Creating SEAL context...\n";
         cout.flush();
         SEALContext context(parms);
-        
-        cout << "[Server] Creating evaluator and encoder...\n";
-        cout.flush();
-        Evaluator evaluator(context);
-        CKKSEncoder encoder(context);
+        fs::path channel_dir = "Shared_Channel";
+
+        // 등록된 모델 모양별 특화 회로 (레벨 표는 여기서 한 번 만든다)
+        FixedCircuits fixed_circuits(context, circuit, plan);
+        bool use_fixed_circuits = parse_option(argc, argv, "--fixed-circuits", "on") != "off";
+        cout << "[Server] Fixed circuits: " << (use_fixed_circuits ? fixed_circuits.describe() : string("off"))
+             << " (other model shapes use the generic path)\n";
+
+        // 오프라인 일괄 채점: 파일 채널/클라이언트 없이 CSV를 채점하고 종료
+        string bulk_input = parse_option(argc, argv, "--bulk", "");
+        if (!bulk_input.empty()) {
+            DiagnosticsSink no_diagnostics(channel_dir, 0);
+            InferenceSetup setup{ context, circuit, plan, no_diagnostics };
+            if (use_fixed_circuits) setup.fixed_circuits = &fixed_circuits;
+
+            BulkOptions options;
+            options.input_path = bulk_input;
+            options.output_path = parse_option(argc, argv, "--out",
+                fs::path(bulk_input).replace_extension().string() + "_scores.csv");
+            options.workers = parse_size_option(argc, argv, "--workers", 0);
+            run_bulk_scoring(setup, options);
+            return 0;
+        }
 
-        cout << "[Server] AI Server is running... Waiting for KEY...." << "\n";
-        cout.flush();
+        // 모델/키/Encryptor/Decryptor 상주 캐시 (파일이 바뀐 경우에만 다시 로드)
+        ServerCache cache(context, channel_dir, ".");
 
-        PublicKey public_key;
-        SecretKey secret_key;
-        RelinKeys relin_keys;
+        // 병원별 키 세션 (요청 헤더에 key_id가 있을 때, 한도를 넘으면 오래 쓰지 않은 세션부터 내보냄)
+        size_t key_memory_mb = parse_size_option(argc, argv, "--key-memory-mb", 1024);
+        KeySessionStore key_sessions(context, channel_dir / "keys", key_memory_mb << 20);
 
-        while (true) {
-            ifstream req_file("Shared_Channel/request.txt");
-
-        if (req_file.good()) {
-            try {
-                // 키 로딩
-                ifstream pk_file("Shared_Channel/pub_key.dat", ios::binary);
-                ifstream sk_file("Shared_Channel/secret_key.dat", ios::binary);
-                ifstream rk_file("Shared_Channel/relin_keys.dat", ios::binary);
-
-                if (pk_file.good() && sk_file.good() && rk_file.good()) {
-                    public_key.load(context, pk_file);
-                    secret_key.load(context, sk_file);
-                    relin_keys.load(context, rk_file);
-                    pk_file.close();
-                    sk_file.close();
-                    rk_file.close();
-                    cout << "\n[Server] New Keys Loaded successfully! (PublicKey, SecretKey, RelinKeys)" << "\n";
-                }
-                else {
-                    cout << "[Server] Error: Request exists but Keys are missing.\n";
-                    req_file.close();
-                    this_thread::sleep_for(chrono::seconds(1));
-                    continue;
-                }
-
-                cout << "[Server] !! Request data detected. !! Processing..." << "\n";
-
-                // --- 1. Weights & Bias 파일 읽기 ---
-
-                // Weights 읽기
-                ifstream w_file("./weights.txt");
-                if (!w_file.is_open()) throw runtime_error("weights.txt not found!");
-                vector<double> weights;
-                double temp;
-                while (w_file >> temp) weights.push_back(temp);
-                w_file.close();
-
-                // Bias 읽기
-                ifstream b_file("./bias.txt");
-                if (!b_file.is_open()) throw runtime_error("bias.txt not found!");
-                double bias;
-                b_file >> bias;
-                b_file.close();
-
-                cout << "[Server] Model Loaded. Bias: " << bias << "\n";
-
-                // --- 2. 평문 데이터 로딩 및 암호화 ---
-                cout << "[Server] Loading input data from request.txt...\n";
-                vector<double> input_data;
-                double temp_val;
-                while (req_file >> temp_val) {
-                    input_data.push_back(temp_val);
-                }
-                req_file.close();
-
-                if (input_data.size() != weights.size()) {
-                    throw runtime_error("Input data size mismatch with weights!");
-                }
-
-                cout << "[Server] Input data loaded: " << input_data.size() << " values\n";
-                cout << "[Server] Starting encryption process...\n";
-
-                // --- 비트 인코딩: 10진수 값을 정수로 변환하여 비트 단위로 저장 ---
-                // 정규화된 값(0.0~1.0)을 정수로 변환 (예: 0.123 → 1230, 스케일 10000)
-                const int bit_scale = 10000; // 10진수 4자리 정밀도
-                vector<double> bit_encoded_data;
-                for (double val : input_data) {
-                    // 0.0~1.0 범위를 0~10000 정수로 변환
-                    int int_val = static_cast<int>(val * bit_scale);
-                    // 정수 값을 다시 double로 변환 (CKKS는 실수 연산)
-                    bit_encoded_data.push_back(static_cast<double>(int_val));
-                }
-
-                cout << "[Server] Data bit-encoded: ";
-                for (size_t i = 0; i < bit_encoded_data.size(); i++) {
-                    cout << bit_encoded_data[i];
-                    if (i < bit_encoded_data.size() - 1) cout << ", ";
-                }
-                cout << "\n";
-
-                // 암호화 수행 (scale 줄임: 2^30)
-                double scale = pow(2.0, 30);
-                Encryptor encryptor(context, public_key);
-                Plaintext plain_input;
-                encoder.encode(bit_encoded_data, scale, plain_input);
-                Ciphertext encrypted_input;
-                encryptor.encrypt(plain_input, encrypted_input);
-
-                cout << "[Server] Data encrypted successfully.\n";
-
-                // --- 암호문 정보 추출 및 저장 (시각화용) ---
-                // 현재 작업 디렉토리 확인 및 Shared_Channel 경로 구성
-                fs::path current_dir = fs::current_path();
-                fs::path shared_channel = current_dir / "Shared_Channel";
-                fs::path cipher_info_path = shared_channel / "ciphertext_info.txt";
-                fs::path cipher_size_path = shared_channel / "ciphertext_size.txt";
-                fs::path cipher_binary_path = shared_channel / "ciphertext_binary.dat";
-                
-                cout << "[Server] Current directory: " << current_dir << "\n";
-                cout << "[Server] Shared_Channel path: " << shared_channel << "\n";
-                cout << "[Server] Saving ciphertext info to: " << cipher_info_path << "\n";
-                
-                // Shared_Channel 디렉토리가 없으면 생성
-                if (!fs::exists(shared_channel)) {
-                    fs::create_directories(shared_channel);
-                    cout << "[Server] Created Shared_Channel directory.\n";
-                }
-                
-                try {
-                    // 1. 암호문 메타데이터 저장
-                    ofstream cipher_info(cipher_info_path.string());
-                    if (!cipher_info.is_open()) {
-                        cout << "[Server] Warning: Failed to open ciphertext_info.txt\n";
-                    } else {
-                        cipher_info << "Ciphertext Information\n";
-                        cipher_info << "=====================\n";
-                        cipher_info << "Size (polynomials): " << encrypted_input.size() << "\n";
-                        cipher_info << "Poly Modulus Degree: " << poly_modulus_degree << "\n";
-                        cipher_info << "Coeff Modulus Size: " << encrypted_input.coeff_modulus_size() << "\n";
-                        cipher_info << "Scale: " << encrypted_input.scale() << "\n";
-                        
-                        // 2. 암호문의 일부 계수 추출 (처음 100개)
-                        size_t sample_count = min(static_cast<size_t>(100), 
-                            static_cast<size_t>(encrypted_input.size() * poly_modulus_degree * encrypted_input.coeff_modulus_size()));
-                        cipher_info << "\nSample Coefficients (first " << sample_count << "):\n";
-                        
-                        const auto* cipher_data = encrypted_input.data();
-                        for (size_t i = 0; i < sample_count; i++) {
-                            cipher_info << cipher_data[i];
-                            if (i < sample_count - 1) cipher_info << " ";
-                        }
-                        cipher_info << "\n";
-                        cipher_info.flush();
-                        cipher_info.close();
-                        cout << "[Server] Ciphertext info saved.\n";
-                    }
-
-                    // 3. 암호문 바이너리 크기 정보 저장
-                    // 암호문을 메모리에 저장하여 크기 계산
-                    stringstream cipher_stream;
-                    encrypted_input.save(cipher_stream);
-                    size_t cipher_size = cipher_stream.tellp();
-                    
-                    ofstream cipher_size_info(cipher_size_path.string());
-                    if (!cipher_size_info.is_open()) {
-                        cout << "[Server] Warning: Failed to open " << cipher_size_path << "\n";
-                    } else {
-                        cipher_size_info << cipher_size << "\n";
-                        cipher_size_info.flush();
-                        cipher_size_info.close();
-                        cout << "[Server] Ciphertext size saved: " << cipher_size << " bytes to " << cipher_size_path << "\n";
-                    }
-
-                    // 4. 암호문 바이너리 저장 (이미지 변환용)
-                    ofstream cipher_binary(cipher_binary_path.string(), ios::binary);
-                    if (!cipher_binary.is_open()) {
-                        cout << "[Server] Warning: Failed to open " << cipher_binary_path << "\n";
-                    } else {
-                        encrypted_input.save(cipher_binary);
-                        cipher_binary.flush();
-                        cipher_binary.close();
-                        cout << "[Server] Ciphertext binary saved to " << cipher_binary_path << "\n";
-                        
-                        // 파일이 실제로 생성되었는지 확인
-                        if (fs::exists(cipher_binary_path)) {
-                            auto file_size = fs::file_size(cipher_binary_path);
-                            cout << "[Server] Verified: Binary file exists, size = " << file_size << " bytes\n";
-                        } else {
-                            cout << "[Server] Error: Binary file was not created!\n";
-                        }
-                    }
-                }
-                catch (const exception& e) {
-                    cout << "[Server] Error saving ciphertext info: " << e.what() << "\n";
-                }
-
-                // --- 3. 동형암호 연산 (Prediction) ---
-
-                // 가중치도 비트 스케일에 맞춰 조정
-                vector<double> bit_encoded_weights;
-                for (double w : weights) {
-                    bit_encoded_weights.push_back(w * bit_scale);
-                }
-
-                // [Step 1] W * x (가중치 곱하기)
-                Plaintext plain_weights;
-                encoder.encode(bit_encoded_weights, encrypted_input.parms_id(), encrypted_input.scale(), plain_weights);
-
-                evaluator.multiply_plain_inplace(encrypted_input, plain_weights);
-
-                // [Step 2] Rescaling 제거 (coeff_modulus가 2개만 있으므로 rescale 불필요)
-
-                // [Step 3] Bias 더하기 (비트 스케일에 맞춰 조정)
-                // 단순히 bias를 더하면 [v1+b, v2+b, v3+b...]가 되어 합산 시 4b가 됨.
-                // 따라서 [b, 0, 0, 0...] 벡터를 만들어 더해줌.
-                // 그러면 [v1+b, v2, v3...]가 되고, 합산하면 Total + b가 되어 정확해짐.
-
-                vector<double> bias_vec(weights.size(), 0.0); // 0으로 초기화된 벡터
-                bias_vec[0] = bias * bit_scale * bit_scale; // bias도 비트 스케일 적용 (W*x 결과에 맞춤)
-
-                Plaintext plain_bias;
-                // 현재 encrypted_input의 scale에 맞춰서 인코딩해야 덧셈 가능
-                encoder.encode(bias_vec, encrypted_input.parms_id(), encrypted_input.scale(), plain_bias);
-
-                evaluator.add_plain_inplace(encrypted_input, plain_bias);
-
-                cout << "[Server] Linear prediction (Wx + b) computed securely." << "\n";
-
-                // --- 3-1. Logistic Regression: Sigmoid 다항식 근사 연산 ---
-                // sigmoid(z) ≈ 0.5 + 0.25*z - (1/48)*z^3
-                // z = Wx + b (현재 encrypted_input에 저장됨)
-                
-                cout << "[Server] Computing sigmoid polynomial approximation..." << "\n";
-                
-                // z를 복사하여 보존 (z는 나중에 0.25*z 계산에 사용)
-                Ciphertext encrypted_z = encrypted_input;
-                
-                // z^2 계산: z * z (암호문끼리 곱셈)
-                Ciphertext encrypted_z_squared;
-                evaluator.square(encrypted_z, encrypted_z_squared);
-                evaluator.relinearize_inplace(encrypted_z_squared, relin_keys);
-                evaluator.rescale_to_next_inplace(encrypted_z_squared);
-                
-                cout << "[Server] z^2 computed." << "\n";
-                
-                // z^3 계산: z^2 * z
-                Ciphertext encrypted_z_cubed;
-                evaluator.multiply(encrypted_z_squared, encrypted_z, encrypted_z_cubed);
-                evaluator.relinearize_inplace(encrypted_z_cubed, relin_keys);
-                evaluator.rescale_to_next_inplace(encrypted_z_cubed);
-                
-                cout << "[Server] z^3 computed." << "\n";
-                
-                // 각 항을 독립적으로 계산
-                // 1. 0.5 상수 항
-                vector<double> const_05_vec(weights.size(), 0.0);
-                const_05_vec[0] = 0.5 * bit_scale * bit_scale * bit_scale; // 최종 scale에 맞춤
-                Plaintext plain_const_05;
-                double target_scale = pow(2.0, 30); // 최종 scale
-                encoder.encode(const_05_vec, encrypted_z_cubed.parms_id(), target_scale, plain_const_05);
-                
-                // 2. 0.25 * z 항 (z의 scale에 맞춰 계산)
-                vector<double> coeff_025_vec(weights.size(), 0.0);
-                coeff_025_vec[0] = 0.25 * bit_scale * bit_scale; // z의 scale에 맞춤
-                Plaintext plain_coeff_025;
-                encoder.encode(coeff_025_vec, encrypted_z.parms_id(), encrypted_z.scale(), plain_coeff_025);
-                Ciphertext encrypted_025z;
-                evaluator.multiply_plain(encrypted_z, plain_coeff_025, encrypted_025z);
-                evaluator.rescale_to_next_inplace(encrypted_025z);
-                
-                // 3. - (1/48) * z^3 항
-                vector<double> coeff_neg_1_48_vec(weights.size(), 0.0);
-                coeff_neg_1_48_vec[0] = -(1.0 / 48.0) * bit_scale * bit_scale; // z^3의 scale에 맞춤
-                Plaintext plain_coeff_neg_1_48;
-                encoder.encode(coeff_neg_1_48_vec, encrypted_z_cubed.parms_id(), encrypted_z_cubed.scale(), plain_coeff_neg_1_48);
-                evaluator.multiply_plain_inplace(encrypted_z_cubed, plain_coeff_neg_1_48);
-                evaluator.rescale_to_next_inplace(encrypted_z_cubed);
-                
-                // 모든 항의 parms_id와 scale을 맞춘 후 합산
-                // encrypted_025z와 encrypted_z_cubed의 parms_id를 맞춤
-                evaluator.mod_switch_to_inplace(encrypted_025z, encrypted_z_cubed.parms_id());
-                evaluator.mod_switch_to_inplace(encrypted_z_cubed, encrypted_025z.parms_id());
-                
-                // scale을 맞춤 (더 작은 scale로 통일)
-                double scale_025z = encrypted_025z.scale();
-                double scale_z3 = encrypted_z_cubed.scale();
-                double min_scale = min(scale_025z, scale_z3);
-                
-                if (abs(scale_025z - min_scale) > 1.0) {
-                    double ratio = min_scale / scale_025z;
-                    vector<double> scale_vec(weights.size(), 0.0);
-                    scale_vec[0] = ratio;
-                    Plaintext plain_scale;
-                    encoder.encode(scale_vec, encrypted_025z.parms_id(), encrypted_025z.scale(), plain_scale);
-                    evaluator.multiply_plain_inplace(encrypted_025z, plain_scale);
-                    evaluator.rescale_to_next_inplace(encrypted_025z);
-                }
-                
-                if (abs(scale_z3 - min_scale) > 1.0) {
-                    double ratio = min_scale / scale_z3;
-                    vector<double> scale_vec(weights.size(), 0.0);
-                    scale_vec[0] = ratio;
-                    Plaintext plain_scale;
-                    encoder.encode(scale_vec, encrypted_z_cubed.parms_id(), encrypted_z_cubed.scale(), plain_scale);
-                    evaluator.multiply_plain_inplace(encrypted_z_cubed, plain_scale);
-                    evaluator.rescale_to_next_inplace(encrypted_z_cubed);
-                }
-                
-                // 0.25*z - (1/48)*z^3 계산
-                evaluator.add(encrypted_025z, encrypted_z_cubed, encrypted_input);
-                
-                // 0.5 상수 추가 (최종 scale에 맞춤)
-                evaluator.mod_switch_to_inplace(encrypted_input, plain_const_05.parms_id());
-                double final_scale = encrypted_input.scale();
-                if (abs(final_scale - target_scale) > 1.0) {
-                    // scale 조정
-                    double ratio = final_scale / target_scale;
-                    vector<double> scale_vec(weights.size(), 0.0);
-                    scale_vec[0] = ratio;
-                    Plaintext plain_scale;
-                    encoder.encode(scale_vec, encrypted_input.parms_id(), encrypted_input.scale(), plain_scale);
-                    evaluator.multiply_plain_inplace(encrypted_input, plain_scale);
-                    evaluator.rescale_to_next_inplace(encrypted_input);
-                }
-                
-                evaluator.add_plain_inplace(encrypted_input, plain_const_05);
-                
-                cout << "[Server] Sigmoid polynomial (0.5 + 0.25*z - (1/48)*z^3) computed securely." << "\n";
-
-                // --- 4. 복호화 및 최종 점수 계산 ---
-                Decryptor decryptor(context, secret_key);
-                Plaintext plain_result;
-                decryptor.decrypt(encrypted_input, plain_result);
-                vector<double> result_vec;
-                encoder.decode(plain_result, result_vec);
-
-                // 최종 점수 합산 (서버에서 모든 연산 완료)
-                // 비트 인코딩된 값을 원래 스케일로 복원
-                double final_score = 0.0;
-                for (size_t i = 0; i < result_vec.size() && i < input_data.size(); i++) {
-                    final_score += result_vec[i];
-                }
-                // 비트 스케일로 나누어 원래 값으로 복원
-                final_score = final_score / (bit_scale * bit_scale);
-
-                cout << "[Server] Final score computed: " << final_score << "\n";
-
-                // --- 5. 평문 결과 전송 ---
-                ofstream resp_file("Shared_Channel/response.txt");
-                resp_file << final_score;
-                resp_file.close();
-
-                fs::remove("Shared_Channel/request.txt");
-                cout << "[Server] Result sent. Standby." << "\n";
+        // 요청 큐: requests/<id>.req (평문) 또는 <id>.ckks (암호문) → responses/<id>.resp
+        fs::path responses_dir = channel_dir / "responses";
+        fs::create_directories(responses_dir);
+        ChannelWatcher request_watcher(channel_dir / "requests");
 
-            }
-            catch (const std::exception& e) {
-                cerr << "[SERVER ERROR] " << e.what() << "\n";
-                req_file.close();
-                fs::remove("Shared_Channel/request.ckks");
-            }
+        // 이전 실행에서 처리 도중 멈춘 요청(<id>.req.work 등)은 .work를 떼어 다시 큐에 넣는다
+        for (const string& name : request_watcher.list({ ".work" })) {
+            fs::path stale = request_watcher.dir() / name;
+            fs::rename(stale, fs::path(stale).replace_extension());
+        }
+
+        // 암호문 시각화 파일은 샘플링된 요청만 백그라운드 스레드에서 저장 (worker pool보다 먼저 생성 → 나중에 소멸)
+        DiagnosticsSink diagnostics(channel_dir, parse_size_option(argc, argv, "--diagnostics", 0));
+        if (diagnostics.enabled()) {
+            cout << "[Server] Ciphertext diagnostics enabled (sampled, asynchronous).\n";
         }
-        else {
-            this_thread::sleep_for(chrono::milliseconds(500));
+
+        InferenceSetup setup{ context, circuit, plan, diagnostics };
+        if (use_fixed_circuits) setup.fixed_circuits = &fixed_circuits;
+
+        // 단계별 지연 시간 히스토그램 + 요청 카운터 (HE_METRICS=0 빌드에서는 계측 코드 없음)
+        ServerMetrics metrics;
+        metrics.attach_key_sessions(&key_sessions);
+#if HE_METRICS
+        unique_ptr<MetricsExporter> metrics_exporter;
+        string metrics_path = parse_option(argc, argv, "--metrics", "server_metrics.prom");
+        if (metrics_path != "off") {
+            chrono::seconds interval(parse_size_option(argc, argv, "--metrics-interval", 5));
+            metrics_exporter = make_unique<MetricsExporter>(metrics, metrics_path, interval);
+            cout << "[Server] Exporting stage metrics to " << metrics_path << " every " << interval.count() << " s\n";
+        }
+#endif
+
+        cout << "[Server] Creating worker pool (evaluator and encoder per worker)...\n";
+        cout.flush();
+        WorkerPool pool(context, parse_size_option(argc, argv, "--workers", 0));
+
+        // 소켓 세션 (pool보다 나중에 생성 → 먼저 소멸, 처리 중인 요청은 끝까지 응답)
+        unique_ptr<SocketServer> socket_server;
+        string listen_address = parse_option(argc, argv, "--listen", "");
+        if (!listen_address.empty()) {
+            Endpoint endpoint = parse_endpoint(listen_address);
+            socket_server = make_unique<SocketServer>(setup, cache, key_sessions, metrics, pool, endpoint);
+            cout << "[Server] Listening on " << describe_endpoint(endpoint) << " (keys are kept per connection)\n";
         }
+
+        // Shared_Channel 요청: ingest → evaluate (pool) → respond 파이프라인 (pool보다 나중에 생성 → 먼저 소멸)
+        PipelineOptions pipeline_options;
+        pipeline_options.ingest_threads = parse_size_option(argc, argv, "--ingest-threads", 1);
+        pipeline_options.respond_threads = parse_size_option(argc, argv, "--respond-threads", 1);
+        pipeline_options.stage_depth = parse_size_option(argc, argv, "--stage-depth", 0);
+        RequestPipeline pipeline(setup, cache, key_sessions, metrics, pool, channel_dir, pipeline_options);
+        cout << "[Server] Request pipeline: " << pipeline_options.ingest_threads << " ingest / " << pool.size()
+             << " evaluate / " << pipeline_options.respond_threads << " respond thread(s), stage depth "
+             << pipeline.stage_depth() << "\n";
+
+        cout << "[Server] Key sessions: " << key_sessions.dir().string() << " (memory budget " << key_memory_mb << " MB)\n";
+        cout << "[Server] AI Server is running with " << pool.size() << " workers... Waiting for requests...." << "\n";
+        cout.flush();
+
+        while (true) {
+            // 요청 파일이 rename되어 들어오는 즉시 깨어남 (inotify)
+            for (const string& name : request_watcher.wait_for_extension({ ".req", ".ckks" })) {
+                string request_id = fs::path(name).stem().string();
+                bool encrypted = fs::path(name).extension() == ".ckks";
+                fs::path work_path = request_watcher.dir() / (name + ".work");
+
+                // 선점: .work로 이름을 바꿔 같은 요청이 두 번 큐에 들어가지 않게 함
+                error_code ec;
+                fs::rename(request_watcher.dir() / name, work_path, ec);
+                if (ec) continue;
+
+                LogLine() << "[Server] !! " << (encrypted ? "Encrypted request " : "Request ") << request_id
+                          << " detected. !! Queued (in flight: " << pipeline.in_flight() + 1 << ")\n";
+
+                // ingest 큐가 가득 차 있으면 자리가 날 때까지 대기 (나머지 요청 파일은 그대로 남아 있음)
+                pipeline.submit(request_id, work_path, encrypted);
+            }
         }
     }
     catch (const exception& e) {
@@ -405,6 +228,6 @@ int main() {
         cerr.flush();
         return 1;
     }
-    
+
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,349 @@
+﻿#include "socket_server.h"
+#include "server_log.h"
+#include "../Common/blob_loader.h"
+#include "../Common/ckks_request.h"
+#include <chrono>
+#include <cmath>
+#include <exception>
+#include <future>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+using namespace std;
+using namespace seal;
+
+SocketServer::SocketServer(const InferenceSetup& setup, ServerCache& cache, KeySessionStore& key_sessions,
+    ServerMetrics& metrics, WorkerPool& pool, const Endpoint& endpoint)
+    : setup_(setup), cache_(cache), key_sessions_(key_sessions), metrics_(metrics), pool_(pool), endpoint_(endpoint), listener_(endpoint) {
+    accept_thread_ = thread(&SocketServer::accept_loop, this);
+}
+
+SocketServer::~SocketServer() {
+    stopping_ = true;
+    listener_.shutdown();
+    accept_thread_.join();
+
+    lock_guard<mutex> lock(sessions_mutex_);
+    for (Session& session : sessions_) session.connection->shutdown();
+    for (Session& session : sessions_) session.thread.join();
+}
+
+void SocketServer::accept_loop() {
+    size_t next_session_id = 1;
+    while (!stopping_) {
+        shared_ptr<SocketConnection> connection;
+        try {
+            connection = make_shared<SocketConnection>(listener_.accept());
+        }
+        catch (const exception& e) {
+            if (!stopping_) LogLine() << "[SERVER ERROR] " << e.what() << "\n";
+            return;
+        }
+
+        size_t session_id = next_session_id++;
+        auto finished = make_shared<atomic<bool>>(false);
+
+        lock_guard<mutex> lock(sessions_mutex_);
+        reap_sessions_locked();
+        sessions_.push_back({ connection, finished, thread([this, connection, finished, session_id] {
+            serve(*connection, session_id);
+            *finished = true;
+        }) });
+    }
+}
+
+void SocketServer::reap_sessions_locked() {
+    for (auto it = sessions_.begin(); it != sessions_.end();) {
+        if (*it->finished) {
+            it->thread.join();
+            it = sessions_.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+}
+
+// keys 프레임: PublicKey, SecretKey, RelinKeys, GaloisKeys 순서 (socket_transport.h)
+// public_keys 프레임은 SecretKey가 빠짐 (decryptor 없음)
+// 수신 버퍼에서 바로 역직렬화한다
+static KeySet load_session_keys(const SEALContext& context, string_view payload, bool with_secret_key) {
+    BlobReader reader(payload);
+
+    PublicKey public_key;
+    SecretKey secret_key;
+    auto relin_keys = make_shared<RelinKeys>();
+    auto galois_keys = make_shared<GaloisKeys>();
+    reader.load(context, public_key);
+    if (with_secret_key) reader.load(context, secret_key);
+    reader.load(context, *relin_keys);
+    reader.load(context, *galois_keys);
+
+    KeySet keys;
+    keys.encryptor = make_shared<const Encryptor>(context, public_key);
+    if (with_secret_key) keys.decryptor = make_shared<Decryptor>(context, secret_key);
+    keys.relin_keys = move(relin_keys);
+    keys.galois_keys = move(galois_keys);
+    return keys;
+}
+
+// key_challenge 난수 (key_challenge_bytes 바이트)
+static string make_key_challenge_nonce() {
+    random_device rd;
+    string nonce(key_challenge_bytes, '\0');
+    for (char& byte : nonce) byte = static_cast<char>(rd() & 0xFF);
+    return nonce;
+}
+
+// 난수를 세션 공개키로 암호화한 key_challenge 프레임 내용. 맨 아래 레벨에서 암호화해 크기를 줄인다
+static string make_key_challenge(const InferenceSetup& setup, const Encryptor& encryptor, const string& nonce) {
+    CKKSEncoder encoder(setup.context);
+    Plaintext plain;
+    encoder.encode(make_key_challenge_slots(nonce), setup.context.last_parms_id(), pow(2.0, setup.plan.scale_bits), plain);
+    Ciphertext encrypted;
+    encryptor.encrypt(plain, encrypted);
+    ostringstream out;
+    encrypted.save(out);
+    return out.str();
+}
+
+void SocketServer::serve(SocketConnection& connection, size_t session_id) {
+    string session = "session " + to_string(session_id);
+    LogLine() << "[Server][" << session << "] Connected (" << describe_endpoint(endpoint_) << ")\n";
+
+    KeySet keys;
+    double pending_key_load_seconds = 0.0; // 키를 받은 뒤 첫 요청의 key_load 단계에 더함
+    size_t pending_key_bytes = 0;
+    size_t request_count = 0;
+    bool report_timing = false;            // server_timing 프레임을 받은 연결은 응답마다 처리 시간을 함께 보냄
+    unordered_set<string> owned_key_ids;   // key_challenge에 맞게 답한 key_id (이 연결만 쓸 수 있음)
+    string challenge_key_id;               // 답을 기다리는 key_challenge
+    string challenge_nonce;
+
+    try {
+        Frame frame;
+        while (connection.receive(frame)) {
+            if (frame.type == MessageType::keys || frame.type == MessageType::public_keys) {
+                auto key_start = chrono::steady_clock::now();
+                size_t key_bytes = frame.payload.size();
+                try {
+                    keys = load_session_keys(setup_.context, frame.payload, frame.type == MessageType::keys);
+                }
+                catch (const exception& e) {
+                    // 클라이언트는 keys 프레임의 응답을 기다리지 않으므로 오류를 보낸 뒤 연결을 닫는다.
+                    // 연결을 유지하면 이 오류가 다음 요청의 응답으로 읽혀 이후 응답이 모두 하나씩 밀린다
+                    LogLine() << "[SERVER ERROR] [" << session << "] Invalid keys: " << e.what() << "\n";
+                    connection.send(MessageType::error, string("Invalid keys: ") + e.what());
+                    break;
+                }
+                chrono::duration<double> elapsed = chrono::steady_clock::now() - key_start;
+                pending_key_load_seconds = elapsed.count();
+                pending_key_bytes = key_bytes;
+                LogLine() << "[Server][" << session << "] Keys received (" << key_bytes << " bytes loaded in place, "
+                          << elapsed.count() * 1000.0 << " ms)\n";
+                continue;
+            }
+
+            if (frame.type == MessageType::server_timing) {
+                report_timing = true;
+                continue;
+            }
+            if (frame.type == MessageType::key_session) {
+                // 헤더의 key_id는 누구나 적을 수 있으므로, 그 세션의 공개키로 암호화한 난수를 풀게 해서
+                // 비밀키를 가진 병원인지 확인한다 (공유 디렉터리의 파일을 읽을 수 있는 것만으로는 통과하지 못함)
+                string key_id = frame.payload;
+                challenge_key_id.clear();
+                challenge_nonce.clear();
+                string challenge;
+                string nonce = make_key_challenge_nonce();
+                try {
+                    KeySet session_keys;
+                    if (!key_sessions_.acquire(key_id, session_keys)) {
+                        throw runtime_error("Keys for key ID " + key_id + " are missing.");
+                    }
+                    challenge = make_key_challenge(setup_, *session_keys.encryptor, nonce);
+                }
+                catch (const exception& e) {
+                    LogLine() << "[SERVER ERROR] [" << session << "] Key session " << key_id << ": " << e.what() << "\n";
+                    connection.send(MessageType::error, string("Key session rejected: ") + e.what());
+                    continue;
+                }
+                challenge_key_id = move(key_id);
+                challenge_nonce = move(nonce);
+                connection.send(MessageType::key_challenge, challenge);
+                continue;
+            }
+            if (frame.type == MessageType::key_challenge) {
+                string key_id = move(challenge_key_id);
+                string nonce = move(challenge_nonce);
+                challenge_key_id.clear();
+                challenge_nonce.clear();
+                if (nonce.empty()) {
+                    connection.send(MessageType::error, "Key challenge answer without a key session request");
+                    continue;
+                }
+                // 앞에서부터 맞는 바이트 수가 응답 시간으로 드러나지 않도록 끝까지 비교 (난수는 한 번만 씀)
+                unsigned char diff = frame.payload.size() == nonce.size() ? 0 : 1;
+                for (size_t i = 0; i < nonce.size() && i < frame.payload.size(); i++) {
+                    diff |= static_cast<unsigned char>(nonce[i] ^ frame.payload[i]);
+                }
+                if (diff != 0) {
+                    LogLine() << "[Server][" << session << "] Key session " << key_id << " rejected (wrong challenge answer)\n";
+                    connection.send(MessageType::error, "Key challenge failed for key ID " + key_id);
+                    continue;
+                }
+                owned_key_ids.insert(key_id);
+                LogLine() << "[Server][" << session << "] Key session " << key_id << " registered\n";
+                connection.send(MessageType::key_session, {});
+                continue;
+            }
+            if (frame.type != MessageType::request) {
+                // 응답을 기다리는 요청이 없으므로 (위와 같은 이유로) 오류를 보내고 연결을 닫는다
+                LogLine() << "[SERVER ERROR] [" << session << "] Unexpected frame type "
+                          << static_cast<uint32_t>(frame.type) << "\n";
+                connection.send(MessageType::error, "Unexpected frame type");
+                break;
+            }
+            auto received = chrono::steady_clock::now();
+            // 요청에 대한 응답 (켜져 있으면 server_timing 프레임을 먼저). worker에 넘기기 전의 거절은 시간이 0
+            auto reply = [&](MessageType type, string_view payload, ServerTiming timing) {
+                if (report_timing) connection.send(MessageType::server_timing, encode_server_timing(timing));
+                connection.send(type, payload);
+            };
+            // 연결로 키를 받지 않았으면 요청 헤더의 key_id로 서버에 저장된 키 세션을 쓴다
+            string key_id;
+            if (!keys.galois_keys) {
+                try {
+                    BlobReader header_reader(frame.payload);
+                    key_id = read_request_header(header_reader).key_id;
+                }
+                catch (const exception& e) {
+                    reply(MessageType::error, e.what(), {});
+                    continue;
+                }
+                if (key_id.empty()) {
+                    reply(MessageType::error, "Keys must be sent before requests", {});
+                    continue;
+                }
+                // 헤더의 key_id는 누구나 적을 수 있으므로 이 연결이 등록한 세션만 쓴다 (다른 병원 키로 복호화 방지)
+                if (!owned_key_ids.contains(key_id)) {
+                    reply(MessageType::error, "Key ID " + key_id + " is not registered on this connection", {});
+                    continue;
+                }
+            }
+
+            // 요청 처리와 응답 전송은 worker에서. 같은 연결의 다음 프레임은 응답을 보낸 뒤에 읽는다
+            string request_id = session + "/" + to_string(++request_count);
+            double key_load_seconds = pending_key_load_seconds;
+            size_t key_bytes = pending_key_bytes;
+            pending_key_load_seconds = 0.0;
+            pending_key_bytes = 0;
+
+            promise<void> done;
+            future<void> finished = done.get_future();
+            pool_.submit([&](WorkerContext& worker) {
+                // 아래에서 무엇이 던져지든 세션 스레드가 finished.wait()에서 멈추지 않도록 항상 알린다
+                struct DoneSignal {
+                    promise<void>& done;
+                    ~DoneSignal() { done.set_value(); }
+                } done_signal{ done };
+
+                auto worker_start = chrono::steady_clock::now();
+                auto timing = [&] {
+                    chrono::duration<double, milli> queued = worker_start - received;
+                    chrono::duration<double, milli> computed = chrono::steady_clock::now() - worker_start;
+                    return ServerTiming{ queued.count(), computed.count() };
+                };
+                RequestTrace trace;
+                StageTimer request_timer(&trace, Stage::request);
+                uint64_t pool_before = worker.pool_bytes();
+                bool succeeded = false;
+                size_t patient_count = 0;
+                if (key_load_seconds > 0.0) trace.add(Stage::key_load, key_load_seconds);
+                trace.add_blob_bytes(key_bytes + frame.payload.size(), 0);
+
+                try {
+                    CacheSnapshot snapshot;
+                    snapshot.keys = keys;
+                    if (!key_id.empty()) {
+                        KeySessionLoad load;
+                        if (!key_sessions_.acquire(key_id, snapshot.keys, &load)) {
+                            throw runtime_error("Keys for key ID " + key_id + " are missing.");
+                        }
+                        if (load.loaded) {
+                            trace.add(Stage::key_load, load.load_ms / 1000.0);
+                            trace.add_blob_bytes(load.blobs.bytes_in_place, load.blobs.bytes_copied);
+                        }
+                        LogLine() << "[Server][" << request_id << "] Key session " << key_id << " "
+                                  << (load.loaded ? "loaded" : "reused") << " (" << load.load_ms << " ms)\n";
+                    }
+                    cache_.acquire_model(snapshot);
+                    if (snapshot.stats.last_model_reloaded) {
+                        trace.add(Stage::model_load, snapshot.stats.last_model_load_ms / 1000.0);
+                    }
+
+                    LogLine() << "[Server][" << request_id << "] Encrypted input: " << frame.payload.size()
+                              << " bytes on worker " << worker.id << "\n";
+                    EncryptedInput input = load_encrypted_request(setup_, snapshot, frame.payload, worker.pool, &trace);
+
+                    if (input.response_mode == ResponseMode::encrypted) {
+                        // 결과 암호문을 그대로 돌려준다 (복호화는 클라이언트에서)
+                        vector<Ciphertext> results = evaluate_encrypted_input(setup_, worker, snapshot, input, &trace);
+                        StageTimer write_timer(&trace, Stage::response_write);
+                        ostringstream response;
+                        save_encrypted_response(response, *snapshot.models, input.patient_count, results);
+                        reply(MessageType::encrypted_response, response.view(), timing());
+                        write_timer.stop();
+
+                        LogLine() << "[Server][" << request_id << "] " << results.size() << " encrypted result(s) sent ("
+                                  << input.patient_count << " patient(s) x " << snapshot.models->size() << " model(s), "
+                                  << response.view().size() << " bytes, "
+                                  << 100.0 * response.view().size() / frame.payload.size() << "% of request).\n";
+                    }
+                    else {
+                        vector<double> scores = score_encrypted_input(setup_, worker, snapshot, input, &trace);
+                        StageTimer write_timer(&trace, Stage::response_write);
+                        reply(MessageType::response, encode_scores({ snapshot.models->names(), scores }), timing());
+                        write_timer.stop();
+
+                        LogLine() << "[Server][" << request_id << "] " << scores.size() << " score(s) sent (" << input.patient_count
+                                  << " patient(s) x " << snapshot.models->size() << " model(s)).\n";
+                    }
+                    succeeded = true;
+                    patient_count = input.patient_count;
+                }
+                catch (const exception& e) {
+                    LogLine() << "[SERVER ERROR] [" << request_id << "] " << e.what() << "\n";
+                    try {
+                        reply(MessageType::error, e.what(), timing());
+                    }
+                    catch (...) {}
+                }
+                catch (...) {
+                    LogLine() << "[SERVER ERROR] [" << request_id << "] Unknown error\n";
+                    try {
+                        reply(MessageType::error, "Unknown server error", timing());
+                    }
+                    catch (...) {}
+                }
+
+                request_timer.stop();
+                trace.add_pool_bytes(pool_before, worker.pool_bytes());
+                metrics_.record(trace, succeeded, patient_count);
+#if HE_METRICS
+                LogLine() << "[Server][" << request_id << "] Stage timings: " << trace.summary() << "\n";
+#endif
+            });
+            finished.wait();
+        }
+    }
+    catch (const exception& e) {
+        if (!stopping_) LogLine() << "[SERVER ERROR] [" << session << "] " << e.what() << "\n";
+    }
+
+    LogLine() << "[Server][" << session << "] Disconnected after " << request_count << " request(s)\n";
+}
@@ -0,0 +1,56 @@
+﻿#pragma once
+#include "inference.h"
+#include "key_session_store.h"
+#include "metrics.h"
+#include "model_cache.h"
+#include "worker_pool.h"
+#include "../Common/socket_transport.h"
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// --- 소켓 요청 처리 (Shared_Channel 파일 교환과 함께 동작) ---
+// 연결마다 세션 스레드 하나가 프레임을 읽는다. 키는 세션이 가지고 있고 (파일로 쓰지 않음),
+// 요청은 worker pool에서 처리한 뒤 같은 연결로 응답한다. 한 연결 안의 요청은 순서대로 처리되고,
+// 여러 연결의 요청은 worker 수만큼 동시에 처리된다. 모델은 ServerCache에서 가져오므로 파일 변경이 반영된다.
+// 키를 보내지 않은 연결은 요청 헤더의 key_id로 KeySessionStore에 저장된 병원 키를 쓴다 (연결마다 키를 다시 올리지 않음).
+// 단, key_session 요청에 온 key_challenge(세션 공개키로 암호화한 난수)를 복호화해 답한 연결만 그 key_id를 쓸 수 있다
+// (다른 병원의 키 세션은 error로 거절). key_session / key_challenge 교환에는 server_timing 프레임이 붙지 않는다.
+// server_timing 프레임을 보낸 연결에는 응답마다 worker 대기/연산 시간을 먼저 보낸다 (Benchmark/load_generator.cpp).
+class SocketServer {
+public:
+    SocketServer(const InferenceSetup& setup, ServerCache& cache, KeySessionStore& key_sessions,
+        ServerMetrics& metrics, WorkerPool& pool, const Endpoint& endpoint);
+    // 새 연결을 막고 열린 연결을 끊은 뒤 세션 스레드가 끝날 때까지 기다린다
+    ~SocketServer();
+
+    SocketServer(const SocketServer&) = delete;
+    SocketServer& operator=(const SocketServer&) = delete;
+
+private:
+    struct Session {
+        std::shared_ptr<SocketConnection> connection;
+        std::shared_ptr<std::atomic<bool>> finished;
+        std::thread thread;
+    };
+
+    void accept_loop();
+    void serve(SocketConnection& connection, size_t session_id);
+    // 끝난 세션 스레드를 join하여 정리 (sessions_mutex_를 잡은 상태에서 호출)
+    void reap_sessions_locked();
+
+    const InferenceSetup& setup_;
+    ServerCache& cache_;
+    KeySessionStore& key_sessions_;
+    ServerMetrics& metrics_;
+    WorkerPool& pool_;
+    Endpoint endpoint_;
+    SocketListener listener_;
+
+    std::atomic<bool> stopping_{ false };
+    std::mutex sessions_mutex_;
+    std::list<Session> sessions_;
+    std::thread accept_thread_;
+};
@@ -11,6 +11,63 @@ from sklearn.linear_model import LogisticRegression
 from sklearn.preprocessing import MinMaxScaler
 from sklearn.metrics import accuracy_score, classification_report
 
+# 명령행: --mlp [은닉 크기] → 13개 특성 전체로 2층 MLP를 학습해 mlp_model.txt로 저장 (기본 은닉 크기 16)
+#         (옵션이 없으면 기존처럼 4개 특성 로지스틱 회귀 → weights.txt, bias.txt)
+mlp_mode = '--mlp' in sys.argv
+hidden_size = 16
+if mlp_mode:
+    mlp_index = sys.argv.index('--mlp')
+    if mlp_index + 1 < len(sys.argv):
+        hidden_size = int(sys.argv[mlp_index + 1])
+
+# MLP 은닉층 활성화: softplus의 2차 Taylor 근사 ln2 + z/2 + z^2/8
+# 서버는 이 계수를 그대로 암호문 다항식으로 계산한다 (곱셈 깊이 2)
+ACTIVATION = np.array([np.log(2.0), 0.5, 0.125])
+
+def activation(z):
+    return ACTIVATION[0] + ACTIVATION[1] * z + ACTIVATION[2] * z ** 2
+
+def activation_grad(z):
+    return ACTIVATION[1] + 2 * ACTIVATION[2] * z
+
+def mlp_forward(params, X):
+    z1 = X @ params['W1'].T + params['b1']
+    h = activation(z1)
+    z2 = h @ params['w2'] + params['b2'][0]
+    return z1, h, 1 / (1 + np.exp(-z2))
+
+# 전체 배치 경사하강 (Adam) + L2 규제
+def train_mlp(X, y, hidden, epochs=3000, lr=0.01, l2=1e-3, seed=42):
+    rng = np.random.default_rng(seed)
+    n = X.shape[1]
+    params = {
+        'W1': rng.normal(0, 1 / np.sqrt(n), (hidden, n)),
+        'b1': np.zeros(hidden),
+        'w2': rng.normal(0, 1 / np.sqrt(hidden), hidden),
+        'b2': np.zeros(1),
+    }
+    m = {k: np.zeros_like(v) for k, v in params.items()}
+    v = {k: np.zeros_like(v) for k, v in params.items()}
+    y = np.asarray(y, dtype=float)
+
+    for epoch in range(1, epochs + 1):
+        z1, h, p = mlp_forward(params, X)
+        dz2 = (p - y) / len(y)
+        dz1 = np.outer(dz2, params['w2']) * activation_grad(z1)
+        grads = {
+            'W1': dz1.T @ X + l2 * params['W1'],
+            'b1': dz1.sum(axis=0),
+            'w2': h.T @ dz2 + l2 * params['w2'],
+            'b2': np.array([dz2.sum()]),
+        }
+        for k in params:
+            m[k] = 0.9 * m[k] + 0.1 * grads[k]
+            v[k] = 0.999 * v[k] + 0.001 * grads[k] ** 2
+            m_hat = m[k] / (1 - 0.9 ** epoch)
+            v_hat = v[k] / (1 - 0.999 ** epoch)
+            params[k] -= lr * m_hat / (np.sqrt(v_hat) + 1e-8)
+    return params
+
 # 1. 데이터 로드
 try:
     df = pd.read_csv('./Server_AI/heart_cleveland.csv')
@@ -21,8 +78,11 @@ except FileNotFoundError:
     
 
 # 2. 학습에 사용할 특성(Feature) 선택
-# 나이, 혈압, 콜레스테롤, 최대심박수
-features = ['age', 'trestbps', 'chol', 'thalach']
+# 나이, 혈압, 콜레스테롤, 최대심박수 (MLP는 condition을 제외한 13개 전체)
+if mlp_mode:
+    features = [column for column in df.columns if column != 'condition']
+else:
+    features = ['age', 'trestbps', 'chol', 'thalach']
 x = df[features]
 y = df['condition']
 
@@ -34,6 +94,37 @@ X_scaled = scaler.fit_transform(x)
 # 4. 데이터 분할 (학습용 / 테스트용)
 X_train, X_test, Y_train, Y_test = train_test_split(X_scaled, y, test_size=0.2, random_state=42)
 
+# 5-1. MLP 학습 및 저장
+if mlp_mode:
+    params = train_mlp(X_train, Y_train, hidden_size)
+    _, _, P_test = mlp_forward(params, X_test)
+    accuracy = accuracy_score(Y_test, (P_test >= 0.5).astype(int))
+
+    print("\n==MLP 학습완료==")
+    print(f"선택된 feature ({len(features)}개): {features}")
+    print(f"은닉층 크기: {hidden_size}, 활성화 계수: {ACTIVATION}")
+    print(f"테스트 세트 정확도: {accuracy:.4f}")
+
+    with open('mlp_model.txt', 'w') as f:
+        f.write(f"# train_model.py --mlp {hidden_size}\n")
+        f.write(f"input {len(features)}\n")
+        f.write(f"hidden {hidden_size}\n")
+        for name, lo, hi in zip(features, scaler.data_min_, scaler.data_max_):
+            f.write(f"feature {name} {lo:.6f} {hi:.6f}\n")
+        f.write("activation " + " ".join(f"{c:.9f}" for c in ACTIVATION) + "\n")
+        f.write("hidden_weights\n")
+        for row in params['W1']:
+            f.write(" ".join(f"{w:.6f}" for w in row) + "\n")
+        f.write("hidden_bias\n" + " ".join(f"{b:.6f}" for b in params['b1']) + "\n")
+        f.write("output_weights\n" + " ".join(f"{w:.6f}" for w in params['w2']) + "\n")
+        f.write(f"output_bias\n{params['b2'][0]:.6f}\n")
+
+    print("mlp_model.txt saved.")
+    print("서버에서 사용하려면 models.txt에 다음 줄을 추가하고 서버/클라이언트를 같은 회로로 실행하세요:")
+    print("  heart_mlp mlp mlp_model.txt")
+    print(f"  --circuit mlp{len(features)}x{hidden_size}")
+    sys.exit(0)
+
 # 5. 모델 학습 (Logistic Regression)
 model = LogisticRegression(max_iter=1000, random_state=42)
 model.fit(X_train, Y_train)
@@ -0,0 +1,70 @@
+﻿#include "worker_pool.h"
+#include "server_log.h"
+#include <exception>
+
+using namespace std;
+using namespace seal;
+
+WorkerScratch::WorkerScratch(const MemoryPoolHandle& pool)
+    : rotated(pool), inner(pool), term(pool), plain(pool) {}
+
+void WorkerScratch::reserve(vector<Ciphertext>& buffers, size_t count, const MemoryPoolHandle& pool) {
+    while (buffers.size() < count) buffers.emplace_back(pool);
+}
+
+WorkerContext::WorkerContext(const SEALContext& context, size_t worker_id)
+    : id(worker_id), pool(MemoryPoolHandle::New()), evaluator(context), encoder(context), scratch(pool) {}
+
+WorkerPool::WorkerPool(const SEALContext& context, size_t thread_count) : context_(context) {
+    if (thread_count == 0) thread_count = max<size_t>(1, thread::hardware_concurrency());
+
+    threads_.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; i++) {
+        threads_.emplace_back(&WorkerPool::run, this, i);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        lock_guard<mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    for (auto& t : threads_) t.join();
+}
+
+void WorkerPool::submit(Task task) {
+    {
+        lock_guard<mutex> lock(mutex_);
+        queue_.push_back(move(task));
+    }
+    cv_.notify_one();
+}
+
+size_t WorkerPool::pending() const {
+    lock_guard<mutex> lock(mutex_);
+    return queue_.size();
+}
+
+void WorkerPool::run(size_t worker_id) {
+    WorkerContext worker(context_, worker_id);
+
+    while (true) {
+        Task task;
+        {
+            unique_lock<mutex> lock(mutex_);
+            cv_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+            // 종료 요청이 와도 남은 요청은 모두 처리한 뒤 끝낸다
+            if (queue_.empty()) return;
+            task = move(queue_.front());
+            queue_.pop_front();
+        }
+
+        try {
+            task(worker);
+        }
+        catch (const exception& e) {
+            LogLine() << "[SERVER ERROR] worker " << worker_id << ": " << e.what() << "\n";
+        }
+    }
+}
@@ -0,0 +1,74 @@
+﻿#pragma once
+#include "seal/seal.h"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// --- worker가 요청마다 다시 쓰는 임시 버퍼 ---
+// 회전 결과, 밀집층 부분합, 다항식 거듭제곱, 복호화/디코딩 결과처럼 요청 안에서만 쓰는 값을 worker가 들고 있는다.
+// 한 번 커진 버퍼는 다음 요청에서 그대로 덮어쓰므로 (같은 레벨이면 재할당 없음) 정상 상태에서는 할당이 거의 없다.
+// 모두 worker의 메모리 풀에서 할당하며, 요청 사이에 값은 의미가 없다 (worker 스레드 하나만 사용).
+struct WorkerScratch {
+    explicit WorkerScratch(const seal::MemoryPoolHandle& pool);
+
+    // 크기를 count 이상으로 맞춘다. 늘어나는 칸도 pool에서 할당 (vector::resize는 복사 생성이라 전역 풀을 씀)
+    static void reserve(std::vector<seal::Ciphertext>& buffers, size_t count, const seal::MemoryPoolHandle& pool);
+
+    seal::Ciphertext rotated;                  // 회전-합산, 블록 절반 복제
+    seal::Ciphertext inner, term;              // 밀집층 giant step 부분합, 대각선 곱
+    std::vector<seal::Ciphertext> rotations;   // 밀집층 baby step 회전 입력
+    std::vector<seal::Ciphertext> baby_powers; // 다항식 x^1 .. x^k
+    std::vector<seal::Ciphertext> giant_powers;
+    seal::Plaintext plain;                     // 복호화 결과
+    std::vector<double> slots;                 // 디코딩 결과
+};
+
+// --- worker 스레드별 연산 객체 ---
+// SEALContext는 모든 worker가 공유하고, Evaluator/CKKSEncoder와 메모리 풀은 스레드마다 따로 둔다.
+// (전역 메모리 풀 하나를 여러 스레드가 같이 쓰면 할당 시 lock 경합이 생김)
+// 풀은 thread-safe 풀이다: 입력 암호문은 ingest 스레드가, 결과 암호문은 respond 스레드가 해제할 수 있음.
+// SEAL 풀은 해제된 블록을 OS에 돌려주지 않고 같은 크기의 다음 할당에 다시 내주므로 worker마다의 arena처럼 동작한다.
+// pool_bytes()는 지금까지 풀이 확보한 바이트 (최고 수위, 줄어들지 않음)
+struct WorkerContext {
+    WorkerContext(const seal::SEALContext& context, size_t worker_id);
+
+    std::uint64_t pool_bytes() const { return static_cast<std::uint64_t>(pool.alloc_byte_count()); }
+
+    size_t id;
+    seal::MemoryPoolHandle pool;
+    seal::Evaluator evaluator;
+    seal::CKKSEncoder encoder;
+    WorkerScratch scratch;
+};
+
+// --- 요청 큐 + worker pool ---
+class WorkerPool {
+public:
+    using Task = std::function<void(WorkerContext&)>;
+
+    // thread_count가 0이면 hardware_concurrency 사용
+    WorkerPool(const seal::SEALContext& context, size_t thread_count);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    void submit(Task task);
+
+    size_t size() const { return threads_.size(); }
+    size_t pending() const;
+
+private:
+    void run(size_t worker_id);
+
+    const seal::SEALContext& context_;
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<Task> queue_;
+    bool stopping_ = false;
+    std::vector<std::thread> threads_;
+};
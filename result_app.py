@@ -2,6 +2,8 @@ import streamlit as st
 import subprocess
 import os
 import time
+import socket
+import struct
 import numpy as np
 from PIL import Image
 import math
@@ -12,6 +14,12 @@ RAW_DATA_PATH = "raw_data.txt"
 RESULT_PATH = r"Client_Hospital\result.txt"
 SHARED_PATH = "Shared_Channel"
 
+# 상주 클라이언트 데몬 주소 (Client_Hospital.exe --daemon tcp:7100). 떠 있지 않으면 실행 파일을 띄운다
+CLIENT_DAEMON_ADDRESS = ("127.0.0.1", 7100)
+DAEMON_TIMEOUT = 30
+FRAME_RESPONSE = 3
+FRAME_PATIENT_ROWS = 7
+
 def normalize_data(data):
     """
     MinMaxScaler를 사용하여 0.0~1.0 사이로 정규화
@@ -129,6 +137,109 @@ def load_ciphertext_info():
     return info
 
 
+def show_result(score_str):
+    """진단 점수와 서버가 남긴 암호문 정보를 표시"""
+    try:
+        score = float(score_str)
+        st.success("진단 완료!")
+        st.metric(label="AI 예측 심장질환 위험도", value=f"{score*100:.2f}%")
+
+        if score > 0.7:
+            st.error("⚠️ 고위험군입니다. 정밀 검사가 필요합니다.")
+        else:
+            st.balloons()
+            st.success("✅ 정상 범위입니다.")
+
+        # --- 암호문 시각화 섹션 추가 ---
+        st.divider()
+        st.subheader("🔐 암호화된 데이터 시각화")
+
+        # 암호문 정보 로드
+        cipher_info = load_ciphertext_info()
+
+        if cipher_info:
+            # 1. 암호문 정보 텍스트 표시
+            with st.expander("📊 암호문 정보 (숫자)", expanded=True):
+                if 'text' in cipher_info:
+                    st.text(cipher_info['text'])
+
+                if 'size_bytes' in cipher_info and cipher_info['size_bytes'] > 0:
+                    col_size1, col_size2, col_size3 = st.columns(3)
+                    with col_size1:
+                        st.metric("암호문 크기 (Bytes)", f"{cipher_info['size_bytes']:,}")
+                    with col_size2:
+                        st.metric("암호문 크기 (KB)", f"{cipher_info['size_kb']:.2f}")
+                    with col_size3:
+                        st.metric("암호문 크기 (MB)", f"{cipher_info['size_mb']:.4f}")
+
+            # 2. 암호문 바이너리를 이미지로 시각화
+            binary_path = os.path.join(SHARED_PATH, "ciphertext_binary.dat")
+            if os.path.exists(binary_path):
+                st.subheader("🎨 암호문 바이너리 시각화 (픽셀 이미지)")
+                st.caption("암호문의 바이너리 데이터를 픽셀 값으로 변환하여 색상으로 표현합니다.")
+
+                # 이미지 크기 선택
+                img_size = st.selectbox("이미지 크기 선택", [128, 256, 512], index=1)
+
+                cipher_img = visualize_ciphertext_binary(binary_path, width=img_size, height=img_size)
+
+                if cipher_img:
+                    st.image(cipher_img, caption=f"암호문 바이너리 데이터 ({img_size}x{img_size} 픽셀)", use_container_width=True)
+                    st.caption("💡 각 픽셀의 색상은 암호문 바이너리 데이터의 바이트 값을 나타냅니다.")
+                else:
+                    st.warning("이미지 변환에 실패했습니다.")
+        else:
+            st.info("암호문 정보를 찾을 수 없습니다. 서버가 암호화를 완료했는지 확인해주세요.")
+
+    except ValueError:
+        st.error(f"결과 파일 형식이 잘못되었습니다: {score_str}")
+
+
+def score_via_daemon(normalized_data):
+    """
+    상주 클라이언트 데몬(Client_Hospital --daemon)에 정규화된 값을 보내 첫 번째 모델 점수를 받는다.
+    데몬이 떠 있지 않으면 None (호출자가 실행 파일을 띄움), 데몬이 보낸 오류는 RuntimeError
+    프레임: type (uint32) | 길이 (uint64) | payload (Common/socket_transport.h)
+    """
+    payload = "\n".join(f"{val:.6f}" for val in normalized_data).encode()
+    try:
+        conn = socket.create_connection(CLIENT_DAEMON_ADDRESS, timeout=1.0)
+    except OSError:
+        return None
+
+    def receive_exact(size):
+        data = b""
+        while len(data) < size:
+            chunk = conn.recv(size - len(data))
+            if not chunk:
+                raise RuntimeError("데몬이 응답 전에 연결을 닫았습니다.")
+            data += chunk
+        return data
+
+    with conn:
+        conn.settimeout(DAEMON_TIMEOUT)
+        try:
+            conn.sendall(struct.pack("<IQ", FRAME_PATIENT_ROWS, len(payload)) + payload)
+            frame_type, length = struct.unpack("<IQ", receive_exact(12))
+            body = receive_exact(length)
+        except OSError as e:
+            raise RuntimeError(f"데몬과의 통신에 실패했습니다: {e}")
+
+    if frame_type != FRAME_RESPONSE:
+        raise RuntimeError(body.decode(errors="replace"))
+
+    # encode_scores 형식: 환자 수, 모델 수, 모델 이름들, 환자 x 모델 점수 (첫 값이 첫 모델 점수)
+    patient_count, model_count = struct.unpack_from("<QQ", body, 0)
+    offset = 16
+    for _ in range(model_count):
+        (name_length,) = struct.unpack_from("<I", body, offset)
+        offset += 4 + name_length
+    if patient_count * model_count == 0:
+        raise RuntimeError("데몬 응답에 점수가 없습니다.")
+    (score,) = struct.unpack_from("<d", body, offset)
+    return score
+
+
 # --- 웹 페이지 설정 ---
 st.set_page_config(page_title="Privacy-Preserving AI", layout="wide")
 
@@ -172,105 +283,66 @@ with col1:
             st.info(f"📊 정규화된 데이터: {[f'{v:.6f}' for v in normalized_data]}")
             st.info("🔐 암호화 엔진(C++)을 실행합니다...")
             
-            # 3. C++ Client 실행
+            # 3. 상주 클라이언트 데몬이 떠 있으면 소켓으로 요청 (키 생성/업로드 없이 암호화와 서버 연산만)
+            daemon_used = False
             try:
-                if not os.path.exists(CLIENT_EXE_PATH):
-                    st.error(f"실행 파일을 찾을 수 없습니다: {CLIENT_EXE_PATH}")
-                else:
-                    # cwd=os.getcwd() : 현재 app.py가 있는 폴더를 기준(Root)으로 실행
-                    process = subprocess.Popen([CLIENT_EXE_PATH], cwd=os.getcwd())
+                with st.spinner('클라이언트 데몬을 통해 동형암호 통신 중...'):
+                    daemon_score = score_via_daemon(normalized_data)
+                if daemon_score is not None:
+                    daemon_used = True
+                    st.info("⚡ 상주 클라이언트 데몬으로 처리했습니다 (저장된 키 재사용).")
+                    show_result(f"{daemon_score}")
+            except RuntimeError as e:
+                daemon_used = True
+                st.error(f"클라이언트 데몬 오류: {e}")
+
+            if not daemon_used:
+                # 4. 데몬이 없으면 C++ Client 실행 (요청마다 context/키 생성 후 종료)
+                try:
+                    if not os.path.exists(CLIENT_EXE_PATH):
+                        st.error(f"실행 파일을 찾을 수 없습니다: {CLIENT_EXE_PATH}")
+                    else:
+                        # cwd=os.getcwd() : 현재 app.py가 있는 폴더를 기준(Root)으로 실행
+                        process = subprocess.Popen([CLIENT_EXE_PATH], cwd=os.getcwd())
                     
-                    # C++이 종료될 때까지 대기 (최대 30초)
-                    max_wait_time = 30
-                    elapsed_time = 0
-                    with st.spinner('서버(Cloud)와 동형암호 통신 중...'):
-                        while process.poll() is None and elapsed_time < max_wait_time:
-                            time.sleep(0.5)
-                            elapsed_time += 0.5
+                        # C++이 종료될 때까지 대기 (최대 30초)
+                        max_wait_time = 30
+                        elapsed_time = 0
+                        with st.spinner('서버(Cloud)와 동형암호 통신 중...'):
+                            while process.poll() is None and elapsed_time < max_wait_time:
+                                time.sleep(0.5)
+                                elapsed_time += 0.5
                     
-                    # 프로세스가 아직 실행 중이면 타임아웃
-                    if process.poll() is None:
-                        process.terminate()
-                        st.error(f"⏱️ 타임아웃: 서버 응답을 {max_wait_time}초 내에 받지 못했습니다.")
-                        st.info("💡 서버(Server_AI.exe)가 실행 중인지 확인해주세요.")
-                    else:
-                        # 프로세스 종료 코드 확인
-                        return_code = process.returncode
-                        if return_code != 0:
-                            st.warning(f"⚠️ 클라이언트가 비정상 종료되었습니다. (종료 코드: {return_code})")
-                            st.info("💡 콘솔 출력을 확인하여 오류를 확인해주세요.")
+                        # 프로세스가 아직 실행 중이면 타임아웃
+                        if process.poll() is None:
+                            process.terminate()
+                            st.error(f"⏱️ 타임아웃: 서버 응답을 {max_wait_time}초 내에 받지 못했습니다.")
+                            st.info("💡 서버(Server_AI.exe)가 실행 중인지 확인해주세요.")
+                        else:
+                            # 프로세스 종료 코드 확인
+                            return_code = process.returncode
+                            if return_code != 0:
+                                st.warning(f"⚠️ 클라이언트가 비정상 종료되었습니다. (종료 코드: {return_code})")
+                                st.info("💡 콘솔 출력을 확인하여 오류를 확인해주세요.")
                         
-                        # 4. 결과 파일 읽기
-                        if os.path.exists(RESULT_PATH):
-                            with open(RESULT_PATH, "r") as f:
-                                score_str = f.read().strip()
+                            # 4. 결과 파일 읽기
+                            if os.path.exists(RESULT_PATH):
+                                with open(RESULT_PATH, "r") as f:
+                                    score_str = f.read().strip()
                             
-                            if not score_str:
-                                st.error("결과 파일이 비어있습니다.")
+                                if not score_str:
+                                    st.error("결과 파일이 비어있습니다.")
+                                else:
+                                    show_result(score_str)
                             else:
-                                try:
-                                    score = float(score_str)
-                                    st.success("진단 완료!")
-                                    st.metric(label="AI 예측 심장질환 위험도", value=f"{score*100:.2f}%")
-                                    
-                                    if score > 0.7:
-                                        st.error("⚠️ 고위험군입니다. 정밀 검사가 필요합니다.")
-                                    else:
-                                        st.balloons()
-                                        st.success("✅ 정상 범위입니다.")
-                                    
-                                    # --- 암호문 시각화 섹션 추가 ---
-                                    st.divider()
-                                    st.subheader("🔐 암호화된 데이터 시각화")
-                                    
-                                    # 암호문 정보 로드
-                                    cipher_info = load_ciphertext_info()
-                                    
-                                    if cipher_info:
-                                        # 1. 암호문 정보 텍스트 표시
-                                        with st.expander("📊 암호문 정보 (숫자)", expanded=True):
-                                            if 'text' in cipher_info:
-                                                st.text(cipher_info['text'])
-                                            
-                                            if 'size_bytes' in cipher_info and cipher_info['size_bytes'] > 0:
-                                                col_size1, col_size2, col_size3 = st.columns(3)
-                                                with col_size1:
-                                                    st.metric("암호문 크기 (Bytes)", f"{cipher_info['size_bytes']:,}")
-                                                with col_size2:
-                                                    st.metric("암호문 크기 (KB)", f"{cipher_info['size_kb']:.2f}")
-                                                with col_size3:
-                                                    st.metric("암호문 크기 (MB)", f"{cipher_info['size_mb']:.4f}")
-                                        
-                                        # 2. 암호문 바이너리를 이미지로 시각화
-                                        binary_path = os.path.join(SHARED_PATH, "ciphertext_binary.dat")
-                                        if os.path.exists(binary_path):
-                                            st.subheader("🎨 암호문 바이너리 시각화 (픽셀 이미지)")
-                                            st.caption("암호문의 바이너리 데이터를 픽셀 값으로 변환하여 색상으로 표현합니다.")
-                                            
-                                            # 이미지 크기 선택
-                                            img_size = st.selectbox("이미지 크기 선택", [128, 256, 512], index=1)
-                                            
-                                            cipher_img = visualize_ciphertext_binary(binary_path, width=img_size, height=img_size)
-                                            
-                                            if cipher_img:
-                                                st.image(cipher_img, caption=f"암호문 바이너리 데이터 ({img_size}x{img_size} 픽셀)", use_container_width=True)
-                                                st.caption("💡 각 픽셀의 색상은 암호문 바이너리 데이터의 바이트 값을 나타냅니다.")
-                                            else:
-                                                st.warning("이미지 변환에 실패했습니다.")
-                                    else:
-                                        st.info("암호문 정보를 찾을 수 없습니다. 서버가 암호화를 완료했는지 확인해주세요.")
-                                    
-                                except ValueError:
-                                    st.error(f"결과 파일 형식이 잘못되었습니다: {score_str}")
-                        else:
-                            st.error("오류: 결과 파일(result.txt)이 생성되지 않았습니다.")
-                            st.info("💡 다음을 확인해주세요:")
-                            st.info("1. 서버(Server_AI.exe)가 실행 중인지 확인")
-                            st.info("2. Shared_Channel 폴더가 존재하는지 확인")
-                            st.info("3. weights.txt와 bias.txt 파일이 루트 디렉토리에 있는지 확인")
-
-            except Exception as e:
-                st.error(f"실행 오류: {e}")
+                                st.error("오류: 결과 파일(result.txt)이 생성되지 않았습니다.")
+                                st.info("💡 다음을 확인해주세요:")
+                                st.info("1. 서버(Server_AI.exe)가 실행 중인지 확인")
+                                st.info("2. Shared_Channel 폴더가 존재하는지 확인")
+                                st.info("3. weights.txt와 bias.txt 파일이 루트 디렉토리에 있는지 확인")
+
+                except Exception as e:
+                    st.error(f"실행 오류: {e}")
 
 # --- [오른쪽] 서버 상태 모니터링 ---
 with col2:
@@ -0,0 +1,121 @@
+﻿#include "ckks_request.h"
+#include "blob_loader.h"
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+
+using namespace std;
+
+// --- 요청 헤더 검증 회귀 테스트 (키/SEAL 연산 없이 헤더만) ---
+// 신뢰할 수 없는 헤더 값이 할당 크기로 이어지기 전에 거부되는지 확인한다.
+
+static int failures = 0;
+
+static void expect(bool condition, const string& name) {
+    if (!condition) {
+        cerr << "FAILED: " << name << "\n";
+        failures++;
+    }
+}
+
+static void expect_rejected(const function<void()>& body, const string& name) {
+    try {
+        body();
+    }
+    catch (const runtime_error&) {
+        return;
+    }
+    catch (const exception& e) {
+        cerr << "FAILED: " << name << " (unexpected exception: " << e.what() << ")\n";
+        failures++;
+        return;
+    }
+    cerr << "FAILED: " << name << " (accepted)\n";
+    failures++;
+}
+
+// 헤더 + body_bytes 바이트의 본문 (본문 내용은 검증에 쓰이지 않음)
+static string make_request(const CkksRequestHeader& header, size_t body_bytes) {
+    ostringstream out;
+    write_request_header(out, header);
+    return out.str() + string(body_bytes, '\0');
+}
+
+// 서버(load_encrypted_request)와 같은 순서: 헤더 파싱 → 암호문 수 검증
+static uint64_t parse_chunks(const string& request, uint64_t patients_per_ciphertext) {
+    BlobReader reader(request);
+    CkksRequestHeader header = read_request_header(reader);
+    return check_request_chunks(header, patients_per_ciphertext, reader.remaining());
+}
+
+int main() {
+    const uint64_t ppc = 1024; // N=8192, 특성 4개
+    const uint64_t max_count = numeric_limits<uint64_t>::max();
+
+    // 정상 요청: 헤더가 그대로 읽히고 암호문 수가 맞음
+    {
+        CkksRequestHeader header;
+        header.patient_count = 5;
+        header.feature_count = 4;
+        header.ciphertext_count = 1;
+        header.response_mode = ResponseMode::encrypted;
+        header.key_id = "hospital-a";
+        string request = make_request(header, 64);
+        BlobReader reader(request);
+        CkksRequestHeader parsed = read_request_header(reader);
+        expect(parsed.patient_count == 5 && parsed.feature_count == 4 && parsed.ciphertext_count == 1
+            && parsed.response_mode == ResponseMode::encrypted && parsed.key_id == "hospital-a", "header round trip");
+        expect(check_request_chunks(parsed, ppc, reader.remaining()) == 1, "single chunk accepted");
+    }
+    {
+        CkksRequestHeader header;
+        header.patient_count = 2 * ppc;
+        header.ciphertext_count = 2;
+        expect(parse_chunks(make_request(header, 64), ppc) == 2, "exact multiple of patients per ciphertext");
+    }
+
+    // patient_count = 2^64-1: (patient_count + ppc - 1)이 넘쳐 0개로 통과하던 경우
+    {
+        CkksRequestHeader header;
+        header.patient_count = max_count;
+        header.ciphertext_count = 0;
+        expect_rejected([&] { parse_chunks(make_request(header, 64), ppc); }, "overflowing patient count with zero chunks");
+    }
+    // 암호문 수는 맞지만 본문이 그만큼 담을 수 없음 (reserve 전에 거부)
+    {
+        CkksRequestHeader header;
+        header.patient_count = max_count;
+        header.ciphertext_count = max_count / ppc + 1;
+        expect_rejected([&] { parse_chunks(make_request(header, 64), ppc); }, "huge chunk count in a short body");
+    }
+    {
+        CkksRequestHeader header;
+        header.patient_count = 100 * ppc;
+        header.ciphertext_count = 100;
+        expect_rejected([&] { parse_chunks(make_request(header, 64), ppc); }, "chunk count larger than the body");
+    }
+    // 환자 수와 맞지 않는 암호문 수
+    {
+        CkksRequestHeader header;
+        header.patient_count = 5;
+        header.ciphertext_count = 2;
+        expect_rejected([&] { parse_chunks(make_request(header, 64), ppc); }, "too many chunks");
+        header.ciphertext_count = 0;
+        expect_rejected([&] { parse_chunks(make_request(header, 64), ppc); }, "too few chunks");
+    }
+    // 잘린 헤더
+    {
+        CkksRequestHeader header;
+        header.patient_count = 5;
+        header.ciphertext_count = 1;
+        string request = make_request(header, 0);
+        expect_rejected([&] { parse_chunks(request.substr(0, 12), ppc); }, "truncated header");
+    }
+
+    if (failures == 0) cout << "ckks_request_test: all checks passed\n";
+    return failures == 0 ? 0 : 1;
+}